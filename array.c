@@ -64,11 +64,9 @@ __aft_release(CMPIArray *array)
           sfcb_native_release_CMPIValue(a->type, &a->data[i].value);
         }
       }
-    memUnlinkEncObj(a->mem_state);
-    a->mem_state = MEM_RELEASED;
     if (a->data)
       free(a->data);
-    free(array);
+    memReleaseEncObj(array, &a->mem_state);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -307,7 +305,7 @@ __new_empty_array(int mm_add,
   int             state;
 
   array.array = a;
-  tArray = memAddEncObj(mm_add, &array, sizeof(array), &state);
+  tArray = memAddArenaEncObj(mm_add, &array, sizeof(array), &state);
   tArray->mem_state = state;
   tArray->refCount = 0;
 
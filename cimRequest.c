@@ -21,6 +21,12 @@
  */
 
 #include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
 
 #include "cmpi/cmpidt.h"
 #include "cimXmlGen.h"
@@ -162,6 +168,16 @@ static char     exportIndIntro2[] =
 static char     exportIndTrailer1[] =
     "</EXPPARAMVALUE>\n"
     "</EXPMETHODCALL>\n" "</SIMPLEEXPREQ>\n" "</MESSAGE>\n" "</CIM>";
+static char     exportMultiIntro2[] =
+    "\" PROTOCOLVERSION=\"1.0\">\n" "<MULTIEXPREQ>\n";
+static char     exportMultiInd1[] =
+    "<SIMPLEEXPREQ>\n"
+    "<EXPMETHODCALL NAME=\"ExportIndication\">\n"
+    "<EXPPARAMVALUE NAME=\"NewIndication\">\n";
+static char     exportMultiInd2[] =
+    "</EXPPARAMVALUE>\n" "</EXPMETHODCALL>\n" "</SIMPLEEXPREQ>\n";
+static char     exportMultiTrailer[] =
+    "</MULTIEXPREQ>\n" "</MESSAGE>\n" "</CIM>";
 
 static char    *
 paramType(CMPIType type)
@@ -469,6 +485,118 @@ exportIndicationReq(CMPIInstance *ci, char *id)
   _SFCB_RETURN(xs);
 };
 
+/* one MULTIEXPREQ message exporting the n indications in ci */
+UtilStringBuffer *
+exportIndicationsReq(CMPIInstance **ci, int n, char *id)
+{
+  UtilStringBuffer *sb = UtilFactory->newStrinBuffer(n * 1024);
+  int             i;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "exportIndicationsReq");
+  sb->ft->appendChars(sb, exportIndIntro1);
+  sb->ft->appendChars(sb, id);
+  sb->ft->appendChars(sb, exportMultiIntro2);
+  for (i = 0; i < n; i++) {
+    sb->ft->appendChars(sb, exportMultiInd1);
+    instance2xml(ci[i], sb, 0);
+    sb->ft->appendChars(sb, exportMultiInd2);
+  }
+  sb->ft->appendChars(sb, exportMultiTrailer);
+  _SFCB_RETURN(sb);
+}
+
+static int
+enumXmlAs(BinRequestContext * binCtx)
+{
+  if (binCtx->oHdr->type == OPS_EnumerateClassNames)
+    return XML_asClassName;
+  if (binCtx->oHdr->type == OPS_EnumerateClasses)
+    return XML_asClass;
+  return binCtx->xmlAs;
+}
+
+static void    *
+relocateResponseObject(BinRequestContext * binCtx, void *data)
+{
+  if (binCtx->type == CMPI_ref)
+    return relocateSerializedObjectPath(data);
+  if (binCtx->type == CMPI_instance)
+    return relocateSerializedInstance(data);
+  if (binCtx->type == CMPI_class)
+    return relocateSerializedConstClass(data);
+  return NULL;
+}
+
+/*
+ * Large responses are rendered one object at a time and handed to the
+ * http adapter in pieces of about responseStreamSize bytes, using chunked
+ * transfer encoding, so the XML of the whole response never has to be in
+ * memory. The binary responses of the providers still are: without
+ * trailers an error can't be reported once the response started, so all
+ * of them have to be in first. Returns 0 if the response is small or the
+ * connection can not take it.
+ */
+static int
+streamResponses(BinRequestContext * binCtx, BinResponseHdr ** resp)
+{
+  UtilStringBuffer *sb;
+  RequestHdr     *hdr = binCtx->rHdr;
+  unsigned long   i,
+                  j,
+                  size = 0;
+  long            limit;
+  int             xmlAs = enumXmlAs(binCtx);
+  void           *object,
+                 *hc;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "streamResponses");
+
+  if (binCtx->commHndl == NULL || binCtx->chunkFncs == NULL
+      || binCtx->chunkFncs->writeStream == NULL
+      || binCtx->pDone < binCtx->pCount)
+    _SFCB_RETURN(0);
+  if (getControlNum("responseStreamSize", &limit))
+    limit = 65536;
+  if (limit <= 0)
+    _SFCB_RETURN(0);
+
+  for (i = 0; i < binCtx->rCount; i++)
+    for (j = 0; j < resp[i]->count; j++)
+      size += resp[i]->object[j].length;
+  if (size < (unsigned long) limit)
+    _SFCB_RETURN(0);
+
+  _SFCB_TRACE(1, ("--- streaming response, %lu bytes of objects", size));
+
+  sb = UtilFactory->newStrinBuffer(limit + 4096);
+  sb->ft->append5Chars(sb, iResponseIntro1, hdr->id, iResponseIntro2,
+                       hdr->iMethod, iResponseIntro3);
+
+  for (i = 0; i < binCtx->rCount; i++) {
+    for (j = 0; j < resp[i]->count; j++) {
+      hc = markHeap();
+      object = relocateResponseObject(binCtx, resp[i]->object[j].data);
+      object2xml(object, binCtx->type, sb, xmlAs, binCtx->bHdr->flags,
+                 binCtx->httpHost);
+      releaseHeap(hc);
+
+      if (sb->ft->getSize(sb) >= (unsigned int) limit) {
+        binCtx->chunkFncs->writeStream(binCtx, sb->ft->getCharPtr(sb),
+                                       sb->ft->getSize(sb));
+        sb->ft->reset(sb);
+      }
+    }
+  }
+
+  sb->ft->appendChars(sb, iResponseTrailer1);
+  binCtx->chunkFncs->writeStream(binCtx, sb->ft->getCharPtr(sb),
+                                 sb->ft->getSize(sb));
+  binCtx->chunkFncs->writeStream(binCtx, NULL, 0);
+  sb->ft->release(sb);
+
+  _SFCB_RETURN(1);
+}
+
 static UtilStringBuffer *
 genEnumResponses(BinRequestContext * binCtx,
                  BinResponseHdr ** resp, int arrLen)
@@ -487,14 +615,7 @@ genEnumResponses(BinRequestContext * binCtx,
 
   for (c = 0, i = 0; i < binCtx->rCount; i++) {
     for (j = 0; j < resp[i]->count; c++, j++) {
-      if (binCtx->type == CMPI_ref)
-        object = relocateSerializedObjectPath(resp[i]->object[j].data);
-      else if (binCtx->type == CMPI_instance)
-        object = relocateSerializedInstance(resp[i]->object[j].data);
-      else if (binCtx->type == CMPI_class) {
-        object = relocateSerializedConstClass(resp[i]->object[j].data);
-      }
-
+      object = relocateResponseObject(binCtx, resp[i]->object[j].data);
       arraySetElementNotTrackedAt(ar, c, (CMPIValue *) & object,
                                        binCtx->type);
     }
@@ -502,16 +623,8 @@ genEnumResponses(BinRequestContext * binCtx,
 
   enm = sfcb_native_new_CMPIEnumeration(ar, NULL);
   sb = UtilFactory->newStrinBuffer(1024);
-
-  if (binCtx->oHdr->type == OPS_EnumerateClassNames)
-    enum2xml(enm, sb, binCtx->type, XML_asClassName, binCtx->bHdr->flags,
-             binCtx->httpHost);
-  else if (binCtx->oHdr->type == OPS_EnumerateClasses)
-    enum2xml(enm, sb, binCtx->type, XML_asClass, binCtx->bHdr->flags,
-             binCtx->httpHost);
-  else
-    enum2xml(enm, sb, binCtx->type, binCtx->xmlAs, binCtx->bHdr->flags,
-             binCtx->httpHost);
+  enum2xml(enm, sb, binCtx->type, enumXmlAs(binCtx), binCtx->bHdr->flags,
+           binCtx->httpHost);
 
   _SFCB_RETURN(sb);
 }
@@ -538,6 +651,13 @@ genResponses(BinRequestContext * binCtx,
   _SFCB_ENTER(TRACE_CIMXMLPROC, "genResponses");
 
   genheap = markHeap();
+  if (streamResponses(binCtx, resp)) {
+    releaseHeap(genheap);
+    rs.chunkedMode = 1;
+    rs.rc = 0;
+    rs.errMsg = NULL;
+    _SFCB_RETURN(rs);
+  }
   sb = genEnumResponses(binCtx, resp, arrlen);
 
   rs = iMethodResponse(binCtx->rHdr, sb);
@@ -1716,6 +1836,412 @@ setQualifier(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
 }
 #endif
 
+/*
+ * Enumeration contexts for the pull operations. The results of an open
+ * request are spooled to a file in enumerationContextDir while they come
+ * in from the providers, and handed out MaxObjectCount at a time by the
+ * open and the following pull requests. The file is named after the
+ * context id, so a pull can be served by any request handler.
+ *
+ * The open request spools the complete provider result before it answers.
+ * Pausing the provider stream between pulls would tie a provider thread and
+ * a request handler to every open context for as long as the client takes;
+ * the spool file costs disk space instead, and is bounded by the context
+ * timeout.
+ */
+
+#define CIM_ERR_INVALID_ENUMERATION_CONTEXT 21
+#define CIM_ERR_FILTERED_ENUMERATION_NOT_SUPPORTED 25
+
+#define ENUMCTX_MAGIC "SFCBEC01"
+
+typedef struct enumCtxHeader {
+  char            magic[8];
+  uint64_t        id;
+  uint32_t        timeout;      /* seconds between requests */
+  uint32_t        principalLength;
+  uint64_t        readPos;      /* offset of the next record */
+} EnumCtxHeader;
+
+/*
+ * the header and principal are followed by records of a uint32_t length
+ * and the CIM-XML of one object 
+ */
+
+typedef struct enumCtx {
+  int             fd;
+  char           *fn;
+  EnumCtxHeader   hdr;
+  unsigned int    flags;
+  char           *httpHost;
+} EnumCtx;
+
+static EnumCtx *spoolCtx = NULL;        /* open request in progress */
+
+static char    *
+enumCtxFileName(uint64_t id)
+{
+  char           *dir;
+
+  if (getControlChars("enumerationContextDir", &dir))
+    dir = SFCB_STATEDIR "/enumerationContexts";
+  mkdir(dir, 0700);
+  return sfcb_snprintf("%s/%llu", dir, (unsigned long long) id);
+}
+
+/*
+ * remove contexts nobody pulled from within their timeout
+ */
+static void
+expireEnumCtxs()
+{
+  char           *dir,
+                  fn[4096];
+  DIR            *d;
+  struct dirent  *de;
+  struct stat     st;
+  EnumCtxHeader   eh;
+  time_t          now = time(NULL);
+  int             fd;
+
+  if (getControlChars("enumerationContextDir", &dir))
+    dir = SFCB_STATEDIR "/enumerationContexts";
+  if ((d = opendir(dir)) == NULL)
+    return;
+
+  while ((de = readdir(d))) {
+    if (*de->d_name < '0' || *de->d_name > '9')
+      continue;
+    snprintf(fn, sizeof(fn), "%s/%s", dir, de->d_name);
+    if ((fd = open(fn, O_RDONLY)) < 0)
+      continue;
+    if (fstat(fd, &st) == 0
+        && read(fd, &eh, sizeof(eh)) == sizeof(eh)
+        && memcmp(eh.magic, ENUMCTX_MAGIC, 8) == 0
+        && st.st_mtime + (time_t) eh.timeout < now)
+      unlink(fn);
+    close(fd);
+  }
+  closedir(d);
+}
+
+static EnumCtx *
+newEnumCtx(char *principal, uint32_t timeout)
+{
+  EnumCtx        *ec = calloc(1, sizeof(EnumCtx));
+  int             fd,
+                  tries;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "newEnumCtx");
+
+  if (principal == NULL)
+    principal = "";
+  memcpy(ec->hdr.magic, ENUMCTX_MAGIC, 8);
+  ec->hdr.timeout = timeout;
+  ec->hdr.principalLength = strlen(principal);
+  ec->hdr.readPos = sizeof(EnumCtxHeader) + ec->hdr.principalLength;
+
+  /*
+   * the id is all a client needs to pull, so it should not be guessable 
+   */
+  for (ec->fd = -1, tries = 0; ec->fd < 0 && tries < 8; tries++) {
+    if ((fd = open("/dev/urandom", O_RDONLY)) < 0
+        || read(fd, &ec->hdr.id, sizeof(ec->hdr.id)) != sizeof(ec->hdr.id))
+      ec->hdr.id = ((uint64_t) getpid() << 32) ^ time(NULL) ^ random();
+    if (fd >= 0)
+      close(fd);
+    ec->hdr.id &= 0x7fffffffffffffffULL;
+    if (ec->hdr.id == 0)
+      continue;
+
+    ec->fn = enumCtxFileName(ec->hdr.id);
+    ec->fd = open(ec->fn, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (ec->fd < 0) {
+      free(ec->fn);
+      ec->fn = NULL;
+    }
+  }
+
+  if (ec->fd < 0
+      || write(ec->fd, &ec->hdr, sizeof(ec->hdr)) != sizeof(ec->hdr)
+      || write(ec->fd, principal, ec->hdr.principalLength) !=
+      (ssize_t) ec->hdr.principalLength) {
+    mlogf(M_ERROR, M_SHOW, "--- could not create enumeration context: %s\n",
+          strerror(errno));
+    if (ec->fd >= 0) {
+      unlink(ec->fn);
+      close(ec->fd);
+    }
+    free(ec->fn);
+    free(ec);
+    _SFCB_RETURN(NULL);
+  }
+  _SFCB_RETURN(ec);
+}
+
+/*
+ * returns NULL if there is no such context for this principal, or it has
+ * timed out
+ */
+static EnumCtx *
+openEnumCtx(uint64_t id, char *principal)
+{
+  EnumCtx        *ec = calloc(1, sizeof(EnumCtx));
+  struct stat     st;
+  char           *p = NULL;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "openEnumCtx");
+
+  if (principal == NULL)
+    principal = "";
+  ec->fn = enumCtxFileName(id);
+  if (id && (ec->fd = open(ec->fn, O_RDWR)) >= 0) {
+    flock(ec->fd, LOCK_EX);
+    if (fstat(ec->fd, &st) == 0
+        && read(ec->fd, &ec->hdr, sizeof(ec->hdr)) == sizeof(ec->hdr)
+        && memcmp(ec->hdr.magic, ENUMCTX_MAGIC, 8) == 0
+        && ec->hdr.id == id
+        && ec->hdr.principalLength == strlen(principal)) {
+      p = malloc(ec->hdr.principalLength + 1);
+      if (read(ec->fd, p, ec->hdr.principalLength) ==
+          (ssize_t) ec->hdr.principalLength
+          && memcmp(p, principal, ec->hdr.principalLength) == 0) {
+        free(p);
+        if (st.st_nlink && st.st_mtime + (time_t) ec->hdr.timeout >=
+            time(NULL))
+          _SFCB_RETURN(ec);
+        _SFCB_TRACE(1, ("--- enumeration context %llu timed out",
+                        (unsigned long long) id));
+        unlink(ec->fn);
+      } else
+        free(p);
+    }
+    close(ec->fd);
+  }
+  free(ec->fn);
+  free(ec);
+  _SFCB_RETURN(NULL);
+}
+
+static void
+closeEnumCtx(EnumCtx * ec, int remove)
+{
+  if (remove)
+    unlink(ec->fn);
+  close(ec->fd);
+  free(ec->fn);
+  free(ec);
+}
+
+/*
+ * ChunkFunctions.writeChunk for open requests, appends the objects of
+ * each chunk to the context of the request
+ */
+static void
+spoolChunk(BinRequestContext * binCtx, BinResponseHdr * resp)
+{
+  UtilStringBuffer *sb;
+  CMPIInstance   *ci;
+  unsigned long   j;
+  uint32_t        l;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "spoolChunk");
+
+  /*
+   * errors are picked up from the last response of the provider 
+   */
+  if (resp->rc != 1 || spoolCtx == NULL)
+    _SFCB_EXIT();
+
+  sb = UtilFactory->newStrinBuffer(1024);
+  lseek(spoolCtx->fd, 0, SEEK_END);
+  for (j = 0; j < resp->count; j++) {
+    ci = relocateSerializedInstance(resp->object[j].data);
+    sb->ft->reset(sb);
+    instanceWithPath2xml(ci, sb, spoolCtx->flags, spoolCtx->httpHost);
+    l = sb->ft->getSize(sb);
+    if (write(spoolCtx->fd, &l, sizeof(l)) != sizeof(l)
+        || write(spoolCtx->fd, sb->ft->getCharPtr(sb), l) != (ssize_t) l) {
+      mlogf(M_ERROR, M_SHOW, "--- enumeration context write failed: %s\n",
+            strerror(errno));
+      break;
+    }
+  }
+  sb->ft->release(sb);
+  _SFCB_EXIT();
+}
+
+/*
+ * hand out the next maxObjectCount objects of ec, and drop the context
+ * once the client has seen them all
+ */
+static          RespSegments
+enumCtxResponse(RequestHdr * hdr, EnumCtx * ec, uint32_t maxObjectCount)
+{
+  UtilStringBuffer *sb = UtilFactory->newStrinBuffer(1024);
+  char           *buf = NULL,
+                 *trailer;
+  uint32_t        l,
+                  bl = 0,
+                  n;
+  off_t           pos = ec->hdr.readPos;
+  struct stat     st;
+  int             eos;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "enumCtxResponse");
+
+  lseek(ec->fd, pos, SEEK_SET);
+  for (n = 0; n < maxObjectCount; n++) {
+    if (read(ec->fd, &l, sizeof(l)) != sizeof(l))
+      break;
+    if (l > bl)
+      buf = realloc(buf, bl = l);
+    if (read(ec->fd, buf, l) != (ssize_t) l)
+      break;
+    sb->ft->appendBlock(sb, buf, l);
+    pos += sizeof(l) + l;
+  }
+  free(buf);
+
+  ec->hdr.readPos = pos;
+  eos = (fstat(ec->fd, &st) || pos >= st.st_size);
+  _SFCB_TRACE(1, ("--- enumeration context %llu: %u objects, eos %d",
+                  (unsigned long long) ec->hdr.id, n, eos));
+
+  /*
+   * rewriting the header also moves the timeout along 
+   */
+  if (!eos && pwrite(ec->fd, &ec->hdr, sizeof(ec->hdr), 0) !=
+      sizeof(ec->hdr))
+    eos = 1;
+
+  trailer = sfcb_snprintf("</IRETURNVALUE>\n"
+                          "<PARAMVALUE NAME=\"EnumerationContext\">\n"
+                          "<VALUE>%llu</VALUE>\n</PARAMVALUE>\n"
+                          "<PARAMVALUE NAME=\"EndOfSequence\">\n"
+                          "<VALUE>%s</VALUE>\n</PARAMVALUE>\n"
+                          "</IMETHODRESPONSE>\n</SIMPLERSP>\n"
+                          "</MESSAGE>\n</CIM>",
+                          (unsigned long long) ec->hdr.id,
+                          eos ? "TRUE" : "FALSE");
+  closeEnumCtx(ec, eos);
+
+  RespSegments    rs = iMethodResponse(hdr, sb);
+  rs.segments[6].mode = 1;
+  rs.segments[6].txt = trailer;
+  _SFCB_RETURN(rs);
+}
+
+static          RespSegments
+openEnumInstances(CimRequestContext * ctx, RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "openEnumInstances");
+  static ChunkFunctions spoolFncs = { spoolChunk };
+  XtokOpenEnumInstances *req = (XtokOpenEnumInstances *) hdr->cimRequest;
+  BinResponseHdr **resp;
+  RespSegments    rs;
+  EnumCtx        *ec;
+  long            timeout;
+  int             irc,
+                  l = 0,
+                  err = 0;
+
+  if (req->filterQuery || req->filterQueryLang) {
+    free(hdr->binCtx->bHdr);
+    _SFCB_RETURN(iMethodErrResponse(hdr, getErrSegment
+        (CIM_ERR_FILTERED_ENUMERATION_NOT_SUPPORTED,
+         "Filtered enumeration not supported")));
+  }
+
+  if (req->operationTimeout)
+    timeout = req->operationTimeout;
+  else if (getControlNum("enumerationContextTimeout", &timeout))
+    timeout = 60;
+
+  expireEnumCtxs();
+  if ((ec = newEnumCtx(hdr->principal, timeout)) == NULL) {
+    free(hdr->binCtx->bHdr);
+    _SFCB_RETURN(iMethodErrResponse(hdr, getErrSegment
+        (CMPI_RC_ERR_FAILED, "Could not create enumeration context")));
+  }
+
+  /*
+   * let the providers chunk their results, the chunks go to the context
+   * instead of the client 
+   */
+  hdr->binCtx->bHdr->flags |= FL_chunked;
+  hdr->chunkedMode = hdr->binCtx->chunkedMode = 1;
+  hdr->binCtx->commHndl = ctx->commHndl;
+  hdr->binCtx->chunkFncs = &spoolFncs;
+  hdr->binCtx->httpHost = ctx->host;
+  ec->flags = hdr->binCtx->bHdr->flags;
+  ec->httpHost = ctx->host;
+
+  _SFCB_TRACE(1, ("--- Getting Provider context"));
+  irc = getProviderContext(hdr->binCtx);
+  _SFCB_TRACE(1, ("--- Provider context gotten irc: %d", irc));
+
+  if (irc == MSG_X_PROVIDER) {
+    spoolCtx = ec;
+    _SFCB_TRACE(1, ("--- Calling Providers"));
+    resp = invokeProviders(hdr->binCtx, &err, &l);
+    _SFCB_TRACE(1, ("--- Back from Providers"));
+    spoolCtx = NULL;
+    closeProviderContext(hdr->binCtx);
+
+    if (err == 0)
+      rs = enumCtxResponse(hdr, ec, req->maxObjectCount);
+    else {
+      closeEnumCtx(ec, 1);
+      rs = iMethodErrResponse(hdr, getErrSegment(resp[err - 1]->rc,
+                                                 (char *) resp[err -
+                                                               1]->object
+                                                 [0].data));
+    }
+    freeResponseHeaders(resp, hdr->binCtx);
+    free(hdr->binCtx->bHdr);
+    _SFCB_RETURN(rs);
+  }
+  closeEnumCtx(ec, 1);
+  closeProviderContext(hdr->binCtx);
+  free(hdr->binCtx->bHdr);
+  _SFCB_RETURN(ctxErrResponse(hdr, hdr->binCtx, 0));
+}
+
+static          RespSegments
+pullInstancesWithPath(CimRequestContext __attribute__ ((unused)) *ctx,
+                      RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "pullInstancesWithPath");
+  XtokPullInstancesWithPath *req =
+      (XtokPullInstancesWithPath *) hdr->cimRequest;
+  EnumCtx        *ec;
+
+  free(hdr->binCtx->bHdr);
+  if ((ec = openEnumCtx(req->enumerationContext, hdr->principal)) == NULL)
+    _SFCB_RETURN(iMethodErrResponse(hdr, getErrSegment
+        (CIM_ERR_INVALID_ENUMERATION_CONTEXT,
+         "Invalid enumeration context")));
+  _SFCB_RETURN(enumCtxResponse(hdr, ec, req->maxObjectCount));
+}
+
+static          RespSegments
+closeEnumeration(CimRequestContext __attribute__ ((unused)) *ctx,
+                 RequestHdr * hdr)
+{
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "closeEnumeration");
+  XtokCloseEnumeration *req = (XtokCloseEnumeration *) hdr->cimRequest;
+  EnumCtx        *ec;
+
+  free(hdr->binCtx->bHdr);
+  if ((ec = openEnumCtx(req->enumerationContext, hdr->principal)) == NULL)
+    _SFCB_RETURN(iMethodErrResponse(hdr, getErrSegment
+        (CIM_ERR_INVALID_ENUMERATION_CONTEXT,
+         "Invalid enumeration context")));
+  closeEnumCtx(ec, 1);
+  _SFCB_RETURN(iMethodResponse(hdr, NULL));
+}
+
 static          RespSegments
 notSupported(CimRequestContext __attribute__ ((unused)) *ctx, RequestHdr * hdr)
 {
@@ -1778,16 +2304,16 @@ static Handler  handlers[] = {
 //{enumerationCount},           // OPS_EnumerationCount 43
   // In the meantime set to notSupported or hack to call the legacy OP...
   {enumInstanceNames},          // OPS_OpenEnumerateInstancePaths 32
-  {enumInstances},              // OPS_OpenEnumerateInstances 33
+  {openEnumInstances},          // OPS_OpenEnumerateInstances 33
   {associatorNames},            // OPS_OpenAssociatorInstancePaths 34
   {associators},                // OPS_OpenAssociatorInstances 36
   {referenceNames},             // OPS_OpenReferenceInstancePaths 36
   {references},                 // OPS_OpenReferenceInstances 37
   {execQuery},                  // OPS_OpenQueryInstances 38
   {notSupported},               // OPS_PullInstances 39
-  {notSupported},               // OPS_PullInstancesWithPath 40
+  {pullInstancesWithPath},      // OPS_PullInstancesWithPath 40
   {notSupported},               // OPS_PullInstancePaths 41
-  {notSupported},               // OPS_CloseEnumeration 42
+  {closeEnumeration},           // OPS_CloseEnumeration 42
   {notSupported}                // OPS_EnumerationCount 43
 };
 
@@ -81,6 +81,7 @@ typedef struct requestHdr {
   char           *className;
   const char     *role;
   BinRequestContext  *binCtx;
+  void           *arena;        /* parse tree storage, see parserMalloc() */
 /* These don't really belong here, but it's *
  * an easy way to get them to the parser.   */
   char           *principal;
@@ -1217,57 +1217,100 @@ className2xml(CMPIObjectPath * op, UtilStringBuffer * sb)
   return 0;
 }
 
+/*
+ * one element of an enumeration response, enum2xml() without the
+ * enumeration so responses can be rendered an object at a time
+ */
 int
-enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
-         int xmlAs, unsigned int flags, char *httpHost)
+object2xml(void *object, CMPIType type, UtilStringBuffer * sb,
+           int xmlAs, unsigned int flags, char *httpHost)
 {
   CMPIObjectPath *cop;
   CMPIInstance   *ci;
   CMPIConstClass *cl;
 
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "object2xml");
+
+  if (type == CMPI_ref) {
+    cop = (CMPIObjectPath *) object;
+    if (xmlAs == XML_asClassName)
+      className2xml(cop, sb);
+    else if (xmlAs == XML_asObjectPath) {
+      SFCB_APPENDCHARS_BLOCK(sb, "<OBJECTPATH>\n");
+      SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
+      nsPath2xml(cop, sb, httpHost);
+      instanceName2xml(cop, sb);
+      SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
+      SFCB_APPENDCHARS_BLOCK(sb, "</OBJECTPATH>\n");
+    } else
+      instanceName2xml(cop, sb);
+  } else if (type == CMPI_class) {
+    cl = (CMPIConstClass *) object;
+    cls2xml(cl, sb, flags);
+  } else if (type == CMPI_instance) {
+    ci = (CMPIInstance *) object;
+    cop = CMGetObjectPath(ci, NULL);
+    if (xmlAs == XML_asObj) {
+      SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.OBJECTWITHPATH>\n");
+      SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
+      nsPath2xml(cop, sb, httpHost);
+    } else
+      SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.NAMEDINSTANCE>\n");
+    instanceName2xml(cop, sb);
+    if (xmlAs == XML_asObj)
+      SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
+    instance2xml(ci, sb, flags);
+    if (xmlAs == XML_asObj)
+      SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.OBJECTWITHPATH>\n");
+    else
+      SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.NAMEDINSTANCE>\n");
+    cop->ft->release(cop);
+  }
+
+  _SFCB_RETURN(0);
+}
+
+int
+enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb, CMPIType type,
+         int xmlAs, unsigned int flags, char *httpHost)
+{
+  CMPIData        d;
+
   _SFCB_ENTER(TRACE_CIMXMLPROC, "enum2xml");
 
   while (CMHasNext(enm, NULL)) {
-    if (type == CMPI_ref) {
-      cop = CMGetNext(enm, NULL).value.ref;
-      if (xmlAs == XML_asClassName)
-        className2xml(cop, sb);
-      else if (xmlAs == XML_asObjectPath) {
-        SFCB_APPENDCHARS_BLOCK(sb, "<OBJECTPATH>\n");
-        SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
-        nsPath2xml(cop, sb, httpHost);
-        instanceName2xml(cop, sb);
-        SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
-        SFCB_APPENDCHARS_BLOCK(sb, "</OBJECTPATH>\n");
-      } else
-        instanceName2xml(cop, sb);
-    } else if (type == CMPI_class) {
-      cl = (CMPIConstClass *) CMGetNext(enm, NULL).value.inst;
-      cls2xml(cl, sb, flags);
-    } else if (type == CMPI_instance) {
-      ci = CMGetNext(enm, NULL).value.inst;
-      cop = CMGetObjectPath(ci, NULL);
-      if (xmlAs == XML_asObj) {
-        SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.OBJECTWITHPATH>\n");
-        SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
-        nsPath2xml(cop, sb, httpHost);
-      } else
-        SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.NAMEDINSTANCE>\n");
-      instanceName2xml(cop, sb);
-      if (xmlAs == XML_asObj)
-        SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
-      instance2xml(ci, sb, flags);
-      if (xmlAs == XML_asObj)
-        SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.OBJECTWITHPATH>\n");
-      else
-        SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.NAMEDINSTANCE>\n");
-      cop->ft->release(cop);
-    }
+    d = CMGetNext(enm, NULL);
+    object2xml(type == CMPI_ref ? (void *) d.value.ref : (void *) d.value.inst,
+               type, sb, xmlAs, flags, httpHost);
   }
 
   _SFCB_RETURN(0);
 }
 
+/*
+ * VALUE.INSTANCEWITHPATH, as returned by the pull operations
+ */
+int
+instanceWithPath2xml(CMPIInstance *ci, UtilStringBuffer * sb,
+                     unsigned int flags, char *httpHost)
+{
+  CMPIObjectPath *cop;
+
+  _SFCB_ENTER(TRACE_CIMXMLPROC, "instanceWithPath2xml");
+
+  cop = CMGetObjectPath(ci, NULL);
+  SFCB_APPENDCHARS_BLOCK(sb, "<VALUE.INSTANCEWITHPATH>\n");
+  SFCB_APPENDCHARS_BLOCK(sb, "<INSTANCEPATH>\n");
+  nsPath2xml(cop, sb, httpHost);
+  instanceName2xml(cop, sb);
+  SFCB_APPENDCHARS_BLOCK(sb, "</INSTANCEPATH>\n");
+  instance2xml(ci, sb, flags);
+  SFCB_APPENDCHARS_BLOCK(sb, "</VALUE.INSTANCEWITHPATH>\n");
+  cop->ft->release(cop);
+
+  _SFCB_RETURN(0);
+}
+
 #ifdef HAVE_QUALREP
 int
 qualifierDeclaration2xml(CMPIQualifierDecl * q, UtilStringBuffer * sb)
@@ -49,9 +49,14 @@ extern int      cls2xml(CMPIConstClass * cls, UtilStringBuffer * sb,
 extern int      instance2xml(CMPIInstance *ci, UtilStringBuffer * sb,
                              unsigned int flags);
 extern int      args2xml(CMPIArgs * args, UtilStringBuffer * sb);
+extern int      object2xml(void *object, CMPIType type,
+                           UtilStringBuffer * sb, int xmlAs,
+                           unsigned int flags, char *httpHost);
 extern int      enum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb,
                          CMPIType type, int xmlAs, unsigned int flags,
                          char *httpHost);
+extern int      instanceWithPath2xml(CMPIInstance *ci, UtilStringBuffer * sb,
+                                     unsigned int flags, char *httpHost);
 extern int      qualiEnum2xml(CMPIEnumeration *enm, UtilStringBuffer * sb);
 extern CMPIValue union2CMPIValue(CMPIType type, char *val,
                                  XtokValueArray * arr);
@@ -80,7 +80,7 @@ extern int yylex (void *lvalp, ParserControl *parm);
 static void setRequest(void *parm, void *req, unsigned long size, int type)
 {
    ((ParserControl*)parm)->reqHdr.cimRequestLength=size;
-   ((ParserControl*)parm)->reqHdr.cimRequest=malloc(size);
+   ((ParserControl*)parm)->reqHdr.cimRequest=parserMalloc(parm,size);
    memcpy(((ParserControl*)parm)->reqHdr.cimRequest,req,size);
    ((ParserControl*)parm)->reqHdr.opType = type;
 }
@@ -1579,10 +1579,10 @@ updateMethodParamTypes(RequestHdr * hdr)
   _SFCB_RETURN(CMPI_RC_OK);
 }
 
-static void addProperty(XtokProperties *ps, XtokProperty *p)
+static void addProperty(void *parm, XtokProperties *ps, XtokProperty *p)
 {
    XtokProperty *np;
-   np=malloc(sizeof(*np));
+   np=parserMalloc(parm,sizeof(*np));
    memcpy(np,p,sizeof(XtokProperty));
    np->next=NULL;
    if (ps->last) {
@@ -1592,10 +1592,10 @@ static void addProperty(XtokProperties *ps, XtokProperty *p)
    ps->last=np;
 }
 
-static void addParamValue(XtokParamValues *vs, XtokParamValue *v)
+static void addParamValue(void *parm, XtokParamValues *vs, XtokParamValue *v)
 {
    XtokParamValue *nv;
-   nv=malloc(sizeof(*nv));
+   nv=parserMalloc(parm,sizeof(*nv));
    memcpy(nv,v,sizeof(XtokParamValue));
    nv->next=NULL;
    if (vs->last) {
@@ -1605,10 +1605,10 @@ static void addParamValue(XtokParamValues *vs, XtokParamValue *v)
    vs->last=nv;
 }
 
-static void addQualifier(XtokQualifiers *qs, XtokQualifier *q)
+static void addQualifier(void *parm, XtokQualifiers *qs, XtokQualifier *q)
 {
    XtokQualifier *nq;
-   nq=malloc(sizeof(*nq));
+   nq=parserMalloc(parm,sizeof(*nq));
    memcpy(nq,q,sizeof(XtokQualifier));
    nq->next=NULL;
    if (qs->last) {
@@ -1618,10 +1618,10 @@ static void addQualifier(XtokQualifiers *qs, XtokQualifier *q)
    qs->last=nq;
 }
 
-static void addMethod(XtokMethods *ms, XtokMethod *m)
+static void addMethod(void *parm, XtokMethods *ms, XtokMethod *m)
 {
    XtokMethod *nm;
-   nm=malloc(sizeof(*nm));
+   nm=parserMalloc(parm,sizeof(*nm));
    memcpy(nm,m,sizeof(XtokMethod));
    nm->next=NULL;
    if (ms->last) {
@@ -1631,10 +1631,10 @@ static void addMethod(XtokMethods *ms, XtokMethod *m)
    ms->last=nm;
 }
 
-static void addParam(XtokParams *ps, XtokParam *p)
+static void addParam(void *parm, XtokParams *ps, XtokParam *p)
 {
    XtokParam *np;
-   np=malloc(sizeof(*np));
+   np=parserMalloc(parm,sizeof(*np));
    memcpy(np,p,sizeof(XtokParam));
    np->next=NULL;
    if (ps->last) {
@@ -2519,11 +2519,11 @@ paramValues
     {
       $$.first = NULL;
       $$.last = NULL;
-      addParamValue(&$$,&$1);
+      addParamValue(parm,&$$,&$1);
     }
     | paramValues paramValue
     {
-      addParamValue(&$$,&$2);
+      addParamValue(parm,&$$,&$2);
     }
 ;
 
@@ -4243,15 +4243,15 @@ classData
     | classData qualifier
     {
        ((ParserControl*)parm)->Qs++;
-       addQualifier(&(((ParserControl*)parm)->qualifiers),&$2);
+       addQualifier(parm,&(((ParserControl*)parm)->qualifiers),&$2);
     }
     | classData property     {
        ((ParserControl*)parm)->Ps++;
-       addProperty(&(((ParserControl*)parm)->properties),&$2);
+       addProperty(parm,&(((ParserControl*)parm)->properties),&$2);
     }
     | classData method     {
         ((ParserControl*)parm)->Ms++;
-        addMethod(&(((ParserControl*)parm)->methods),&$2);
+        addMethod(parm,&(((ParserControl*)parm)->methods),&$2);
     }
 ;
 
@@ -4277,7 +4277,7 @@ methodData
        if (((ParserControl*)parm)->MQs==0) 
           memset(&$$.qualifiers,0,sizeof($$.qualifiers));
        ((ParserControl*)parm)->MQs++;
-       addQualifier(&($$.qualifiers),&$2);
+       addQualifier(parm,&($$.qualifiers),&$2);
     }      
     | methodData XTOK_PARAM parameter ZTOK_PARAM 
     {
@@ -4287,7 +4287,7 @@ methodData
        if (((ParserControl*)parm)->MPQs) 
           $2.qualifiers=$3.qualifiers;
        else memset(&$2.qualifiers,0,sizeof($2.qualifiers));
-       addParam(&($$.params),&$2);
+       addParam(parm,&($$.params),&$2);
        ((ParserControl*)parm)->MPQs=0; 
     }      
 ;  
@@ -4299,7 +4299,7 @@ parameter
        if (((ParserControl*)parm)->MPQs==0) 
           memset(&$$.qualifiers,0,sizeof($$.qualifiers));
        ((ParserControl*)parm)->MPQs++; 
-       addQualifier(&($$.qualifiers),&$2);
+       addQualifier(parm,&($$.qualifiers),&$2);
     }
 ;
 
@@ -4331,11 +4331,11 @@ instanceData
     }
     | instanceData qualifier 
     {
-       addQualifier(&($$.qualifiers),&$2);
+       addQualifier(parm,&($$.qualifiers),&$2);
     }
     | instanceData property 
     {
-       addProperty(&($$.properties),&$2);
+       addProperty(parm,&($$.properties),&$2);
     }
 ;
 
@@ -4422,7 +4422,7 @@ qualifierList
     }
     | qualifierList qualifier
     {
-       addQualifier(&$1,&$2);
+       addQualifier(parm,&$1,&$2);
        $$ = $1;
     }
 ;
@@ -4482,16 +4482,15 @@ localNameSpacePath
 namespaces
     : XTOK_NAMESPACE ZTOK_NAMESPACE
     {
-       $$.cns=strdup($1.ns);
+       $$.cns=parserStrdup(parm,$1.ns);
     }
     | namespaces XTOK_NAMESPACE ZTOK_NAMESPACE
     {
        int l=strlen($1.cns)+strlen($2.ns)+2;
-       $$.cns=malloc(l);
+       $$.cns=parserMalloc(parm,l);
        strcpy($$.cns,$1.cns);
        strcat($$.cns,"/");
        strcat($$.cns,$2.ns);
-       free($1.cns);
     }
 ;
 
@@ -4554,13 +4553,13 @@ localClassPath
 value
     : XTOK_VALUE instance ZTOK_VALUE    /* not really standard... */
     {
-       $$.instance = malloc(sizeof(XtokInstance));
+       $$.instance = parserMalloc(parm, sizeof(XtokInstance));
        $$.instance = memcpy($$.instance, &$2, sizeof(XtokInstance));
        $$.type=typeValue_Instance;
     }
     | XTOK_VALUE XTOK_CDATA instance ZTOK_CDATA ZTOK_VALUE
     {
-       $$.instance = malloc(sizeof(XtokInstance));
+       $$.instance = parserMalloc(parm, sizeof(XtokInstance));
        $$.instance = memcpy($$.instance, &$3, sizeof(XtokInstance));
        $$.type=typeValue_Instance;
     }
@@ -4578,7 +4577,7 @@ value
 valueArray
     : XTOK_VALUEARRAY ZTOK_VALUEARRAY
 	{
-	  $$.values=malloc(sizeof(XtokValue));
+	  $$.values=parserMalloc(parm, sizeof(XtokValue));
 	  $$.next=0;
 	} 
     | XTOK_VALUEARRAY valueList ZTOK_VALUEARRAY
@@ -4595,14 +4594,14 @@ valueList
         {
           $$.next=1;
           $$.max=VALUEARRAY_MAX_START;
-          $$.values=malloc(sizeof(XtokValue)*($$.max));
+          $$.values=parserMalloc(parm, sizeof(XtokValue)*($$.max));
           $$.values[0]=$1;
         }
         | valueList value
         {
           if ($$.next == $$.max) { /* max was hit; let's bump it up 50% */
             $$.max = (int)($$.max * ((float)3)/2);
-            $$.values=realloc(($$.values), sizeof(XtokValue)*($$.max));
+            $$.values=parserRealloc(parm, $$.values, sizeof(XtokValue)*($$.next), sizeof(XtokValue)*($$.max));
           }
           $$.values[$$.next]=$2;
           $$.next++;
@@ -4639,14 +4638,14 @@ valueRefList
     {
        $$.next=1;
        $$.max=VALUEREFARRAY_MAX_START;
-       $$.values=malloc(sizeof(XtokValueReference)*($$.max));
+       $$.values=parserMalloc(parm, sizeof(XtokValueReference)*($$.max));
        $$.values[0]=$1;
     }
     | valueRefList valueReference
     {
        if ($$.next == $$.max) { /* max was hit; let's bump it up 50% */
          $$.max = (int)($$.max * ((float)3)/2);
-         $$.values=realloc(($$.values), sizeof(XtokValueReference)*($$.max));
+         $$.values=parserRealloc(parm, $$.values, sizeof(XtokValueReference)*($$.next), sizeof(XtokValueReference)*($$.max));
        }
        $$.values[$$.next]=$2;
        $$.next++;
@@ -6055,7 +6054,7 @@ keyBindings
     {
        $$.next=1;
        $$.max=KEYBINDING_MAX_START;
-       $$.keyBindings=calloc(($$.max),sizeof(XtokKeyBinding));
+       $$.keyBindings=parserCalloc(parm, ($$.max),sizeof(XtokKeyBinding));
        $$.keyBindings[0].name=$1.name;
        $$.keyBindings[0].value=$1.value;
        $$.keyBindings[0].type=$1.type;
@@ -6065,7 +6064,7 @@ keyBindings
     {
        if ($$.next == $$.max) { /* max was hit; let's bump it up 50% */
          $$.max = (int)($$.max * ((float)3)/2);
-         $$.keyBindings=realloc(($$.keyBindings), sizeof(XtokKeyBinding)*($$.max));
+         $$.keyBindings=parserRealloc(parm, $$.keyBindings, sizeof(XtokKeyBinding)*($$.next), sizeof(XtokKeyBinding)*($$.max));
        }
        $$.keyBindings[$$.next].name=$2.name;
        $$.keyBindings[$$.next].value=$2.value;
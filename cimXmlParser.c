@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <cmpi/cmpidt.h>
 
 #include "cimXmlParser.h"
@@ -51,6 +52,92 @@ Throw(XmlBuffer __attribute__ ((unused)) *xb, char *msg)
   exit(1);
 }
 
+/*
+ * Everything the parser builds for one request comes from a chain of
+ * arena blocks hanging off reqHdr.arena; the newest block is first. 
+ */
+typedef struct xmlArena {
+  struct xmlArena *next;
+  char           *cur;
+  char           *end;
+  char           *last;
+} XmlArena;
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+#define ARENA_HDR ARENA_ROUND(sizeof(XmlArena))
+#define ARENA_BLOCK_MIN 8192
+#define ARENA_BLOCK_MAX (256*1024)
+
+void           *
+parserMalloc(void *parm, size_t size)
+{
+  XmlArena      **ap = (XmlArena **) & ((ParserControl *) parm)->reqHdr.arena;
+  XmlArena       *a = *ap;
+  size_t          bsize;
+
+  size = ARENA_ROUND(size);
+  if (a == NULL || (size_t) (a->end - a->cur) < size) {
+    bsize = a ? (size_t) (a->end - (char *) a) * 2 : ARENA_BLOCK_MIN;
+    if (bsize > ARENA_BLOCK_MAX)
+      bsize = ARENA_BLOCK_MAX;
+    if (bsize < size + ARENA_HDR)
+      bsize = size + ARENA_HDR;
+    a = malloc(bsize);
+    a->next = *ap;
+    a->cur = (char *) a + ARENA_HDR;
+    a->end = (char *) a + bsize;
+    *ap = a;
+  }
+  a->last = a->cur;
+  a->cur += size;
+  return a->last;
+}
+
+void           *
+parserCalloc(void *parm, size_t n, size_t size)
+{
+  return memset(parserMalloc(parm, n * size), 0, n * size);
+}
+
+/*
+ * grows in place when p is the latest allocation and still fits 
+ */
+void           *
+parserRealloc(void *parm, void *p, size_t oldSize, size_t size)
+{
+  XmlArena       *a = ((ParserControl *) parm)->reqHdr.arena;
+  void           *np;
+
+  if (p == NULL)
+    return parserMalloc(parm, size);
+  if (a && p == a->last && (size_t) (a->end - a->last) >= ARENA_ROUND(size)) {
+    a->cur = a->last + ARENA_ROUND(size);
+    return p;
+  }
+  np = parserMalloc(parm, size);
+  memcpy(np, p, oldSize < size ? oldSize : size);
+  return np;
+}
+
+char           *
+parserStrdup(void *parm, const char *s)
+{
+  size_t          l = strlen(s) + 1;
+  return memcpy(parserMalloc(parm, l), s, l);
+}
+
+static void
+releaseArena(void *arena)
+{
+  XmlArena       *a = arena,
+      *n;
+  for (; a; a = n) {
+    n = a->next;
+    free(a);
+  }
+}
+
 static XmlBuffer *
 newXmlBuffer(char *s)
 {
@@ -422,7 +509,10 @@ getContent(XmlBuffer * xb)
   /*
    * scan through until we hit an '<' or end of buffer
    */
-  for (; *xb->cur != '<' && xb->cur < xb->last; xb->cur++);
+  if (xb->cur < xb->last) {
+    help = memchr(xb->cur, '<', xb->last - xb->cur);
+    xb->cur = help ? help : xb->last;
+  }
 
   /*
    * store the char we found, set it to null to use as a marker in the
@@ -454,10 +544,8 @@ getContent(XmlBuffer * xb)
    * unescape 
    */
   help = start;
-  while (help < end) {
-    if (*help == '&') {
-      end -= xmlUnescape(help, end);
-    }
+  while (help < end && (help = memchr(help, '&', end - help)) != NULL) {
+    end -= xmlUnescape(help, end);
     help += 1;
   }
   return start;
@@ -1634,11 +1722,86 @@ static Tags     tags[] = {
   {"", procCdata, ZTOK_CDATA},
 };
 
+/*
+ * open addressing index over tags[], keyed by the complete tag name, so
+ * yylex() does not have to try every entry with nextEquals() 
+ */
+#define TAG_INDEX_SIZE 128
+
+static unsigned char tagIndex[TAG_INDEX_SIZE];
+static pthread_once_t tagIndexOnce = PTHREAD_ONCE_INIT;
+
+static unsigned int
+tagHash(const char *n, int l)
+{
+  unsigned int    h = 2166136261u;
+  while (l--)
+    h = (h ^ (unsigned char) *n++) * 16777619u;
+  return h;
+}
+
+static void
+buildTagIndex()
+{
+  int             i,
+                  m;
+  unsigned int    h;
+
+  for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
+    if (!isalpha(*tags[i].tag))
+      continue;
+    for (h = tagHash(tags[i].tag, strlen(tags[i].tag)) % TAG_INDEX_SIZE;
+         tagIndex[h]; h = (h + 1) % TAG_INDEX_SIZE);
+    tagIndex[h] = i + 1;
+  }
+}
+
+/*
+ * returns the tags[] entry for the tag name starting at n, -1 if the
+ * name is not in the index 
+ */
+static int
+lookupTag(const char *n)
+{
+  const char     *e = n;
+  unsigned int    h;
+  int             i;
+
+  while (isalnum(*e) || *e == '.')
+    e++;
+  if (e == n)
+    return -1;
+
+  pthread_once(&tagIndexOnce, buildTagIndex);
+  for (h = tagHash(n, e - n) % TAG_INDEX_SIZE; (i = tagIndex[h]);
+       h = (h + 1) % TAG_INDEX_SIZE) {
+    i--;
+    if (strncmp(n, tags[i].tag, e - n) == 0 && tags[i].tag[e - n] == 0)
+      return i;
+  }
+  return -1;
+}
+
+/*
+ * old style linear search, for names not in the index 
+ */
+static int
+scanTags(const char *n)
+{
+  int             i,
+                  m;
+
+  for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
+    if (nextEquals(n, tags[i].tag) == 1)
+      return i;
+  }
+  return -1;
+}
+
 int
 yylex(YYSTYPE * lvalp, ParserControl * parm)
 {
   int             i,
-                  m,
                   rc;
   char           *next;
 
@@ -1665,11 +1828,11 @@ yylex(YYSTYPE * lvalp, ParserControl * parm)
      * matching opening tag 
      */
     if (*next == '/') {
-      for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
-        if (nextEquals(next + 1, tags[i].tag) == 1) {
-          skipTag(parm->xmb);
-          _SFCB_RETURN(tags[i].etag);
-        }
+      if ((i = lookupTag(next + 1)) < 0)
+        i = scanTags(next + 1);
+      if (i >= 0) {
+        skipTag(parm->xmb);
+        _SFCB_RETURN(tags[i].etag);
       }
     }
 
@@ -1678,17 +1841,20 @@ yylex(YYSTYPE * lvalp, ParserControl * parm)
        * skip comment section 
        */
       if (strncmp(parm->xmb->cur, "<!--", 4) == 0) {
-        parm->xmb->cur = strstr(parm->xmb->cur, "-->") + 3;
+        next = strstr(parm->xmb->cur + 4, "-->");
+        if (next == NULL) {
+          parm->xmb->cur = parm->xmb->last;
+          _SFCB_RETURN(0);
+        }
+        parm->xmb->cur = next + 3;
         continue;
       }
-      for (i = 0, m = sizeof(tags) / sizeof(Tags); i < m; i++) {
-        if (nextEquals(next, tags[i].tag) == 1) {
-
-          // fprintf(stderr, " yylex| processing for: %.10s\n", next);
-          rc = tags[i].process(lvalp, parm);    /* call a procXXX fn based 
+      if ((i = lookupTag(next)) < 0)
+        i = scanTags(next);
+      if (i >= 0) {
+        rc = tags[i].process(lvalp, parm);      /* call a procXXX fn based 
                                                  * on tag name */
-          _SFCB_RETURN(rc);
-        }
+        _SFCB_RETURN(rc);
       }
     }
     break;
@@ -1722,6 +1888,7 @@ scanCimXmlRequest(CimRequestContext *ctx, char *xmlData, int *rc)
   control.reqHdr.rc = 0;
   control.reqHdr.errMsg = NULL;
   control.reqHdr.binCtx = calloc(1, sizeof(BinRequestContext));
+  control.reqHdr.arena = NULL;
   control.reqHdr.principal = ctx->principal;
   control.reqHdr.sessionId = ctx->sessionId;
   control.reqHdr.role = ctx->role;
@@ -1754,427 +1921,10 @@ scanCimXmlRequest(CimRequestContext *ctx, char *xmlData, int *rc)
   return control.reqHdr;
 }
 
-static void     freeReference(XtokValueReference * op);
-
-static void
-freeNameSpacePath(XtokNameSpacePath * op)
-{
-  if (op->nameSpacePath) {
-    free(op->nameSpacePath);
-  }
-}
-
-static void
-freeKeyBinding(XtokKeyBinding * op)
-{
-  if (op->type && strcmp(op->type, "ref") == 0) {
-    freeReference(&op->ref);
-  }
-}
-
-static void
-freeKeyBindings(XtokKeyBindings * op)
-{
-  int             i;
-  if (op->keyBindings) {
-    for (i = 0; i < op->next; i++) {
-      freeKeyBinding(op->keyBindings + i);
-    }
-    free(op->keyBindings);
-  }
-}
-
-static void
-freeInstanceName(XtokInstanceName * op)
-{
-  freeKeyBindings(&op->bindings);
-}
-
-static void
-freeLocalInstancePath(XtokLocalInstancePath * op)
-{
-  if (op->path) {
-    free(op->path);
-  }
-  freeInstanceName(&op->instanceName);
-}
-
-static void
-freeInstancePath(XtokInstancePath * op)
-{
-  freeNameSpacePath(&op->path);
-  freeInstanceName(&op->instanceName);
-}
-
-static void
-freeReference(XtokValueReference * op)
-{
-  switch (op->type) {
-  case typeValRef_InstanceName:
-    freeInstanceName(&op->instanceName);
-    break;
-  case typeValRef_InstancePath:
-    freeInstancePath(&op->instancePath);
-    break;
-  case typeValRef_LocalInstancePath:
-    freeLocalInstancePath(&op->localInstancePath);
-    break;
-  }
-}
-
-static void
-freeRefArray(XtokValueRefArray * op)
-{
-  int             i;
-  if (op->values) {
-    for (i = 0; i < op->next; i++) {
-      freeReference(op->values + i);
-    }
-    free(op->values);
-  }
-}
-
-static void     freeInstance(XtokInstance * op);
-
-static void
-freeValue(XtokValue * op)
-{
-  if (op->type == typeValue_Instance && op->instance) {
-    freeInstance(op->instance);
-    free(op->instance);
-  }
-  /*
-   * else if(op->type == typeValue_Class && op->class) {
-   * freeClass(op->class); free(op->class); }
-   */
-}
-
-static void
-freeArray(XtokValueArray * op)
-{
-  int             i;
-  if (op->values) {
-    for (i = 0; i < op->next; i++) {
-      freeValue(op->values + i);
-    }
-    free(op->values);
-  }
-}
-
-static void
-freeParamValue(XtokParamValue * op)
-{
-  if ((op->type & CMPI_refA) == CMPI_refA) {
-    freeRefArray(&op->valueRefArray);
-  } else if (op->type & CMPI_ARRAY) {
-    freeArray(&op->valueArray);
-  } else if ((op->type & CMPI_ref) == CMPI_ref) {
-    freeReference(&op->valueRef);
-  } else if ((op->type & CMPI_instance) == CMPI_instance
-             || (op->type & CMPI_class) == CMPI_class) {
-    freeValue(&op->value);
-  }
-}
-
-static void
-freeParamValues(XtokParamValues * op)
-{
-  XtokParamValue *pv = op->first,
-      *dv;
-  while (pv) {
-    /* 3486814 : type is invalid, value is null */
-    if (pv->type != USHRT_MAX)
-       freeParamValue(pv);
-    dv = pv;
-    pv = pv->next;
-    free(dv);
-  }
-}
-
-static void
-freeQualifier(XtokQualifier * op)
-{
-  if (op->type & CMPI_ARRAY) {
-    freeArray(&op->valueArray);
-  }
-}
-
-static void
-freeQualifiers(XtokQualifiers * op)
-{
-  XtokQualifier  *qv = op->first,
-      *dv;
-  while (qv) {
-    freeQualifier(qv);
-    dv = qv;
-    qv = qv->next;
-    free(dv);
-  }
-}
-
-static void     freeInstance(XtokInstance * op);
-
-static void
-freeProperty(XtokProperty * op)
-{
-  if (op->valueType & CMPI_ARRAY) {
-    freeArray(&op->val.list);
-  } else if ((op->valueType & CMPI_ref) == CMPI_ref) {
-    freeReference(&op->val.ref);
-  }
-  if (op->val.val.type == typeValue_Instance && op->val.val.instance) {
-    freeInstance(op->val.val.instance);
-    free(op->val.val.instance);
-  }
-  freeQualifiers(&op->val.qualifiers);
-}
-
-static void
-freeProperties(XtokProperties * op)
-{
-  XtokProperty   *pv = op->first,
-      *dv;
-  while (pv) {
-    freeProperty(pv);
-    dv = pv;
-    pv = pv->next;
-    free(dv);
-  }
-}
-
-static void
-freeParam(XtokParam * op)
-{
-  freeQualifiers(&op->qualifiers);
-}
-
-static void
-freeParams(XtokParams * op)
-{
-  XtokParam      *pv = op->first,
-      *dv;
-  while (pv) {
-    freeParam(pv);
-    dv = pv;
-    pv = pv->next;
-    free(dv);
-  }
-}
-
-static void
-freeMethod(XtokMethod * op)
-{
-  freeQualifiers(&op->qualifiers);
-  freeParams(&op->params);
-}
-
-static void
-freeMethods(XtokMethods * op)
-{
-  XtokMethod     *mv = op->first,
-      *dv;
-  while (mv) {
-    freeMethod(mv);
-    dv = mv;
-    mv = mv->next;
-    free(dv);
-  }
-}
-
-static void
-freeInstance(XtokInstance * op)
-{
-  freeProperties(&op->properties);
-  freeQualifiers(&op->qualifiers);
-}
-
-static void
-freeNewValue(XtokNewValue * op)
-{
-  switch (op->type) {
-  case typeValue_Instance:
-    /*
-     * case typeValue_Class: 
-     */
-    freeValue(&op->val);
-    break;
-  case CMPI_ref:
-    freeReference(&op->ref);
-    break;
-  case CMPI_ARRAY:
-    freeArray(&op->arr);
-    break;
-  }
-}
-
-static void
-freeMethodCall(XtokMethodCall * op)
-{
-  if (op->instName) {
-    freeInstanceName(&op->instanceName);
-  }
-  freeParamValues(&op->paramValues);
-}
-
-static void
-freeGetClass(XtokGetClass * op)
-{
-  freeArray(&op->propertyList);
-}
-
-static void
-freeCreateClass(XtokCreateClass * op)
-{
-  freeProperties(&op->cls.properties);
-  freeQualifiers(&op->cls.qualifiers);
-  freeMethods(&op->cls.methods);
-}
-
-static void
-freeGetInstance(XtokGetInstance * op)
-{
-  freeInstanceName(&op->instanceName);
-  freeArray(&op->propertyList);
-}
-
-static void
-freeCreateInstance(XtokCreateInstance * op)
-{
-  freeInstance(&op->instance);
-}
-
-static void
-freeModifyInstance(XtokModifyInstance * op)
-{
-  freeInstance(&op->namedInstance.instance);
-  freeInstanceName(&op->namedInstance.path);
-  freeArray(&op->propertyList);
-}
-
-static void
-freeDeleteInstance(XtokDeleteInstance * op)
-{
-  freeInstanceName(&op->instanceName);
-}
-
-static void
-freeEnumInstances(XtokEnumInstances * op)
-{
-  freeArray(&op->propertyList);
-}
-
-static void
-freeAssociatorNames(XtokAssociatorNames * op)
-{
-  if (op->objNameSet) {
-    freeInstanceName(&op->objectName);
-  }
-}
-
-static void
-freeReferenceNames(XtokReferenceNames * op)
-{
-  if (op->objNameSet) {
-    freeInstanceName(&op->objectName);
-  }
-}
-
-static void
-freeAssociators(XtokAssociators * op)
-{
-  if (op->objNameSet) {
-    freeInstanceName(&op->objectName);
-  }
-  freeArray(&op->propertyList);
-}
-
-static void
-freeReferences(XtokReferences * op)
-{
-  if (op->objNameSet) {
-    freeInstanceName(&op->objectName);
-  }
-  freeArray(&op->propertyList);
-}
-
-static void
-freeSetQualifier(XtokSetQualifier * op)
-{
-  if (op->qualifierdeclaration.data.type & CMPI_ARRAY) {
-    freeArray(&op->qualifierdeclaration.data.valueArray);
-  }
-}
-
-static void
-freeGetProperty(XtokGetProperty * op)
-{
-  freeInstanceName(&op->instanceName);
-}
-
-static void
-freeSetProperty(XtokSetProperty * op)
-{
-  freeInstanceName(&op->instanceName);
-  freeNewValue(&op->newVal);
-}
-
 void
 freeCimXmlRequest(RequestHdr hdr)
 {
-  if (hdr.cimRequest) {
-    OperationHdr   *op = (OperationHdr *) hdr.cimRequest;
-    if (op->nameSpace.data) {
-      free(op->nameSpace.data);
-    }
-    switch (hdr.opType) {
-    case OPS_InvokeMethod:
-      freeMethodCall((XtokMethodCall *) hdr.cimRequest);
-      break;
-    case OPS_GetClass:
-      freeGetClass((XtokGetClass *) hdr.cimRequest);
-      break;
-    case OPS_CreateClass:
-      freeCreateClass((XtokCreateClass *) hdr.cimRequest);
-      break;
-    case OPS_GetInstance:
-      freeGetInstance((XtokGetInstance *) hdr.cimRequest);
-      break;
-    case OPS_CreateInstance:
-      freeCreateInstance((XtokCreateInstance *) hdr.cimRequest);
-      break;
-    case OPS_ModifyInstance:
-      freeModifyInstance((XtokModifyInstance *) hdr.cimRequest);
-      break;
-    case OPS_DeleteInstance:
-      freeDeleteInstance((XtokDeleteInstance *) hdr.cimRequest);
-      break;
-    case OPS_EnumerateInstances:
-      freeEnumInstances((XtokEnumInstances *) hdr.cimRequest);
-      break;
-    case OPS_AssociatorNames:
-      freeAssociatorNames((XtokAssociatorNames *) hdr.cimRequest);
-      break;
-    case OPS_ReferenceNames:
-      freeReferenceNames((XtokReferenceNames *) hdr.cimRequest);
-      break;
-    case OPS_Associators:
-      freeAssociators((XtokAssociators *) hdr.cimRequest);
-      break;
-    case OPS_References:
-      freeReferences((XtokReferences *) hdr.cimRequest);
-      break;
-    case OPS_SetQualifier:
-      freeSetQualifier((XtokSetQualifier *) hdr.cimRequest);
-      break;
-    case OPS_GetProperty:
-      freeGetProperty((XtokGetProperty *) hdr.cimRequest);
-      break;
-    case OPS_SetProperty:
-      freeSetProperty((XtokSetProperty *) hdr.cimRequest);
-      break;
-    }
-    free(hdr.cimRequest);
-  }
+  releaseArena(hdr.arena);
   if (hdr.errMsg)
     free(hdr.errMsg);
 }
@@ -90,7 +90,7 @@ extern void     freeCimXmlRequest(RequestHdr hdr);
 
 typedef struct xtokNameSpace {
   char           *ns;
-  char           *cns;          // must be free'd
+  char           *cns;
 } XtokNameSpace;
 
 typedef struct xtokMessage {
@@ -1150,6 +1150,15 @@ typedef struct parser_control {
   jmp_buf         env;
 } ParserControl;
 
+/*
+ * parse tree allocations, released all at once by freeCimXmlRequest() 
+ */
+extern void    *parserMalloc(void *parm, size_t size);
+extern void    *parserCalloc(void *parm, size_t n, size_t size);
+extern void    *parserRealloc(void *parm, void *p, size_t oldSize,
+                              size_t size);
+extern char    *parserStrdup(void *parm, const char *s);
+
 #endif
 /* MODELINES */
 /* DO NOT EDIT BELOW THIS COMMENT */
@@ -152,6 +152,58 @@ removeChild(ClassRegister * cr, const char *pn, const char *chd)
     }
 }
 
+/*
+ * Uses the classes of a mapped classSchemas in place instead of reading
+ * them into the heap. Classes added later are appended to the file and
+ * kept in the heap as before, removing one rewrites the file, existing
+ * mappings are not affected by either.
+ */
+static int
+mapClassRegister(ClassRegister * cr, char *fin, char *fname)
+{
+  ClassBase      *cb = (ClassBase *) (cr + 1);
+  ClassImage     *img;
+  CMPIConstClass *cc;
+  ClClass        *cls;
+  ClVersionRecord *vr;
+  char           *cn;
+  long            total = 0;
+
+  if ((img = openClassImageFile(fin, 0)) == NULL)
+    return 0;
+
+  cr->fn = strdup(fin);
+  cr->vr = vr = getClassImageVersion(img);
+  cb->ht = UtilFactory->newHashTable(61,
+                                     UtilHashTable_charKey |
+                                     UtilHashTable_ignoreKeyCase);
+  MRWInit(&cb->mrwLock);
+
+  for (cls = nextImageClass(img, NULL); cls;
+       cls = nextImageClass(img, cls)) {
+    cc = newImageConstClass(img, cls);
+    cn = (char *) cc->ft->getCharClassName(cc);
+    if (cn == NULL || strncmp(cn, "DMY_", 4) == 0) {
+      cc->ft->release(cc);
+      continue;
+    }
+    total += cls->hdr.size;
+    cb->ht->ft->put(cb->ht, cn, cc);
+    if (cc->ft->isAssociation(cc)) {
+      cr->assocs++;
+      if (cc->ft->getCharSuperClassName(cc) == NULL)
+        cr->topAssocs++;
+    }
+  }
+
+  mlogf(M_INFO, M_SHOW,
+        "--- ClassProvider for %s (%d.%d-%d) mapping %ld bytes\n", fname,
+        vr->version, vr->level, vr->objImplLevel, total);
+
+  buildInheritanceTable(cr);
+  return 1;
+}
+
 static ClassRegister *
 newClassRegister(char *fname)
 {
@@ -174,6 +226,8 @@ newClassRegister(char *fname)
   strcpy(fin, fname);
 
   strcat(fin, "/classSchemas");
+  if (mapClassRegister(cr, fin, fname))
+    return cr;
   in = fopen(fin, "r");
 
   if (in == NULL) {
@@ -902,6 +956,11 @@ ClassProviderGetClass(CMPIClassMI * mi,
   if (cl) {
     _SFCB_TRACE(1, ("--- Class found"));
     if(properties) {
+      /*
+       * filter a copy, the registered class may be mapped read only 
+       */
+      cl = cl->ft->clone(cl, NULL);
+      memLinkInstance((CMPIInstance *) cl);
       filterClass(cl, properties);
     }
     CMReturnInstance(rslt, (CMPIInstance *) cl);
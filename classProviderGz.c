@@ -20,11 +20,19 @@
  */
 
 #include "classProviderCommon.h"
+#include "classSchemaBlocks.h"
 #include <zlib.h>
 
 #define LOCALCLASSNAME "ClassProvider"
 
 static unsigned int cacheLimit = 10;
+/*
+ * the cache keeps at least cacheLimit classes and, with config property
+ * classProviderCacheMemory set, as many more as fit into that many bytes,
+ * shared by all namespaces 
+ */
+static long     cacheMemory = 0;
+static long     cachedBytes = 0;
 
 typedef struct _Class_Register_FT Class_Register_FT;
 struct _ClassRegister {
@@ -35,6 +43,8 @@ struct _ClassRegister {
                   topAssocs;
   char           *fn;
   gzFile          f;
+  ClassImage     *img;          /* uncompressed copy mapped, or NULL */
+  SchemaBlocks   *blocks;       /* block index of f, or NULL */
 };
 typedef struct _ClassRegister ClassRegister;
 
@@ -45,6 +55,7 @@ typedef struct _ClassRecord {
   z_off_t         position;
   long            length;
   CMPIConstClass *cachedCls;
+  long            cachedSize;
   unsigned int    flags;
 #define CREC_isAssociation 1
 } ClassRecord;
@@ -170,12 +181,51 @@ getNextClassRecord(ClassRegister * cr, Iterator i, char **cn,
   return cb->ht->ft->getNext(cb->ht, i, (void **) cn, (void **) crec);
 }
 
+/*
+ * Heap used by a cached class, classes of the image cost just their
+ * wrapper.
+ */
+static long
+classCost(CMPIConstClass * cc)
+{
+  if (isImageConstClass(cc))
+    return sizeof(*cc);
+  return sizeof(*cc) + ClSizeClass((ClClass *) cc->hdl);
+}
+
+/*
+ * reads the class of record crec, taken in place from the class image
+ * when there is one, else inflating just the block(s) holding it when
+ * the schema is block compressed 
+ */
+static CMPIConstClass *
+readClass(ClassRegister * cr, const char *cn, ClassRecord * crec)
+{
+  CMPIConstClass *cc;
+  void           *cls;
+  char           *buf;
+
+  if (cr->img && (cls = getImageClass(cr->img, cn)))
+    return newImageConstClass(cr->img, cls);
+
+  buf = malloc(crec->length);
+  if (cr->blocks == NULL
+      || readSchemaBlocks(cr->blocks, crec->position, buf, crec->length)) {
+    gzseek(cr->f, crec->position, SEEK_SET);
+    gzread(cr->f, buf, crec->length);
+  }
+
+  cc = NEW(CMPIConstClass);
+  cc->hdl = buf;
+  cc->ft = CMPIConstClassFT;
+  cc->ft->relocate(cc);
+  return cc;
+}
+
 static Iterator
 getFirstClass(ClassRegister * cr, char **cn, CMPIConstClass ** cls,
               void **id)
 {
-  char           *buf;
-  CMPIConstClass *cc;
   ClassBase      *cb = (ClassBase *) cr->hdl;
   ClassRecord    *crec;
 
@@ -191,16 +241,7 @@ getFirstClass(ClassRegister * cr, char **cn, CMPIConstClass ** cls,
   }
   *id = NULL;
 
-  gzseek(cr->f, crec->position, SEEK_SET);
-
-  buf = malloc(crec->length);
-  gzread(cr->f, buf, crec->length);
-
-  cc = NEW(CMPIConstClass);
-  cc->hdl = buf;
-  cc->ft = CMPIConstClassFT;
-  cc->ft->relocate(cc);
-  *cls = cc;
+  *cls = readClass(cr, *cn, crec);
   return i;
 }
 
@@ -208,8 +249,6 @@ static Iterator
 getNextClass(ClassRegister * cr, Iterator ip, char **cn,
              CMPIConstClass ** cls, void **id)
 {
-  char           *buf;
-  CMPIConstClass *cc;
   ClassBase      *cb = (ClassBase *) cr->hdl;
   ClassRecord    *crec;
 
@@ -225,16 +264,7 @@ getNextClass(ClassRegister * cr, Iterator ip, char **cn,
   }
   *id = NULL;
 
-  gzseek(cr->f, crec->position, SEEK_SET);
-
-  buf = malloc(crec->length);
-  gzread(cr->f, buf, crec->length);
-
-  cc = NEW(CMPIConstClass);
-  cc->hdl = buf;
-  cc->ft = CMPIConstClassFT;
-  cc->ft->relocate(cc);
-  *cls = cc;
+  *cls = readClass(cr, *cn, crec);
   return i;
 }
 
@@ -260,12 +290,18 @@ addChild(ClassRegister * cr, const char *p, const char *child)
 
 }
 
+static int
+cacheFull(ClassBase * cb)
+{
+  return cb->cachedCount > cacheLimit && cachedBytes > cacheMemory;
+}
+
 static void
 pruneCache(ClassRegister * cr)
 {
   ClassBase      *cb = (ClassBase *) (cr + 1);
   ClassRecord    *crec;
-  while (cb->cachedCount > cacheLimit) {
+  while (cacheFull(cb) && cb->lastCached) {
     crec = cb->lastCached;
     // fprintf(stderr,"--- removing %s from
     // cache\n",crec->cachedCls->ft->getCharClassName(crec->cachedCls));
@@ -273,6 +309,7 @@ pruneCache(ClassRegister * cr)
                   prevCached);
     crec->cachedCls->ft->release(crec->cachedCls);
     crec->cachedCls = NULL;
+    __sync_fetch_and_sub(&cachedBytes, crec->cachedSize);
     cb->cachedCount--;
   }
 }
@@ -320,6 +357,8 @@ newClassRegister(char *fname)
 
   cr->fn = strdup(fin);
   cr->vr = NULL;
+  cr->img = openClassImage(fname, 0);
+  cr->blocks = openSchemaBlocks(fin);
   pos = gztell(cr->f);
 
   while ((s = gzread(cr->f, &hdr, sizeof(hdr))) == sizeof(hdr)) {
@@ -554,8 +593,6 @@ static CMPIConstClass *
 getClass(ClassRegister * cr, const char *clsName)
 {
   ClassRecord    *crec;
-  CMPIConstClass *cc;
-  char           *buf;
 
   _SFCB_ENTER(TRACE_PROVIDERS, "getClass");
   _SFCB_TRACE(1, ("--- classname %s cReg %p", clsName, cr));
@@ -568,17 +605,11 @@ getClass(ClassRegister * cr, const char *clsName)
 
   if (crec->cachedCls == NULL) {
     // fprintf(stderr,"--- reading class %s\n",clsName);
-    gzseek(cr->f, crec->position, SEEK_SET);
-    buf = malloc(crec->length);
-    gzread(cr->f, buf, crec->length);
-
-    cc = NEW(CMPIConstClass);
-    cc->hdl = buf;
-    cc->ft = CMPIConstClassFT;
-    cc->ft->relocate(cc);
-    crec->cachedCls = cc;
+    crec->cachedCls = readClass(cr, clsName, crec);
+    crec->cachedSize = classCost(crec->cachedCls);
+    __sync_fetch_and_add(&cachedBytes, crec->cachedSize);
     cb->cachedCount++;
-    if (cb->cachedCount >= cacheLimit)
+    if (cacheFull(cb))
       pruneCache(cr);
     ENQ_TOP_LIST(crec, cb->firstCached, cb->lastCached, nextCached,
                  prevCached);
@@ -1143,6 +1174,9 @@ ClassProviderInvokeMethod(CMPIMethodMI * mi,
                         atoi(val + sizeof(char))) > 0) ? cacheLimit : 10;
     }
 
+    if (getControlNum("classProviderCacheMemory", &cacheMemory))
+      cacheMemory = 0;
+
     /* let providerMgr know that we're odne init'ing  */
     semRelease(sfcbSem,INIT_CLASS_PROV_ID);
 
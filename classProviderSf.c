@@ -20,6 +20,7 @@
  */
 
 #include "classProviderCommon.h"
+#include "classSchemaBlocks.h"
 #include <unistd.h>
 #include <getopt.h>
 #include <zlib.h>
@@ -30,6 +31,13 @@ static int      argc = 0;
 static char   **argv = NULL;
 static int      cSize = 10;      // can't be 0!
 static int      rSize = 10;      // can't be 0!
+/*
+ * each cache keeps at least cSize/rSize classes and, with config property
+ * classProviderCacheMemory set, as many more as fit into that many bytes,
+ * shared by both caches of all namespaces 
+ */
+static long     cacheMemory = 0;
+static long     cachedBytes = 0;
 
 typedef enum readCtl { stdRead, tempRead, cached } ReadCtl;
 
@@ -44,6 +52,8 @@ struct _ClassRegister {
                   topAssocs;
   char           *fn;
   gzFile          f;
+  ClassImage     *img;          /* uncompressed copy mapped, or NULL */
+  SchemaBlocks   *blocks;       /* block index of f, or NULL */
 };
 typedef struct _ClassRegister ClassRegister;
 
@@ -57,6 +67,8 @@ typedef struct _ClassRecord {
   long            length;
   CMPIConstClass *cachedCCls;
   CMPIConstClass *cachedRCls;
+  long            cachedCSize,
+                  cachedRSize;
   unsigned int    flags;
 #define CREC_isAssociation 1
 } ClassRecord;
@@ -257,13 +269,26 @@ releaseClass(CMPIConstClass * cls, char *from, int id)
 //   }
 // }
 
+/*
+ * Heap used by a cached class, classes of the image cost just their
+ * wrapper.
+ */
+static long
+classCost(CMPIConstClass * cc)
+{
+  if (isImageConstClass(cc))
+    return sizeof(*cc);
+  return sizeof(*cc) + ClSizeClass((ClClass *) cc->hdl);
+}
+
 static void
 pruneCCache(ClassRegister * cr)
 {
   ClassBase      *cb = (ClassBase *) (cr + 1);
   ClassRecord    *crec;
 
-  while (cb->cachedCCount > cSize) {
+  while (cb->cachedCCount > cSize && cachedBytes > cacheMemory
+         && cb->lastCCached) {
     crec = cb->lastCCached;
     DEQ_FROM_LIST(crec, cb->firstCCached, cb->lastCCached, nextCCached,
                   prevCCached);
@@ -271,6 +296,7 @@ pruneCCache(ClassRegister * cr)
     // fprintf(stderr, "--- pruning Ccache: %s\n", claz); 
     CMRelease(crec->cachedCCls);
     crec->cachedCCls = NULL;
+    __sync_fetch_and_sub(&cachedBytes, crec->cachedCSize);
     cb->cachedCCount--;
   }
 }
@@ -281,7 +307,8 @@ pruneRCache(ClassRegister * cr)
   ClassBase      *cb = (ClassBase *) (cr + 1);
   ClassRecord    *crec;
 
-  while (cb->cachedRCount > rSize) {
+  while (cb->cachedRCount > rSize && cachedBytes > cacheMemory
+         && cb->lastRCached) {
     crec = cb->lastRCached;
     DEQ_FROM_LIST(crec, cb->firstRCached, cb->lastRCached, nextRCached,
                   prevRCached);
@@ -292,6 +319,7 @@ pruneRCache(ClassRegister * cr)
     // }
     CMRelease(crec->cachedRCls);
     crec->cachedRCls = NULL;
+    __sync_fetch_and_sub(&cachedBytes, crec->cachedRSize);
     cb->cachedRCount--;
   }
 }
@@ -339,6 +367,8 @@ newClassRegister(char *fname)
 
   cr->fn = strdup(fin);
   cr->vr = NULL;
+  cr->img = openClassImage(fname, 0);
+  cr->blocks = openSchemaBlocks(fin);
   pos = gztell(cr->f);
 
   while ((s = gzread(cr->f, &hdr, sizeof(hdr))) == sizeof(hdr)) {
@@ -775,8 +805,10 @@ getResolvedClass(ClassRegister * cr, const char *clsName,
     }
 
     crec->cachedRCls = cc;
+    crec->cachedRSize = classCost(cc);
+    __sync_fetch_and_add(&cachedBytes, crec->cachedRSize);
     cb->cachedRCount++;
-    if (cb->cachedRCount >= rSize) {
+    if (cb->cachedRCount > rSize) {
       pruneRCache(cr);
     }
     ENQ_TOP_LIST(crec, cb->firstRCached, cb->lastRCached, nextRCached,
@@ -796,12 +828,40 @@ getResolvedClass(ClassRegister * cr, const char *clsName,
   _SFCB_RETURN(crec->cachedRCls);
 }
 
+/*
+ * reads the class of record crec, taken in place from the class image
+ * when there is one, else inflating just the block(s) holding it when
+ * the schema is block compressed 
+ */
+static CMPIConstClass *
+readClass(ClassRegister * cr, const char *cn, ClassRecord * crec)
+{
+  CMPIConstClass *cc;
+  void           *cls;
+  char           *buf;
+
+  if (cr->img && (cls = getImageClass(cr->img, cn)))
+    return newImageConstClass(cr->img, cls);
+
+  buf = malloc(crec->length);
+  if (cr->blocks == NULL
+      || readSchemaBlocks(cr->blocks, crec->position, buf, crec->length)) {
+    gzseek(cr->f, crec->position, SEEK_SET);
+    gzread(cr->f, buf, crec->length);
+  }
+
+  cc = NEW(CMPIConstClass);
+  cc->hdl = buf;
+  cc->ft = CMPIConstClassFT;
+  cc->ft->relocate(cc);
+  return cc;
+}
+
 static CMPIConstClass *
 getClass(ClassRegister * cr, const char *clsName, ReadCtl *ctl)
 {
   ClassRecord    *crec;
   CMPIConstClass *cc;
-  char           *buf;
 
   _SFCB_ENTER(TRACE_PROVIDERS, "getClass");
   _SFCB_TRACE(1, ("--- classname %s cReg %p", clsName, cr));
@@ -814,14 +874,7 @@ getClass(ClassRegister * cr, const char *clsName, ReadCtl *ctl)
 
   /* class is not cached */
   if (crec->cachedCCls == NULL) {
-    gzseek(cr->f, crec->position, SEEK_SET);
-    buf = malloc(crec->length);
-    gzread(cr->f, buf, crec->length);
-
-    cc = NEW(CMPIConstClass);
-    cc->hdl = buf;
-    cc->ft = CMPIConstClassFT;
-    cc->ft->relocate(cc);
+    cc = readClass(cr, clsName, crec);
 
     //    char* claz = CMGetCharPtr(cc->ft->getClassName(cc, NULL));
 
@@ -833,8 +886,10 @@ getClass(ClassRegister * cr, const char *clsName, ReadCtl *ctl)
     //    printf("; key list size=%d\n", (int)ar->ft->getSize(ar, NULL));
 
     crec->cachedCCls = cc;
+    crec->cachedCSize = classCost(cc);
+    __sync_fetch_and_add(&cachedBytes, crec->cachedCSize);
     cb->cachedCCount++;
-    if (cb->cachedCCount >= cSize)
+    if (cb->cachedCCount > cSize)
       pruneCCache(cr);
     //    fprintf(stderr, "ENQing %p\n", crec);
     ENQ_TOP_LIST(crec, cb->firstCCached, cb->lastCCached, nextCCached,
@@ -924,6 +979,9 @@ initialize(CMPIClassMI * mi, CMPIContext *ctx)
   } else {
   }
 
+  if (getControlNum("classProviderCacheMemory", &cacheMemory))
+    cacheMemory = 0;
+
   // if (nsHt==NULL) nsHt=buildClassRegisters(); why is this here? CJB
   CMReturn(CMPI_RC_OK);
 }
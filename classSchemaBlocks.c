@@ -0,0 +1,198 @@
+/*
+ * classSchemaBlocks.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * sfcbrepos -z compresses classSchemas in blocks of fixed size, each one
+ * a gzip member of its own, and lists where the blocks start in
+ * classSchemas.gz.idx:
+ *
+ *   sfcb-blocks 1
+ *   <uncompressed offset> <compressed offset>     one line per block
+ *   <uncompressed size> <compressed size>
+ *
+ * The file is still an ordinary gzip file, but a record at any position
+ * is read by inflating only the block(s) holding it, where gzseek() would
+ * inflate everything in front of it.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "classSchemaBlocks.h"
+#include "mlog.h"
+
+struct _SchemaBlocks {
+  int             fd;
+  long            count;        /* number of blocks */
+  long           *uofs,         /* count+1 entries, the last one */
+                 *cofs;         /* holds the file sizes */
+};
+
+/*
+ * Opens the block index of the compressed classSchemas fn, returns NULL
+ * if there is none or it does not match fn.
+ */
+SchemaBlocks   *
+openSchemaBlocks(const char *fn)
+{
+  SchemaBlocks   *sb;
+  struct stat     st;
+  char           *ifn;
+  FILE           *idx;
+  long            max = 64,
+      u,
+      c;
+  int             version;
+
+  ifn = malloc(strlen(fn) + 8);
+  sprintf(ifn, "%s.idx", fn);
+  idx = fopen(ifn, "r");
+  free(ifn);
+  if (idx == NULL)
+    return NULL;
+
+  if (fscanf(idx, "sfcb-blocks %d", &version) != 1 || version != 1) {
+    fclose(idx);
+    return NULL;
+  }
+
+  sb = calloc(1, sizeof(*sb));
+  sb->uofs = malloc(max * sizeof(long));
+  sb->cofs = malloc(max * sizeof(long));
+  while (fscanf(idx, "%ld %ld", &u, &c) == 2) {
+    if (sb->count == max) {
+      max *= 2;
+      sb->uofs = realloc(sb->uofs, max * sizeof(long));
+      sb->cofs = realloc(sb->cofs, max * sizeof(long));
+    }
+    sb->uofs[sb->count] = u;
+    sb->cofs[sb->count++] = c;
+  }
+  fclose(idx);
+  /*
+   * the last entry holds the sizes, not a block 
+   */
+  sb->count--;
+
+  sb->fd = open(fn, O_RDONLY);
+  if (sb->count < 1 || sb->fd < 0 || fstat(sb->fd, &st)
+      || st.st_size != sb->cofs[sb->count]) {
+    mlogf(M_INFO, M_SHOW, "--- %s.idx does not match %s - not used\n", fn,
+          fn);
+    closeSchemaBlocks(sb);
+    return NULL;
+  }
+  return sb;
+}
+
+void
+closeSchemaBlocks(SchemaBlocks * sb)
+{
+  if (sb->fd >= 0)
+    close(sb->fd);
+  free(sb->uofs);
+  free(sb->cofs);
+  free(sb);
+}
+
+/*
+ * Reads len bytes at uncompressed position pos into buf, returns 0 on
+ * success. Safe to call from several threads.
+ */
+int
+readSchemaBlocks(SchemaBlocks * sb, long pos, void *buf, long len)
+{
+  unsigned char   in[16384];
+  char            skip[4096];
+  z_stream        z;
+  long            lo = 0,
+      hi = sb->count - 1,
+      b,
+      ofs,
+      left;
+  ssize_t         n;
+  int             rc = Z_OK;
+
+  if (pos < 0 || len <= 0 || pos + len > sb->uofs[sb->count])
+    return -1;
+
+  /*
+   * the last block starting at or before pos 
+   */
+  while (lo < hi) {
+    b = (lo + hi + 1) / 2;
+    if (sb->uofs[b] <= pos)
+      lo = b;
+    else
+      hi = b - 1;
+  }
+
+  memset(&z, 0, sizeof(z));
+  if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK)
+    return -1;
+
+  ofs = sb->cofs[lo];
+  left = pos - sb->uofs[lo];
+  z.next_out = buf;
+  while (len > 0) {
+    if (z.avail_in == 0) {
+      n = pread(sb->fd, in, sizeof(in), ofs);
+      if (n <= 0)
+        break;
+      ofs += n;
+      z.next_in = in;
+      z.avail_in = n;
+    }
+    if (left) {
+      z.next_out = (unsigned char *) skip;
+      z.avail_out = left < sizeof(skip) ? left : sizeof(skip);
+    } else
+      z.avail_out = len;
+
+    n = z.avail_out;
+    rc = inflate(&z, Z_NO_FLUSH);
+    n -= z.avail_out;
+    if (left) {
+      left -= n;
+      if (left == 0)
+        z.next_out = buf;
+    } else {
+      len -= n;
+      buf = (char *) buf + n;
+    }
+
+    if (rc == Z_STREAM_END) {
+      /*
+       * the record continues in the next block 
+       */
+      if (inflateReset(&z) != Z_OK)
+        break;
+    } else if (rc != Z_OK && !(rc == Z_BUF_ERROR && z.avail_in == 0))
+      break;
+  }
+  inflateEnd(&z);
+
+  return len == 0 ? 0 : -1;
+}
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -0,0 +1,36 @@
+/*
+ * classSchemaBlocks.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Random access to a classSchemas file compressed in independent blocks,
+ * used by classProviderGz and classProviderSf.
+ *
+ */
+
+#ifndef CLASSSCHEMABLOCKS_H
+#define CLASSSCHEMABLOCKS_H
+
+struct _SchemaBlocks;
+typedef struct _SchemaBlocks SchemaBlocks;
+
+extern SchemaBlocks *openSchemaBlocks(const char *fn);
+extern int      readSchemaBlocks(SchemaBlocks * sb, long pos, void *buf,
+                                 long len);
+extern void     closeSchemaBlocks(SchemaBlocks * sb);
+
+#endif
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -22,10 +22,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "constClass.h"
 #include "objectImpl.h"
 #include "msgqueue.h"
+#include "mlog.h"
+#include <sfcCommon/utilft.h>
 
 // #define DEB(x) x
 #define DEB(x)
@@ -791,6 +799,297 @@ initConstClass(ClClass * cl)
   c.refCount = 0;
   return c;
 }
+
+/*
+ * Class repository images
+ *
+ * An uncompressed classSchemas file is mapped read only and shared by all
+ * processes mapping it. Its classes are used in place, objectImpl.c finds
+ * their string and array indexes through offsets, so nothing needs to be
+ * relocated. sfcbrepos leaves such a copy, classSchemas.img, next to a
+ * compressed classSchemas.
+ *
+ * Images are reference counted: the opener holds one reference, and every
+ * class handed out by newImageConstClass() another one, so an image is
+ * unmapped once it was released and the last of its classes is gone.
+ * Opening a file that is mapped already and has not changed since returns
+ * the existing image.
+ */
+
+struct _ClassImage {
+  char           *base;
+  size_t          size,
+                  end;          /* end of the last complete record */
+  ClVersionRecord vr;
+  UtilHashTable  *ht;
+  char           *fn;
+  dev_t           dev;
+  ino_t           ino;
+  struct timespec mtime;
+  int             refs;
+  struct _ClassImage *next;
+};
+
+/* the images mapped by this process */
+static ClassImage *classImages = NULL;
+static pthread_mutex_t classImagesMtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void     addClassImage(ClassImage * img);
+
+/* an image of fn mapped already, with a reference taken */
+static ClassImage *
+findClassImage(const char *fn, struct stat *st)
+{
+  ClassImage     *img;
+  int             refs;
+
+  pthread_mutex_lock(&classImagesMtx);
+  for (img = classImages; img; img = img->next) {
+    if (img->dev != st->st_dev || img->ino != st->st_ino
+        || img->size != (size_t) st->st_size
+        || img->mtime.tv_sec != st->st_mtim.tv_sec
+        || img->mtime.tv_nsec != st->st_mtim.tv_nsec
+        || strcmp(img->fn, fn))
+      continue;
+    /*
+     * one whose last reference is going away can't be revived 
+     */
+    while ((refs = img->refs) > 0)
+      if (__sync_bool_compare_and_swap(&img->refs, refs, refs + 1))
+        break;
+    if (refs > 0)
+      break;
+  }
+  pthread_mutex_unlock(&classImagesMtx);
+  return img;
+}
+
+/*
+ * Maps the class image file fn, with complete set the image of a reduced
+ * repository is not used.
+ */
+ClassImage     *
+openClassImageFile(const char *fn, int complete)
+{
+  ClassImage     *img;
+  ClObjectHdr    *hdr;
+  ClClass        *cls;
+  const char     *cn;
+  struct stat     st;
+  size_t          pos;
+  char           *base;
+  int             fd;
+
+  if ((fd = open(fn, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) || st.st_size < sizeof(ClVersionRecord)) {
+    close(fd);
+    return NULL;
+  }
+  if ((img = findClassImage(fn, &st))) {
+    close(fd);
+    if (complete && img->vr.options == ClTypeClassReducedRep) {
+      releaseClassImage(img);
+      return NULL;
+    }
+    return img;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  img = calloc(1, sizeof(*img));
+  img->base = base;
+  img->size = st.st_size;
+  img->dev = st.st_dev;
+  img->ino = st.st_ino;
+  img->mtime = st.st_mtim;
+  img->refs = 1;
+
+  /*
+   * ClVerifyObjImplLevel() converts the record, so check a copy 
+   */
+  hdr = (ClObjectHdr *) base;
+  memcpy(&img->vr, base, sizeof(img->vr));
+  if (hdr->type != HDR_Version || hdr->size != sizeof(ClVersionRecord)
+      || sizeof(ClVersionRecord) % CLALIGN
+      || strcmp(img->vr.id, "sfcb-rep")
+      || ClVerifyObjImplLevel(&img->vr) != 1
+      || (complete && img->vr.options == ClTypeClassReducedRep))
+    goto fail;
+
+  img->ht = UtilFactory->newHashTable(61,
+                                      UtilHashTable_charKey |
+                                      UtilHashTable_ignoreKeyCase);
+  for (pos = sizeof(ClVersionRecord);
+       pos + sizeof(ClClass) <= img->size; pos += hdr->size) {
+    hdr = (ClObjectHdr *) (base + pos);
+    /*
+     * a record still being appended ends the image 
+     */
+    if (hdr->size < sizeof(ClClass) || pos + hdr->size > img->size)
+      break;
+    if ((hdr->type != HDR_Class && hdr->type != HDR_IncompleteClass)
+        || hdr->size % CLALIGN) {
+      mlogf(M_ERROR, M_SHOW, "--- %s contains invalid record(s) - not used\n",
+            fn);
+      goto fail;
+    }
+    cls = (ClClass *) hdr;
+    cn = ClObjectGetClString(&cls->hdr, &cls->name);
+    if (cn && strncmp(cn, "DMY_", 4))
+      img->ht->ft->put(img->ht, cn, cls);
+  }
+  img->end = pos;
+  img->fn = strdup(fn);
+  addClassImage(img);
+  return img;
+
+fail:
+  if (img->ht)
+    img->ht->ft->release(img->ht);
+  munmap(base, img->size);
+  free(img);
+  return NULL;
+}
+
+static void
+addClassImage(ClassImage * img)
+{
+  pthread_mutex_lock(&classImagesMtx);
+  img->next = classImages;
+  __sync_synchronize();
+  classImages = img;
+  pthread_mutex_unlock(&classImagesMtx);
+}
+
+/* drops a reference to img, the last one unmaps it */
+void
+releaseClassImage(ClassImage * img)
+{
+  ClassImage    **p;
+
+  if (img == NULL || __sync_sub_and_fetch(&img->refs, 1))
+    return;
+
+  pthread_mutex_lock(&classImagesMtx);
+  for (p = &classImages; *p; p = &(*p)->next)
+    if (*p == img) {
+      *p = img->next;
+      break;
+    }
+  pthread_mutex_unlock(&classImagesMtx);
+
+  img->ht->ft->release(img->ht);
+  munmap(img->base, img->size);
+  free(img->fn);
+  free(img);
+}
+
+/*
+ * Maps the class image of the namespace repository directory dir, an
+ * uncompressed classSchemas or else classSchemas.img.
+ */
+ClassImage     *
+openClassImage(const char *dir, int complete)
+{
+  ClassImage     *img;
+  char           *fn = malloc(strlen(dir) + 32);
+
+  sprintf(fn, "%s/classSchemas", dir);
+  if ((img = openClassImageFile(fn, complete)) == NULL) {
+    strcat(fn, ".img");
+    img = openClassImageFile(fn, complete);
+  }
+  free(fn);
+  return img;
+}
+
+void           *
+getClassImageVersion(ClassImage * img)
+{
+  return &img->vr;
+}
+
+void           *
+getImageClass(ClassImage * img, const char *cn)
+{
+  return img->ht->ft->get(img->ht, cn);
+}
+
+/*
+ * walks the class records of an image in file order, starting with
+ * cls NULL 
+ */
+void           *
+nextImageClass(ClassImage * img, void *cls)
+{
+  size_t          pos;
+
+  if (cls == NULL)
+    pos = sizeof(ClVersionRecord);
+  else
+    pos = (char *) cls - img->base + ((ClObjectHdr *) cls)->size;
+  if (pos >= img->end)
+    return NULL;
+  return img->base + pos;
+}
+
+/*
+ * Classes of an image carry a reference to it, they are told apart from
+ * the others by their function table.
+ */
+
+typedef struct imageConstClass {
+  CMPIConstClass  cc;
+  ClassImage     *img;
+} ImageConstClass;
+
+static struct _CMPIConstClass_FT imageFt;
+static pthread_once_t imageFtOnce = PTHREAD_ONCE_INIT;
+
+static CMPIStatus
+releaseImageClass(CMPIConstClass * cc)
+{
+  CMPIStatus      rc = { 0, NULL };
+
+  if (cc->refCount == 0) {
+    releaseClassImage(((ImageConstClass *) cc)->img);
+    free(cc);
+  }
+  return rc;
+}
+
+static void
+initImageFt()
+{
+  imageFt = ift;
+  imageFt.release = releaseImageClass;
+}
+
+/*
+ * returns a class using the image copy of the class in place 
+ */
+CMPIConstClass *
+newImageConstClass(ClassImage * img, void *cls)
+{
+  ImageConstClass *icc = malloc(sizeof(*icc));
+
+  pthread_once(&imageFtOnce, initImageFt);
+  __sync_add_and_fetch(&img->refs, 1);
+  icc->img = img;
+  icc->cc.hdl = cls;
+  icc->cc.ft = &imageFt;
+  icc->cc.refCount = 0;
+  return &icc->cc;
+}
+
+int
+isImageConstClass(const CMPIConstClass * cc)
+{
+  return cc->ft == &imageFt;
+}
 /* MODELINES */
 /* DO NOT EDIT BELOW THIS COMMENT */
 /* Modelines are added by 'make pretty' */
@@ -133,6 +133,22 @@ extern CMPIData internalGetPropQualAt(CMPIConstClass * cc, CMPICount p,
                                       CMPIStatus *rc);
 extern CMPIConstClass_FT *CMPIConstClassFT;
 
+/*
+ * read only class repository images shared between processes, see
+ * constClass.c 
+ */
+struct _ClassImage;
+typedef struct _ClassImage ClassImage;
+
+extern ClassImage *openClassImage(const char *dir, int complete);
+extern ClassImage *openClassImageFile(const char *fn, int complete);
+extern void     releaseClassImage(ClassImage * img);
+extern void    *getClassImageVersion(ClassImage * img);   /* ClVersionRecord */
+extern void    *getImageClass(ClassImage * img, const char *cn);  /* ClClass */
+extern void    *nextImageClass(ClassImage * img, void *cls);
+extern CMPIConstClass *newImageConstClass(ClassImage * img, void *cls);
+extern int      isImageConstClass(const CMPIConstClass * cc);
+
 // extern CMPIConstClass* newCMPIConstClass(const char *cn, const char
 // *pn);
 
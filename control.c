@@ -134,6 +134,10 @@ static Control init[] = {
   {"enableHttp", CTL_BOOL, NULL, {.b=1}},
   {"enableUds", CTL_BOOL,  NULL, {.b=1}},
   {"httpProcs", CTL_LONG, NULL, {.slong=8}},
+  {"httpWorkerPool", CTL_BOOL, NULL, {.b=0}},
+  {"httpWorkerMaxRequests", CTL_LONG, NULL, {.slong=1000}},
+  {"httpParkConnections", CTL_BOOL, NULL, {.b=1}},
+  {"httpMaxParkedConnections", CTL_LONG, NULL, {.slong=1024}},
   {"httpsPort", CTL_LONG, NULL, {.slong=5989}},
   {"enableHttps", CTL_BOOL, NULL, {.b=0}},
   {"httpLocalOnly", CTL_BOOL, NULL, {.b=0}},
@@ -153,6 +157,8 @@ static Control init[] = {
   {"useChunking", CTL_STRING, "true", {0}},
   {"chunkSize", CTL_LONG, NULL, {.slong=50000}},
   {"maxChunkObjCount", CTL_ULONG, NULL, {.ulong=0}},
+  {"chunkWindow", CTL_LONG, NULL, {.slong=4}},
+  {"responseStreamSize", CTL_LONG, NULL, {.slong=65536}},
   {"embeddedObjEncoding", CTL_STRING, "xmlescape", {0}},
 
   {"trimWhitespace", CTL_BOOL, NULL, {.b=1}},
@@ -166,6 +172,11 @@ static Control init[] = {
   {"providerSampleInterval", CTL_LONG, NULL, {.slong=30}},
   {"providerTimeoutInterval", CTL_LONG, NULL, {.slong=60}},
   {"providerAutoGroup", CTL_BOOL, NULL, {.b=1}},
+  {"providerFanOut", CTL_LONG, NULL, {.slong=8}},
+  {"classCacheLimit", CTL_LONG, NULL, {.slong=256}},
+  {"classProviderCacheMemory", CTL_LONG, NULL, {.slong=4194304}},
+  {"trackedMemoryArena", CTL_BOOL, NULL, {.b=1}},
+  {"internTableSize", CTL_LONG, NULL, {.slong=1048576}},
   {"providerDefaultUserSFCB", CTL_BOOL, NULL, {.b=1}},
   {"providerDefaultUser", CTL_STRING, "", {0}},
 
@@ -180,6 +191,9 @@ static Control init[] = {
   {"enableSslCipherServerPref", CTL_BOOL, NULL, {.b=0}},
 
   {"registrationDir", CTL_STRING, SFCB_STATEDIR "/registration", {0}},
+  {"repositoryCompactThreshold", CTL_LONG, NULL, {.slong=50}},
+  {"enumerationContextDir", CTL_STRING, SFCB_STATEDIR "/enumerationContexts", {0}},
+  {"enumerationContextTimeout", CTL_LONG, NULL, {.slong=60}},
   {"providerDirs", CTL_USTRING, SFCB_LIBDIR " " CMPI_LIBDIR " " LIBDIR, {0}},
 
   {"enableInterOp", CTL_BOOL, NULL, {.b=1}},
@@ -194,6 +208,7 @@ static Control init[] = {
   {"traceFile", CTL_STRING, "stderr", {0}},
   {"traceLevel", CTL_LONG, NULL, {.slong=0}},
   {"traceMask", CTL_LONG, NULL, {.slong=0}},
+  {"traceRingSize", CTL_LONG, NULL, {.slong=0}},
 
   {"httpMaxContentLength", CTL_UINT, NULL, {.uint=100000000}},
   {"validateMethodParamTypes", CTL_BOOL, NULL, {.b=0}},
@@ -205,6 +220,9 @@ static Control init[] = {
   {"SubscriptionRemovalAction", CTL_UINT, NULL, {.uint=2}},
   {"indicationDeliveryThreadLimit", CTL_LONG, NULL, {.slong=30}},
   {"indicationDeliveryThreadTimeout", CTL_LONG, NULL, {.slong=0}},
+  {"indicationDeliveryQueueDepth", CTL_LONG, NULL, {.slong=1000}},
+  {"indicationDeliveryOverflow", CTL_STRING, "block", {0}},
+  {"indicationDeliveryBatchSize", CTL_LONG, NULL, {.slong=1}},
   {"MaxListenerDestinations", CTL_LONG, NULL, {.slong=100}},
   {"MaxActiveSubscriptions", CTL_LONG, NULL, {.slong=100}},
   {"indicationCurlTimeout", CTL_LONG, NULL, {.slong=10}},
@@ -62,9 +62,7 @@ __dtft_release(CMPIDateTime *dt)
   struct native_datetime *ndt = (struct native_datetime *) dt;
 
   if (ndt->mem_state && ndt->mem_state != MEM_RELEASED) {
-    memUnlinkEncObj(ndt->mem_state);
-    ndt->mem_state = MEM_RELEASED;
-    free(ndt);
+    memReleaseEncObj(ndt, &ndt->mem_state);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -309,7 +307,7 @@ __new_datetime(int mm_add, const char *cimDt, CMPIStatus *rc)
   int             state;
 
   ndt.dt = dt;
-  tNdt = memAddEncObj(mm_add, &ndt, sizeof(ndt), &state);
+  tNdt = memAddArenaEncObj(mm_add, &ndt, sizeof(ndt), &state);
   tNdt->mem_state = state;
   tNdt->refCount = 0;
   strcpy(tNdt->cimDt, cimDt);
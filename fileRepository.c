@@ -29,8 +29,13 @@
 #include <unistd.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/file.h>
 
 #include "trace.h"
 #include "cmpi/cmpimacs.h"
@@ -79,11 +84,288 @@ getRepDir()
   return repfn;
 }
 
+/*
+ * Writers hold an flock() on the namespace directory from reading the index
+ * until the new one is in place, that serializes them across processes and
+ * threads. A thread holding the lock of a directory may take it again, so
+ * callers of lockNameSpace() can still use addBlob() and friends.
+ */
+
+typedef struct dirLock {
+  char           *dir;
+  int             fd,
+                  depth;
+  struct dirLock *next;
+} DirLock;
+
+static pthread_key_t dirLockKey;        /* DirLocks held by the thread */
+static pthread_once_t dirLockOnce = PTHREAD_ONCE_INIT;
+
+static void
+initDirLocks()
+{
+  pthread_key_create(&dirLockKey, NULL);
+}
+
 static int
-getIndexRecordCase(BlobIndex * bi, const char *key, size_t keyl,
-                   char **keyb, size_t * keybl, short ignorecase)
+lockDir(const char *dir)
+{
+  DirLock        *l,
+                 *h;
+  int             fd;
+
+  pthread_once(&dirLockOnce, initDirLocks);
+  h = pthread_getspecific(dirLockKey);
+  for (l = h; l; l = l->next)
+    if (strcmp(l->dir, dir) == 0) {
+      l->depth++;
+      return 0;
+    }
+
+  if ((fd = open(dir, O_RDONLY)) < 0)
+    return -1;
+  if (flock(fd, LOCK_EX)) {
+    close(fd);
+    return -1;
+  }
+  l = malloc(sizeof(*l));
+  l->dir = strdup(dir);
+  l->fd = fd;
+  l->depth = 1;
+  l->next = h;
+  pthread_setspecific(dirLockKey, l);
+  return 0;
+}
+
+static void
+unlockDir(const char *dir)
+{
+  DirLock        *l,
+                 *prev = NULL;
+
+  pthread_once(&dirLockOnce, initDirLocks);
+  for (l = pthread_getspecific(dirLockKey); l; prev = l, l = l->next)
+    if (strcmp(l->dir, dir) == 0)
+      break;
+  if (l == NULL || --l->depth)
+    return;
+  if (prev)
+    prev->next = l->next;
+  else
+    pthread_setspecific(dirLockKey, l->next);
+  close(l->fd);
+  free(l->dir);
+  free(l);
+}
+
+/* the directory of name space ns, with a trailing / */
+static char    *
+nameSpaceDir(const char *ns)
+{
+  char           *dir = getRepDir();
+  char           *fn = malloc(strlen(dir) + strlen(ns) + 2),
+      *p;
+
+  strcpy(fn, dir);
+  p = fn + strlen(fn);
+  strcat(fn, ns);
+  strcat(fn, "/");
+  while (*p) {
+    *p = tolower(*p);
+    p++;
+  }
+  return fn;
+}
+
 /*
- * returns -1 failure, 0 OK, 1 not found (only with key) 
+ * takes the writer lock of name space ns, for read-modify-write cycles
+ * spanning several blobs; returns 0 or -1
+ */
+int
+lockNameSpace(const char *ns)
+{
+  char           *dir = nameSpaceDir(ns);
+  int             rc = lockDir(dir);
+
+  free(dir);
+  return rc;
+}
+
+void
+unlockNameSpace(const char *ns)
+{
+  char           *dir = nameSpaceDir(ns);
+
+  unlockDir(dir);
+  free(dir);
+}
+
+/*
+ * Index file layout
+ *
+ *   IdxHeader
+ *   unsigned int bucket[buckets]  offset of the first record of each hash
+ *                                 chain, 0 = empty
+ *   IdxRecord ...                 in insertion order, each one followed by
+ *                                 its key, NUL terminated and padded
+ *
+ * Index files still in the old ASCII layout (one "<len> <keyl> <key> <blen>
+ * <bofs>\r\n" line per blob) are converted the first time they are read.
+ *
+ * The index records the generation of the data file its offsets refer to.
+ * compact() starts a new generation: the rewritten data file begins with a
+ * DataHeader carrying it, data files that were never compacted have none
+ * and are generation 0. An index is only used together with a data file of
+ * the same generation, see openIndex().
+ */
+
+#define IDX_MAGIC "SFCBIX03"
+#define IDX_PAD(l) (((l) + 3) & ~3)
+
+typedef struct idxHeader {
+  char            magic[8];
+  unsigned int    count;
+  unsigned int    buckets;      /* power of 2 */
+  unsigned int    gen;          /* generation of the data file */
+} IdxHeader;
+
+#define DATA_MAGIC "SFCBDT01"
+
+typedef struct dataHeader {
+  char            magic[8];
+  unsigned int    gen;
+  unsigned int    pad;          /* keeps the first blob aligned */
+} DataHeader;
+
+/*
+ * blobs start at multiples of BLOB_ALIGN, padded with zeros, so that
+ * mapBlobIndex() can hand them out in place 
+ */
+#define BLOB_ALIGN 8
+#define BLOB_PAD(o) (((o) + BLOB_ALIGN - 1) & ~(BLOB_ALIGN - 1))
+
+static const char blobPad[BLOB_ALIGN];
+
+typedef struct idxRecord {
+  unsigned int    len;          /* record length incl. key */
+  unsigned int    hash;
+  unsigned int    chain;        /* next record in the bucket, 0 = end */
+  unsigned int    keyl;
+  unsigned int    blen;
+  unsigned int    bofs;
+} IdxRecord;
+
+#define IDX_BUCKETS(x) ((unsigned int *) ((x) + sizeof(IdxHeader)))
+#define IDX_FIRST(x) \
+   (sizeof(IdxHeader) + ((IdxHeader *) (x))->buckets * sizeof(unsigned int))
+#define IDX_RECORD(x,o) ((IdxRecord *) ((x) + (o)))
+#define IDX_KEY(r) ((char *) ((r) + 1))
+
+typedef struct idxEntry {
+  const char     *key;
+  unsigned int    keyl;
+  unsigned int    blen;
+  unsigned int    bofs;
+} IdxEntry;
+
+/*
+ * Index files read by this process, by index file name. Repeated lookups
+ * only cost a stat() as long as the file has not been replaced. Images are
+ * never modified, BlobIndexes share them (BlobIndex.image).
+ */
+typedef struct idxImage {
+  int             refs;
+  int             dSize;
+  char           *index;
+} IdxImage;
+
+typedef struct idxCache {
+  IdxImage       *img;
+  dev_t           dev;
+  ino_t           ino;
+  off_t           size;
+  struct timespec mtime;
+} IdxCache;
+
+static UtilHashTable *idxCacheHt = NULL;
+static pthread_mutex_t idxCacheMtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* case folded, so the case insensitive qualifier lookup can use it too */
+static unsigned int
+idxHash(const char *key, size_t keyl)
+{
+  unsigned int    h = 2166136261U;
+  while (keyl--)
+    h = (h ^ (unsigned char) tolower(*key++)) * 16777619U;
+  return h;
+}
+
+static char    *
+buildIndex(IdxEntry * e, int n, unsigned int gen, int *size)
+{
+  unsigned int    buckets = 16,
+                  ofs,
+                  h,
+                 *bucket;
+  IdxHeader      *hdr;
+  IdxRecord      *r;
+  char           *x;
+  int             i;
+
+  while (buckets < (unsigned int) n)
+    buckets <<= 1;
+
+  *size = sizeof(IdxHeader) + buckets * sizeof(unsigned int);
+  for (i = 0; i < n; i++)
+    *size += sizeof(IdxRecord) + IDX_PAD(e[i].keyl + 1);
+
+  x = calloc(*size + 1, 1);
+  hdr = (IdxHeader *) x;
+  memcpy(hdr->magic, IDX_MAGIC, sizeof(hdr->magic));
+  hdr->count = n;
+  hdr->buckets = buckets;
+  hdr->gen = gen;
+  bucket = IDX_BUCKETS(x);
+
+  for (i = 0, ofs = IDX_FIRST(x); i < n; i++, ofs += r->len) {
+    r = IDX_RECORD(x, ofs);
+    r->len = sizeof(IdxRecord) + IDX_PAD(e[i].keyl + 1);
+    r->hash = idxHash(e[i].key, e[i].keyl);
+    r->keyl = e[i].keyl;
+    r->blen = e[i].blen;
+    r->bofs = e[i].bofs;
+    memcpy(IDX_KEY(r), e[i].key, e[i].keyl);
+    h = r->hash & (buckets - 1);
+    r->chain = bucket[h];
+    bucket[h] = ofs;
+  }
+  return x;
+}
+
+static int
+validIndex(char *x, int size)
+{
+  IdxHeader      *hdr = (IdxHeader *) x;
+  unsigned int    ofs;
+  unsigned int    n;
+
+  if (size < (int) sizeof(IdxHeader)
+      || memcmp(hdr->magic, IDX_MAGIC, sizeof(hdr->magic))
+      || hdr->buckets == 0 || (hdr->buckets & (hdr->buckets - 1))
+      || IDX_FIRST(x) > (unsigned int) size)
+    return 0;
+  for (ofs = IDX_FIRST(x), n = 0; ofs < (unsigned int) size;
+       ofs += IDX_RECORD(x, ofs)->len, n++)
+    if (IDX_RECORD(x, ofs)->len < sizeof(IdxRecord)
+        || ofs + IDX_RECORD(x, ofs)->len > (unsigned int) size)
+      return 0;
+  return ofs == (unsigned int) size && n == hdr->count;
+}
+
+static int
+getAsciiIndexRecord(BlobIndex * bi, char **keyb, size_t * keybl)
+/*
+ * returns -1 failure, 0 OK
  */
 {
   static const char *delims = " \t";
@@ -217,42 +499,157 @@ getIndexRecordCase(BlobIndex * bi, const char *key, size_t keyl,
   bi->blen = blen;
   bi->bofs = bofs;
   bi->next += elen;
-  /*
-   * check if key was specified and matches 
-   */
-  if (keyl > 0) {
-    if (ignorecase) {
-      if (keyl != ekl || strncasecmp(kbptr, key, keyl)) {
-        /*
-         * mismatch 
-         */
-        return 1;
-      }
-    } else {
-      if (keyl != ekl || strncmp(kbptr, key, keyl)) {
-        /*
-         * mismatch 
-         */
-        return 1;
-      }
-    }
+  *keyb = kbptr;
+  *keybl = ekl;
+  return 0;
+}
+
+/* convert an index in the old ASCII layout; the new one replaces the file
+ * if possible */
+static int
+migrateIndex(BlobIndex * bi)
+{
+  IdxEntry       *e;
+  char           *x,
+                 *kb;
+  size_t          kbl;
+  int             n = 0,
+      size,
+      rc = 0;
+  FILE           *f;
+  char           *tn = alloca(strlen(bi->dir) + 8);
+
+  e = malloc(sizeof(IdxEntry) * (bi->dSize / 8 + 1));
+  bi->next = 0;
+  while (getAsciiIndexRecord(bi, &kb, &kbl) == 0) {
+    e[n].key = kb;
+    e[n].keyl = kbl;
+    e[n].blen = bi->blen;
+    e[n].bofs = bi->bofs;
+    n++;
   }
-  /*
-   * set found keybindings if possible 
-   */
-  if (keyb && keybl) {
-    *keyb = kbptr;
-    *keybl = ekl;
+  x = buildIndex(e, n, 0, &size);
+  free(e);
+
+  strcpy(tn, bi->dir);
+  strcat(tn, "idx");
+  if ((f = fopen(tn, "wb")) != NULL) {
+    rc = fwrite(x, size, 1, f) - 1;
+    rc += fclose(f);
+    if (rc == 0)
+      rc = rename(tn, bi->fnx);
+    else
+      remove(tn);
+    if (rc == 0)
+      mlogf(M_INFO, M_SHOW, "--- Converted repository index %s\n",
+            bi->fnx);
   }
+
+  free(bi->index);
+  bi->index = x;
+  bi->dSize = size;
+  bi->next = 0;
   return 0;
 }
 
+static void
+releaseImage(IdxImage * img)
+{
+  if (--img->refs == 0) {
+    free(img->index);
+    free(img);
+  }
+}
+
+/* read the index file of bi, from the cache if it has not changed */
 static int
-getIndexRecord(BlobIndex * bi, char *key, size_t keyl, char **keyb,
-               size_t * keybl)
+loadIndex(BlobIndex * bi, struct stat *st)
 {
-  // use case-sensitive compare on the key
-  return getIndexRecordCase(bi, key, keyl, keyb, keybl, 0);
+  IdxCache       *c;
+  IdxImage       *img;
+  FILE           *f;
+
+  pthread_mutex_lock(&idxCacheMtx);
+  if (idxCacheHt == NULL)
+    idxCacheHt = UtilFactory->newHashTable(61, UtilHashTable_charKey |
+                                           UtilHashTable_managedKey);
+  c = idxCacheHt->ft->get(idxCacheHt, bi->fnx);
+  if (c && c->dev == st->st_dev && c->ino == st->st_ino
+      && c->size == st->st_size
+      && c->mtime.tv_sec == st->st_mtim.tv_sec
+      && c->mtime.tv_nsec == st->st_mtim.tv_nsec) {
+    c->img->refs++;
+    bi->image = c->img;
+    bi->index = c->img->index;
+    bi->dSize = c->img->dSize;
+    pthread_mutex_unlock(&idxCacheMtx);
+    return 0;
+  }
+  pthread_mutex_unlock(&idxCacheMtx);
+
+  if ((f = fopen(bi->fnx, "rb")) == NULL)
+    return -1;
+  bi->dSize = st->st_size;
+  bi->index = malloc(bi->dSize + 1);
+  if (bi->dSize && fread(bi->index, bi->dSize, 1, f) != 1) {
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+  bi->index[bi->dSize] = 0;
+
+  if (!validIndex(bi->index, bi->dSize)) {
+    migrateIndex(bi);
+    if (stat(bi->fnx, st))
+      return 0;                 /* could not convert, don't cache */
+  }
+
+  img = NEW(IdxImage);
+  img->refs = 2;                /* the cache and bi */
+  img->index = bi->index;
+  img->dSize = bi->dSize;
+  bi->image = img;
+
+  pthread_mutex_lock(&idxCacheMtx);
+  c = idxCacheHt->ft->get(idxCacheHt, bi->fnx);
+  if (c == NULL) {
+    c = NEW(IdxCache);
+    idxCacheHt->ft->put(idxCacheHt, strdup(bi->fnx), c);
+  } else
+    releaseImage(c->img);
+  c->img = img;
+  c->dev = st->st_dev;
+  c->ino = st->st_ino;
+  c->size = st->st_size;
+  c->mtime = st->st_mtim;
+  pthread_mutex_unlock(&idxCacheMtx);
+  return 0;
+}
+
+static int
+getIndexRecord(BlobIndex * bi, char **keyb, size_t * keybl)
+/*
+ * returns -1 failure (no more records), 0 OK
+ */
+{
+  IdxRecord      *r;
+
+  if (bi->next < (int) IDX_FIRST(bi->index))
+    bi->next = IDX_FIRST(bi->index);
+  if (bi->next >= bi->dSize)
+    return -1;
+
+  r = IDX_RECORD(bi->index, bi->next);
+  bi->pos = bi->next;
+  bi->len = r->len;
+  bi->blen = r->blen;
+  bi->bofs = r->bofs;
+  bi->next += r->len;
+  if (keyb && keybl) {
+    *keyb = IDX_KEY(r);
+    *keybl = r->keyl;
+  }
+  return 0;
 }
 
 void
@@ -267,6 +664,8 @@ freeBlobIndex(BlobIndex ** bip, int all)
     return;
   if (bi->freed)
     return;
+  if (bi->lock)
+    unlockDir(bi->dir);
   if (bi->dir) {
     free(bi->dir);
     bi->dir = NULL;
@@ -279,12 +678,21 @@ freeBlobIndex(BlobIndex ** bip, int all)
     free(bi->fnd);
     bi->fnd = NULL;
   }
+  if (bi->image) {
+    pthread_mutex_lock(&idxCacheMtx);
+    releaseImage(bi->image);
+    pthread_mutex_unlock(&idxCacheMtx);
+    bi->image = NULL;
+    bi->index = NULL;
+  }
   if (all)
     if (bi->index) {
       free(bi->index);
       bi->index = NULL;
     }
   bi->freed = -1;
+  if (bi->map)
+    releaseBlobMap(bi->map);
   if (bi->fd)
     fclose(bi->fd);
   if (bi->fx)
@@ -296,19 +704,28 @@ freeBlobIndex(BlobIndex ** bip, int all)
 static int
 indxLocateCase(BlobIndex * bi, const char *key, short ignorecase)
 {
-  int             loc;
-  int             kl = strlen(key);
-  bi->next = 0;
-  while (bi->next < bi->dSize) {
-    loc = getIndexRecordCase(bi, key, kl, NULL, 0, ignorecase);
-    if (loc < 0) {
-      return 0;
-    } else if (loc == 0) {
-      /*
-       * found 
-       */
-      return 1;
-    }
+  unsigned int    kl = strlen(key);
+  unsigned int    h = idxHash(key, kl);
+  unsigned int    ofs;
+  IdxRecord      *r;
+
+  ofs = IDX_BUCKETS(bi->index)[h & (((IdxHeader *) bi->index)->buckets - 1)];
+  for (; ofs; ofs = r->chain) {
+    r = IDX_RECORD(bi->index, ofs);
+    if (r->hash != h || r->keyl != kl)
+      continue;
+    if (ignorecase ? strncasecmp(IDX_KEY(r), key, kl) :
+        strncmp(IDX_KEY(r), key, kl))
+      continue;
+    /*
+     * found
+     */
+    bi->pos = ofs;
+    bi->len = r->len;
+    bi->blen = r->blen;
+    bi->bofs = r->bofs;
+    bi->next = ofs + r->len;
+    return 1;
   }
   return 0;
 }
@@ -320,13 +737,94 @@ indxLocate(BlobIndex * bi, const char *key)
   return indxLocateCase(bi, key, 0);
 }
 
+/*
+ * Mapped data files (mapBlobIndex)
+ *
+ * getFirst()/getNext() of a mapped BlobIndex return pointers into a private
+ * mapping of the data file instead of malloced copies. The pages are copy on
+ * write, so callers may relocate or modify blobs in place; nothing they do
+ * goes back to the file. The blobs stay valid as long as the mapping is
+ * held: by the BlobIndex, and by every holdBlobMap() caller.
+ */
+
+typedef struct blobMap {
+  int             refs;
+  void           *addr;
+  size_t          len;
+} BlobMap;
+
+int
+mapBlobIndex(BlobIndex * bi)
+{
+  struct stat     st;
+  IdxRecord      *r;
+  BlobMap        *m;
+  void           *addr;
+  int             fd,
+                  ofs;
+
+  if (bi->map)
+    return 0;
+  if ((fd = open(bi->fnd, O_RDONLY)) < 0)
+    return -1;
+  if (fstat(fd, &st) || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  /* blobs are used in place, so they have to be aligned */
+  for (ofs = IDX_FIRST(bi->index); ofs < bi->dSize; ofs += r->len) {
+    r = IDX_RECORD(bi->index, ofs);
+    if (r->bofs % sizeof(void *) || r->bofs + r->blen > st.st_size) {
+      close(fd);
+      return -1;
+    }
+  }
+
+  addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return -1;
+
+  m = NEW(BlobMap);
+  m->refs = 1;
+  m->addr = addr;
+  m->len = st.st_size;
+  bi->map = m;
+  return 0;
+}
+
+void           *
+holdBlobMap(BlobIndex * bi)
+{
+  BlobMap        *m = bi->map;
+
+  if (m)
+    __sync_add_and_fetch(&m->refs, 1);
+  return m;
+}
+
+void
+releaseBlobMap(void *map)
+{
+  BlobMap        *m = map;
+
+  if (m && __sync_sub_and_fetch(&m->refs, 1) == 0) {
+    munmap(m->addr, m->len);
+    free(m);
+  }
+}
+
 void           *
 getFirst(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
 {
   char           *buf = NULL;
   bi->next = 0;
 
-  if (getIndexRecord(bi, NULL, 0, keyb, keybl) == 0) {
+  if (bi->map)
+    return getNext(bi, len, keyb, keybl);
+
+  if (getIndexRecord(bi, keyb, keybl) == 0) {
     bi->fd = fopen(bi->fnd, "rb");
     if (bi->fd == NULL) {
       fdHandleError(bi);
@@ -351,7 +849,17 @@ getNext(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
 {
   char           *buf = NULL;
 
-  if (getIndexRecord(bi, NULL, 0, keyb, keybl) == 0) {
+  if (bi->map) {
+    if (getIndexRecord(bi, keyb, keybl) == 0) {
+      buf = (char *) ((BlobMap *) bi->map)->addr + bi->bofs;
+      if (len)
+        *len = bi->blen;
+    } else if (len)
+      *len = 0;
+    return (void *) buf;
+  }
+
+  if (getIndexRecord(bi, keyb, keybl) == 0) {
     fseek(bi->fd, bi->bofs, SEEK_SET);
     buf = malloc(bi->blen + 8);
     fread(buf, bi->blen, 1, bi->fd);
@@ -368,129 +876,337 @@ getNext(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
   return (void *) buf;
 }
 
-static void
-copy(FILE * o, FILE * i, int len, unsigned long ofs)
+static int
+cmpOfs(const void *a, const void *b)
 {
-  char           *buf = malloc(len);
-  fseek(i, ofs, SEEK_SET);
-  fread(buf, len, 1, i);
-  fwrite(buf, len, 1, o);
-  free(buf);
+  return *(const int *) a - *(const int *) b;
 }
 
+/*
+ * the entries of bi without the records at the ndrop sorted offsets in
+ * drop, with room for extra more entries
+ */
+static IdxEntry *
+getEntries(BlobIndex * bi, const int *drop, int ndrop, int extra, int *n)
+{
+  IdxEntry       *e;
+  IdxRecord      *r;
+  int             ofs;
+
+  e = malloc(sizeof(IdxEntry) *
+             (((IdxHeader *) bi->index)->count + extra + 1));
+  *n = 0;
+  for (ofs = IDX_FIRST(bi->index); ofs < bi->dSize; ofs += r->len) {
+    r = IDX_RECORD(bi->index, ofs);
+    if (ndrop && bsearch(&ofs, drop, ndrop, sizeof(int), cmpOfs))
+      continue;
+    e[*n].key = IDX_KEY(r);
+    e[*n].keyl = r->keyl;
+    e[*n].blen = r->blen;
+    e[*n].bofs = r->bofs;
+    (*n)++;
+  }
+  return e;
+}
+
+/*
+ * write the index for the n entries to fn, through a temporary file so fn
+ * is replaced in one step
+ */
 static int
-adjust(BlobIndex * bi, int pos, int adj)
-{
-  int             dp = pos,
-      l,
-      o,
-      sl;
-  char           *p,
-                 *r = NULL,
-      str[32];
-  while (dp < bi->dSize) {
-    memset(str, ' ', sizeof(str) - 1);
-    str[sizeof(str) - 1] = 0;
-    l = atoi(bi->index + dp);
-    for (p = bi->index + dp + l - 2; *p != ' '; p--)
-      if (*p == '\r')
-        r = p;
-    o = atoi(++p);
-    o -= adj;
-    sl = sprintf(str + (r - p), "%d", o);
-    memcpy(p, str + sl, r - p);
-    dp += l;
+writeIndex(BlobIndex * bi, IdxEntry * e, int n, const char *fn, int sync)
+{
+  char           *xn = alloca(strlen(bi->dir) + 8);
+  char           *x;
+  int             size,
+                  rc;
+  FILE           *f;
+
+  x = buildIndex(e, n, bi->gen, &size);
+  strcpy(xn, bi->dir);
+  strcat(xn, "idx");
+  if ((f = fopen(xn, "wb")) == NULL) {
+    free(x);
+    return -1;
+  }
+  rc = fwrite(x, size, 1, f) - 1;
+  if (rc == 0 && sync && (fflush(f) || fsync(fileno(f))))
+    rc = -1;
+  rc += fclose(f);
+  free(x);
+  if (rc == 0)
+    rc = rename(xn, fn);
+  if (rc != 0) {
+    remove(xn);
+    return -1;
   }
   return 0;
 }
 
+/*
+ * The data file is a log: new and modified blobs are appended, the index
+ * tells which blobs are live. Space of modified and deleted blobs is only
+ * reclaimed by compact().
+ */
+
+/*
+ * append n blobs to the data file and store their offsets in ofs, blobs
+ * of length 0 are skipped; each one is aligned, see BLOB_ALIGN. Returns 0
+ * or -1
+ */
 static int
-rebuild(BlobIndex * bi, void *blob, int blen)
+appendBlobs(BlobIndex * bi, int n, void **blobs, int *lens, long *ofs)
 {
-  int             ofs,
-                  len,
-                  xt = 0,
-                  dt = 0, 
+  long            end;
+  int             i,
                   rc = 0;
-  char           *xn = alloca(strlen(bi->dir) + 8);
+
+  bi->fd = fopen(bi->fnd, "ab+");
+  if (bi->fd == NULL)
+    bi->fd = fopen(bi->fnd, "wb+");
+  if (bi->fd == NULL)
+    return -1;
+  fseek(bi->fd, 0, SEEK_END);
+  end = ftell(bi->fd);
+  for (i = 0; i < n && rc == 0; i++) {
+    if (end % BLOB_ALIGN)
+      rc = fwrite(blobPad, BLOB_ALIGN - end % BLOB_ALIGN, 1, bi->fd) - 1;
+    end = BLOB_PAD(end);
+    ofs[i] = end;
+    if (lens[i] == 0 || rc)
+      continue;
+    rc = fwrite(blobs[i], lens[i], 1, bi->fd) - 1;
+    end += lens[i];
+  }
+  rc += fclose(bi->fd);
+  bi->fd = NULL;
+  bi->dlen = end;
+  return rc ? -1 : 0;
+}
+
+/* append blob to the data file, returns its offset or -1 */
+static long
+appendBlob(BlobIndex * bi, void *blob, int len)
+{
+  long            ofs;
+
+  if (appendBlobs(bi, 1, &blob, &len, &ofs))
+    return -1;
+  return ofs;
+}
+
+/* the index compact() leaves behind until the new data file is in place */
+static char    *
+pendingIndex(BlobIndex * bi)
+{
+  char           *pn = malloc(strlen(bi->fnd) + 16);
+
+  strcpy(pn, bi->fnd);
+  strcat(pn, ".new.idx");
+  return pn;
+}
+
+/*
+ * rewrite the data file with the live blobs only, as the next generation.
+ * The new index is written as pending index first, then the data file and
+ * the index are renamed into place; if we die in between, openIndex()
+ * finds the index of the old generation and completes the job with the
+ * pending one.
+ */
+static int
+compact(BlobIndex * bi, IdxEntry * e, int n)
+{
+  DataHeader      dh;
   char           *dn = alloca(strlen(bi->dir) + 8);
-  FILE           *x,
-                 *d;
+  char           *pn;
+  char           *buf = NULL;
+  unsigned int    bsize = 0,
+                  ofs = sizeof(DataHeader);
+  int             i,
+                  rc = 0;
+  FILE           *d;
 
-  strcpy(xn, bi->dir);
-  strcat(xn, "idx");
+  bi->fd = fopen(bi->fnd, "rb");
+  if (bi->fd == NULL)
+    return -1;
   strcpy(dn, bi->dir);
   strcat(dn, "inst");
-  x = fopen(xn, "wb");
   d = fopen(dn, "wb");
+  if (d == NULL) {
+    fclose(bi->fd);
+    bi->fd = NULL;
+    return -1;
+  }
 
-  if (bi->bofs)
-    copy(d, bi->fd, bi->bofs, 0);
-  dt += bi->bofs;
-  len = bi->dlen - (bi->bofs + bi->blen);
-  if (len)
-    copy(d, bi->fd, bi->dlen - (bi->bofs + bi->blen), bi->bofs + bi->blen);
-  dt += len;
-  //pos = ftell(d);
-  if (blen)
-    rc = fwrite(blob,blen,1,d) - 1;
-  dt += blen;
+  memset(&dh, 0, sizeof(dh));
+  memcpy(dh.magic, DATA_MAGIC, sizeof(dh.magic));
+  dh.gen = bi->gen + 1;
+  rc = fwrite(&dh, sizeof(dh), 1, d) - 1;
+
+  for (i = 0; i < n && rc == 0; i++) {
+    if (e[i].blen > bsize) {
+      bsize = e[i].blen;
+      buf = realloc(buf, bsize);
+    }
+    if (ofs % BLOB_ALIGN)
+      rc = fwrite(blobPad, BLOB_ALIGN - ofs % BLOB_ALIGN, 1, d) - 1;
+    ofs = BLOB_PAD(ofs);
+    fseek(bi->fd, e[i].bofs, SEEK_SET);
+    if (rc == 0)
+      rc = fread(buf, e[i].blen, 1, bi->fd) - 1;
+    if (rc == 0)
+      rc = fwrite(buf, e[i].blen, 1, d) - 1;
+    e[i].bofs = ofs;
+    ofs += e[i].blen;
+  }
+  free(buf);
+  fclose(bi->fd);
+  bi->fd = NULL;
+  if (rc == 0 && (fflush(d) || fsync(fileno(d))))
+    rc = -1;
   rc += fclose(d);
-  if (rc != 0) return -1;
-
-
-  adjust(bi, bi->pos, bi->blen);
-
-  ofs = bi->pos + bi->len;
-  if (bi->pos)
-    rc += fwrite(bi->index, bi->pos, 1, x) - 1;
-  xt += bi->pos;
-  len = bi->dSize - ofs;
-  if (len)
-    rc += fwrite(bi->index + ofs, len, 1, x) - 1;
-  xt += len;
-  rc += fclose(x);
-  if (rc != 0) return -1;
-
-  remove(bi->fnd);
-  remove(bi->fnx);
-  if (dt)
-    rename(dn, bi->fnd);
-  else
+
+  pn = pendingIndex(bi);
+  if (rc == 0) {
+    bi->gen++;
+    rc = writeIndex(bi, e, n, pn, 1);
+    if (rc == 0)
+      rc = rename(dn, bi->fnd);
+    if (rc != 0) {
+      bi->gen--;
+      remove(pn);
+    }
+  }
+  if (rc != 0) {
     remove(dn);
-  if (xt)
-    rename(xn, bi->fnx);
-  else
-    remove(xn);
+    free(pn);
+    return -1;
+  }
+  /* from here on the pending index is needed until it is the index */
+  rc = rename(pn, bi->fnx);
+  free(pn);
+  return rc ? -1 : 0;
+}
 
-  return 0;
+/*
+ * make the n entries the index, compacting the data file once the dead
+ * blobs take up more than repositoryCompactThreshold percent of it; for
+ * n == 0 both files go, the index first
+ */
+static int
+storeIndex(BlobIndex * bi, IdxEntry * e, int n)
+{
+  unsigned long   live = 0;
+  long            pct;
+  int             i;
+
+  if (n == 0) {
+    remove(bi->fnx);
+    remove(bi->fnd);
+    return 0;
+  }
+
+  for (i = 0; i < n; i++)
+    live += BLOB_PAD(e[i].blen);
+  if (getControlNum("repositoryCompactThreshold", &pct))
+    pct = 50;
+  if (live >= bi->dlen || (bi->dlen - live) * 100 <= pct * bi->dlen)
+    return writeIndex(bi, e, n, bi->fnx, 0);
+  return compact(bi, e, n);
 }
 
-int
-getIndex(const char *ns, const char *cls, int elen, int mki,
-         BlobIndex ** bip)
+/* generation of a data file, 0 if it has no DataHeader */
+static unsigned int
+dataGeneration(const char *fn)
 {
-  BlobIndex      *bi;
-  char           *fn;
-  char           *p;
-  char           *dir;
+  DataHeader      dh;
+  int             fd = open(fn, O_RDONLY),
+      n;
 
-  dir = getRepDir();
+  if (fd < 0)
+    return 0;
+  n = read(fd, &dh, sizeof(dh));
+  close(fd);
+  if (n != sizeof(dh) || memcmp(dh.magic, DATA_MAGIC, sizeof(dh.magic)))
+    return 0;
+  return dh.gen;
+}
 
-  fn = alloca(strlen(dir) + strlen(ns) + strlen(cls) + 8);
+static void
+dropIndex(BlobIndex * bi)
+{
+  if (bi->image) {
+    pthread_mutex_lock(&idxCacheMtx);
+    releaseImage(bi->image);
+    pthread_mutex_unlock(&idxCacheMtx);
+    bi->image = NULL;
+  } else
+    free(bi->index);
+  bi->index = NULL;
+}
 
-  bi = NEW(BlobIndex);
+/* load the index of bi, returns 0 if it matches the data file */
+static int
+matchIndex(BlobIndex * bi)
+{
+  struct stat     st;
 
-  strcpy(fn, dir);
-  p = fn + strlen(fn);
-  strcat(fn, ns);
-  strcat(fn, "/");
-  while (*p) {
-    *p = tolower(*p);
-    p++;
+  bi->gen = dataGeneration(bi->fnd);
+  if (stat(bi->fnx, &st) || loadIndex(bi, &st))
+    return -1;
+  return ((IdxHeader *) bi->index)->gen == bi->gen ? 0 : 1;
+}
+
+/*
+ * the index and the data file of bi are of different generations: either
+ * a writer is between the renames of compact(), then we wait for it, or
+ * one died there, then its pending index becomes the index
+ */
+static int
+recoverIndex(BlobIndex * bi)
+{
+  IdxHeader       hdr;
+  char           *pn = pendingIndex(bi);
+  int             lock,
+                  fd,
+                  rc;
+
+  lock = lockDir(bi->dir);
+  dropIndex(bi);
+  rc = matchIndex(bi);
+  if (rc > 0 && (fd = open(pn, O_RDONLY)) >= 0) {
+    if (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)
+        && memcmp(hdr.magic, IDX_MAGIC, sizeof(hdr.magic)) == 0
+        && hdr.gen == bi->gen && rename(pn, bi->fnx) == 0) {
+      mlogf(M_INFO, M_SHOW, "--- Completed compaction of %s\n", bi->fnd);
+      dropIndex(bi);
+      rc = matchIndex(bi);
+    }
+    close(fd);
   }
-  bi->dir = strdup(fn);
+  if (lock == 0)
+    unlockDir(bi->dir);
+  free(pn);
+  return rc;
+}
+
+/* getIndex(), for writers with the namespace locked */
+static int
+openIndex(const char *ns, const char *cls, int mki, int lock,
+          BlobIndex ** bip)
+{
+  BlobIndex      *bi;
+  char           *fn;
+  char           *p;
+  int             rc;
+
+  bi = NEW(BlobIndex);
+  bi->dir = nameSpaceDir(ns);
+  if (lock)
+    bi->lock = lockDir(bi->dir) == 0;
 
+  fn = alloca(strlen(bi->dir) + strlen(cls) + 8);
+  strcpy(fn, bi->dir);
   p = fn + strlen(fn);
   strcat(fn, cls);
 
@@ -503,122 +1219,124 @@ getIndex(const char *ns, const char *cls, int elen, int mki,
   strcat(fn, ".idx");
   bi->fnx = strdup(fn);
 
-  bi->fx = fopen(bi->fnx, "rb+");
-  if (bi->fx == NULL) {
+  rc = matchIndex(bi);
+  if (rc > 0 && (rc = recoverIndex(bi)) > 0) {
+    mlogf(M_ERROR, M_SHOW,
+          "*** Repository index %s does not match its data file\n",
+          bi->fnx);
+    freeBlobIndex(&bi, 1);
+    *bip = NULL;
+    return 0;
+  }
+  if (rc < 0) {
     if (mki == 0) {
       freeBlobIndex(&bi, 1);
       *bip = NULL;
       return 0;
     }
-    bi->fx = fopen(bi->fnx, "wb");
-    bi->aSize = elen;
-    bi->dSize = 0;
-    bi->index = malloc(bi->aSize);
+    dropIndex(bi);
+    bi->index = buildIndex(NULL, 0, bi->gen, &bi->dSize);
   }
 
-  else {
-    fseek(bi->fx, 0, SEEK_END);
-    bi->dSize = ftell(bi->fx);
-    bi->aSize = bi->dSize + elen;
-    bi->index = malloc(bi->aSize);
-    fseek(bi->fx, 0, SEEK_SET);
-    fread(bi->index, bi->dSize, 1, bi->fx);
-    bi->index[bi->dSize] = 0;
-  }
   *bip = bi;
   return 1;
 }
 
+int
+getIndex(const char *ns, const char *cls,
+         int __attribute__ ((unused)) elen, int mki, BlobIndex ** bip)
+{
+  return openIndex(ns, cls, mki, 0, bip);
+}
+
 int
 addBlob(const char *ns, const char *cls, char *id, void *blob, int len)
 {
-  int             keyl =
-      strlen(ns) + strlen(cls) + strlen(id) + strlen(BASE);
-  int             es,
-                  ep,
+  int             n,
                   rc;
-  char           *idxe = alloca(keyl + 64);
+  long            ofs;
   BlobIndex      *bi;
+  IdxEntry       *e;
 
-  rc = getIndex(ns, cls, keyl + 64, 1, &bi);
+  rc = openIndex(ns, cls, 1, 1, &bi);
   if (rc == 0)
     return 1;
 
-  if (bi->dSize == 0) {
-    bi->fd = fopen(bi->fnd, "wb");
-    if (bi->fd == NULL) {
-      fdHandleError(bi);
-      return -1;
-    }
-    rc = fwrite(blob,len,1,bi->fd) - 1;  /* write the serialized instance */
-    rc += fclose(bi->fd);
-    bi->fd = NULL;
-    if (rc != 0) {
-      fdHandleError(bi); 
-      return -1; 
-    }
-
-    es = sprintf(idxe, "    %zd %s %d %d\r\n", strlen(id), id, len, 0);
-    ep = sprintf(idxe, "%d", es);
-    idxe[ep] = ' ';
+  if ((ofs = appendBlob(bi, blob, len)) < 0) {
+    fdHandleError(bi);
+    return -1;
+  }
 
-    memcpy(bi->index, idxe, es);
-    bi->dSize = es;
-    rc = fwrite(bi->index,bi->dSize,1,bi->fx) - 1;  /* write idx file */
-    rc += fclose(bi->fx);
-    bi->fx = NULL;
-    if (rc != 0) {
-      fdHandleError(bi); 
-      return -1; 
-    }
+  /* a modified blob replaces the index entry of the old one */
+  e = getEntries(bi, &bi->pos, indxLocate(bi, id), 1, &n);
+  e[n].key = id;
+  e[n].keyl = strlen(id);
+  e[n].blen = len;
+  e[n].bofs = ofs;
+  n++;
+
+  rc = storeIndex(bi, e, n);
+  free(e);
+  if (rc != 0) {
+    fdHandleError(bi);
+    return -1;
   }
+  freeBlobIndex(&bi, 1);
+  return 0;
+}
 
-  else {
+/*
+ * add, replace or (for a length of 0) delete n blobs with distinct ids,
+ * rewriting the index once
+ */
+int
+addBlobs(const char *ns, const char *cls, int n, char **ids,
+         void **blobs, int *lens)
+{
+  BlobIndex      *bi;
+  IdxEntry       *e;
+  long           *ofs;
+  int            *drop;
+  int             i,
+                  m,
+                  nd,
+                  rc;
 
-    if (indxLocate(bi,id)) { /* already have entries in the idx file; append */
-      bi->fd = fopen(bi->fnd, "rb");
-      if (bi->fd == NULL) {
-        fdHandleError(bi);
-        return -1;
-      } else {
-        fseek(bi->fd, 0, SEEK_END);
-        bi->dlen = ftell(bi->fd);
-        es = sprintf(idxe, "    %zd %s %d %lu\r\n", strlen(id), id, len,
-                     bi->dlen);
-        ep = sprintf(idxe, "%d", es);
-        idxe[ep] = ' ';
-        memcpy(bi->index + bi->dSize, idxe, es);
-        bi->dSize += es;
-        if (rebuild(bi,blob,len) != 0) { fdHandleError(bi); return -1; }
-      }
-    }
+  if (openIndex(ns, cls, 1, 1, &bi) == 0)
+    return 1;
 
-    else { /* first entry in the idx file */
-      bi->fd = fopen(bi->fnd, "ab+");
-      if (bi->fd == NULL)
-        bi->fd = fopen(bi->fnd, "wb+");
-      fseek(bi->fd, 0, SEEK_END);
-      bi->fpos = ftell(bi->fd);
-      rc = fwrite(blob,len,1,bi->fd) - 1;
-      rc += fclose(bi->fd);
-      bi->fd = NULL;
-      if (rc != 0) {
-        fdHandleError(bi); 
-        return -1; 
-      }
+  drop = malloc(sizeof(int) * (n + 1));
+  for (i = nd = 0; i < n; i++)
+    if (indxLocate(bi, ids[i]))
+      drop[nd++] = bi->pos;
+  qsort(drop, nd, sizeof(int), cmpOfs);
+
+  ofs = malloc(sizeof(long) * (n + 1));
+  if (appendBlobs(bi, n, blobs, lens, ofs)) {
+    free(drop);
+    free(ofs);
+    fdHandleError(bi);
+    return -1;
+  }
 
-      es = sprintf(idxe, "    %zd %s %d %lu\r\n", strlen(id), id, len,
-                   bi->fpos);
-      ep = sprintf(idxe, "%d", es);
-      idxe[ep] = ' ';
-
-      memcpy(bi->index + bi->dSize, idxe, es);
-      bi->dSize += es;
-      fseek(bi->fx, 0, SEEK_SET);
-      rc = fwrite(bi->index,bi->dSize,1,bi->fx) - 1;
-      rc += fclose(bi->fx);
-      bi->fx = NULL;
-    }
+  e = getEntries(bi, drop, nd, n, &m);
+  for (i = 0; i < n; i++) {
+    if (lens[i] == 0)
+      continue;
+    e[m].key = ids[i];
+    e[m].keyl = strlen(ids[i]);
+    e[m].blen = lens[i];
+    e[m].bofs = ofs[i];
+    m++;
+  }
+
+  rc = storeIndex(bi, e, m);
+  free(e);
+  free(drop);
+  free(ofs);
+  if (rc != 0) {
+    fdHandleError(bi);
+    return -1;
   }
   freeBlobIndex(&bi, 1);
   return 0;
@@ -627,26 +1345,27 @@ addBlob(const char *ns, const char *cls, char *id, void *blob, int len)
 int
 deleteBlob(const char *ns, const char *cls, const char *id)
 {
-  int             keyl =
-      strlen(ns) + strlen(cls) + strlen(id) + strlen(BASE);
   BlobIndex      *bi;
-  int             rc;
+  IdxEntry       *e;
+  struct stat     st;
+  int             rc,
+                  n;
 
-  rc = getIndex(ns, cls, keyl + 64, 0, &bi);
+  rc = openIndex(ns, cls, 0, 1, &bi);
 
   if (rc) {
     if (indxLocate(bi, id)) {
-      bi->fd = fopen(bi->fnd, "rb");
-      if (bi->fd == NULL) {
+      if (stat(bi->fnd, &st)) {
         fdHandleError(bi);
         return -1;
-      } else {
-        fseek(bi->fd, 0, SEEK_END);
-        bi->dlen = ftell(bi->fd);
-        if (rebuild(bi,NULL,0) != 0) { fdHandleError(bi); return -1; }
-        freeBlobIndex(&bi, 1);
-        return 0;
       }
+      bi->dlen = st.st_size;
+      e = getEntries(bi, &bi->pos, 1, 0, &n);
+      rc = storeIndex(bi, e, n);
+      free(e);
+      if (rc != 0) { fdHandleError(bi); return -1; }
+      freeBlobIndex(&bi, 1);
+      return 0;
     }
   }
   freeBlobIndex(&bi, 1);
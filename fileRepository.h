@@ -44,6 +44,10 @@ typedef struct blobIndex {
                   next;
   unsigned long   fpos;
   unsigned long   dlen;
+  void           *image;        /* cached index image index points into */
+  void           *map;          /* mapped data file, see mapBlobIndex() */
+  unsigned int    gen;          /* generation of the data file */
+  int             lock;         /* holds the namespace lock of writers */
 } BlobIndex;
 
 #define NEW(td) (td*)calloc(sizeof(td),1)
@@ -53,6 +57,8 @@ extern int      getIndex(const char *ns, const char *cls, int elen,
                          int mki, BlobIndex ** bip);
 extern int      addBlob(const char *ns, const char *cls, char *id,
                         void *blob, int len);
+extern int      addBlobs(const char *ns, const char *cls, int n,
+                         char **ids, void **blobs, int *lens);
 extern int      deleteBlob(const char *ns, const char *cls,
                            const char *id);
 extern void    *getBlob(const char *ns, const char *cls, const char *id,
@@ -60,11 +66,23 @@ extern void    *getBlob(const char *ns, const char *cls, const char *id,
 extern int      existingBlob(const char *ns, const char *cls,
                              const char *id);
 extern int      existingNameSpace(const char *ns);
+extern int      lockNameSpace(const char *ns);
+extern void     unlockNameSpace(const char *ns);
 extern void    *getFirst(BlobIndex * bi, int *len, char **keyb,
                          size_t * keybl);
 extern void    *getNext(BlobIndex * bi, int *len, char **keyb,
                         size_t * keybl);
 
+/*
+ * After mapBlobIndex() succeeded, getFirst()/getNext() return blobs in a
+ * copy on write mapping of the data file; they must not be freed and are
+ * valid until freeBlobIndex(), or until releaseBlobMap() of a holdBlobMap()
+ * handle.
+ */
+extern int      mapBlobIndex(BlobIndex * bi);
+extern void    *holdBlobMap(BlobIndex * bi);
+extern void     releaseBlobMap(void *map);
+
 /*
  * NOTE: useAlternateRepository must be called prior to calling any other
  * functions from fileRepository.h 
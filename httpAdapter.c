@@ -64,9 +64,14 @@
 
 #include <sys/resource.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include "httpComm.h"
 #include "sfcVersion.h"
 #include "control.h"
+#include "latencyStats.h"
 
 #ifdef HAVE_UDS
 #include <grp.h>
@@ -102,6 +107,10 @@ static long     keepaliveMaxRequest = 10;
 extern long     httpReqHandlerTimeout;
 static long     numRequest;
 static long     selectTimeout = 5; /* default 5 sec. timeout for select() before read() */
+static int      httpWorkerPool = 0;
+static int      inHttpWorker = 0;
+static long     httpWorkerMaxRequests = 1000;
+static int      doBaCfg;
 struct timeval  httpSelectTimeout = { 0, 0 };   
 
 #if defined USE_SSL
@@ -149,6 +158,61 @@ static key_t    httpWorkSemKey;
 static int      httpProcSem;
 static int      httpWorkSem;
 
+/*
+ * pre-forked request handler, one per httpProcs slot (httpWorkerPool)
+ */
+typedef struct httpWorker {
+  pid_t           pid;
+  int             sock;         /* daemon end of the socket pair, -1 if
+                                 * the handler is gone */
+  int             idle;
+} HttpWorker;
+
+static HttpWorker *httpWorkers = NULL;
+static int      httpConnInFlight = -1;  /* connection being dispatched */
+static long     httpConnRequests = 0;   /* requests already served on the
+                                         * connection (handlers only) */
+static int      parkedConnFd = -1;      /* connection to hand back to the
+                                         * daemon (handlers only) */
+static void     dispatchHttpRequest(int connFd, int sslMode,
+                                    unsigned int sid, long nreq);
+
+/*
+ * sslMode and the number of requests already served on a connection travel
+ * in the data field of the MSG_X_HTTP_CONN message 
+ */
+#define HTTP_CONN_DATA(ssl,n) ((void *) (((long) (n) << 1) | ((ssl) ? 1 : 0)))
+#define HTTP_CONN_SSL(d)      ((int) ((long) (d) & 1))
+#define HTTP_CONN_NREQ(d)     ((long) (d) >> 1)
+
+/*
+ * idle non-SSL connection parked in the daemon until a complete request
+ * header has arrived (httpParkConnections), or connection queued for the
+ * next idle request handler
+ */
+typedef struct parkedConn {
+  int             fd;
+  int             sslMode;
+  unsigned int    sessionId;
+  long            numRequest;
+  time_t          expires;
+  struct parkedConn *prev,
+                 *next;
+} ParkedConn;
+
+static int      httpParkConnections = 1;
+static int      parkFd = -1;    /* epoll instance, -1 if not parking */
+static ParkedConn *parkedFirst = NULL,  /* ordered by expires */
+               *parkedLast = NULL;
+static ParkedConn *queuedFirst = NULL,  /* ready, all handlers busy */
+               *queuedLast = NULL;
+static long     httpMaxParkedConnections = 1024;
+static long     heldConnections = 0;    /* parked and queued */
+static void     parkHttpConnection(int fd, unsigned int sid, long nreq);
+static void     queueHttpConnection(int fd, int sslMode, unsigned int sid,
+                                    long nreq);
+static void     dispatchHttpConnections();
+
 extern char    *decode64(char *data);
 extern void     libraryName(const char *dir, const char *location,
                             char *fullName, int buf_size);
@@ -227,7 +291,8 @@ extern int fallback_ipv4;
 
 #define SET_HDR_CP(member, val)   member = val + strspn(val, " \t"); \
 
-#define TERMINATE(x) { if (!doFork) _SFCB_RETURN(x); commClose(conn_fd); exit(x); }
+#define TERMINATE(x) { if (!doFork || inHttpWorker) { freeBuffer(&inBuf); _SFCB_RETURN(x); } \
+                       commClose(conn_fd); exit(x); }
 
 void
 initHttpProcCtl(int p, int adapterNum)
@@ -676,7 +741,7 @@ writeResponse(CommHndl conn_fd, RespSegments rs)
 }
 
 static void
-writeChunkHeaders(BinRequestContext * ctx)
+writeChunkHeaders(BinRequestContext * ctx, int trailers)
 {
   static char     head[] = { "HTTP/1.1 200 OK\r\n" };
   static char     cont[] =
@@ -695,7 +760,8 @@ writeChunkHeaders(BinRequestContext * ctx)
   commWrite(*(ctx->commHndl), cach, strlen(cach));
   commWrite(*(ctx->commHndl), op, strlen(op));
   commWrite(*(ctx->commHndl), tenc, strlen(tenc));
-  commWrite(*(ctx->commHndl), trls, strlen(trls));
+  if (trailers)
+    commWrite(*(ctx->commHndl), trls, strlen(trls));
   if (keepaliveTimeout == 0 || numRequest >= keepaliveMaxRequest) {
     commWrite(*(ctx->commHndl), cclose, strlen(cclose));
   }
@@ -723,7 +789,7 @@ writeChunkResponse(BinRequestContext * ctx, BinResponseHdr * rh)
       commFlush(*(ctx->commHndl));
       _SFCB_EXIT();
     }
-    writeChunkHeaders(ctx);
+    writeChunkHeaders(ctx, 1);
     /*
      * if (rh->rc!=1) { _SFCB_TRACE(1,("--- writeChunkResponse case 1
      * error")); rh->moreChunks=0; break; } 
@@ -811,8 +877,42 @@ writeChunkResponse(BinRequestContext * ctx, BinResponseHdr * rh)
   _SFCB_EXIT();
 }
 
+/*
+ * body of a response that is generated while it is written, see
+ * streamResponses() in cimRequest.c. All errors are known before it
+ * starts, so no trailers are needed.
+ */
+static void
+writeStreamResponse(BinRequestContext * ctx, const char *data,
+                    unsigned int len)
+{
+  char            str[32];
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "writeStreamResponse");
+
+  if (ctx->chunkedMode != 3) {
+    writeChunkHeaders(ctx, 0);
+    ctx->chunkedMode = 3;
+  }
+
+  if (len) {
+    sprintf(str, "\r\n%x\r\n", len);
+    commWrite(*(ctx->commHndl), str, strlen(str));
+    commWrite(*(ctx->commHndl), (void *) data, len);
+  } else {
+    commWrite(*(ctx->commHndl), "\r\n0\r\n\r\n", 7);
+    commFlush(*(ctx->commHndl));
+  }
+  _SFCB_EXIT();
+}
+
 static ChunkFunctions httpChunkFunctions = {
   writeChunkResponse,
+  writeStreamResponse,
+};
+
+static ChunkFunctions httpChunkFunctionsNoStream = {
+  writeChunkResponse,
+  NULL,
 };
 
 static int
@@ -1028,6 +1128,7 @@ doHttpRequest(CommHndl conn_fd)
   int             discardInput = 0;
   MsgSegment      msgs[2];
   CimRequestContext ctx;
+  struct timeval  opStart;
   int             breakloop;
   int             hcrFlags = 0;  /* flags to pass to handleCimRequest() */
 #ifdef SFCB_DEBUG
@@ -1088,7 +1189,10 @@ doHttpRequest(CommHndl conn_fd)
      * no buffer data - end of file - quit 
      */
     _SFCB_TRACE(1, ("--- HTTP connection EOF, normal termination"));
-    if (!doFork) _SFCB_RETURN(1);
+    if (!doFork || inHttpWorker) {
+      freeBuffer(&inBuf);
+      _SFCB_RETURN(1);
+    }
     _SFCB_TRACE(1, ("--- Request processor exiting %d", currentProc));
     commClose(conn_fd);
     exit(1);
@@ -1376,8 +1480,17 @@ doHttpRequest(CommHndl conn_fd)
   ctx.path = inBuf.path;
 
   if (msgs[1].length >= 0) {
-    ctx.chunkFncs = &httpChunkFunctions;
+    /*
+     * HTTP/1.0 clients do not know chunked responses 
+     */
+    if (chunkMode != CHUNK_NEVER
+        && strncasecmp(inBuf.protocol, "HTTP/1.1", 8) == 0)
+      ctx.chunkFncs = &httpChunkFunctions;
+    else
+      ctx.chunkFncs = &httpChunkFunctionsNoStream;
     ctx.sessionId = sessionId;
+    ctx.operation = 0;
+    gettimeofday(&opStart, NULL);
 
 #ifdef SFCB_DEBUG
     if ((*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING)) {
@@ -1421,6 +1534,11 @@ doHttpRequest(CommHndl conn_fd)
 
   releaseAuthHandle();
 
+  /*
+   * requests that were not parsed left ctx.operation 0 and are not counted 
+   */
+  recordOperationLatency(ctx.operation, &opStart);
+
 #ifdef SFCB_DEBUG
   if (uset && (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING)) {
     gettimeofday(&ev, NULL);
@@ -1444,7 +1562,7 @@ doHttpRequest(CommHndl conn_fd)
  *
  */
 static void
-handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
+handleHttpRequest(int connFd, int sslMode)
 {
   int             r;
   CommHndl        conn_fd;
@@ -1455,7 +1573,19 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
 
   _SFCB_ENTER(TRACE_HTTPDAEMON, "handleHttpRequest");
 
-  if (doFork) {
+  if (doFork && httpWorkerPool && !inHttpWorker) {
+    sessionId++;
+    if (parkFd >= 0 && !sslMode)
+      parkHttpConnection(dup(connFd), sessionId, 0);
+    else if (parkFd >= 0) {
+      queueHttpConnection(dup(connFd), sslMode, sessionId, 0);
+      dispatchHttpConnections();
+    } else
+      dispatchHttpRequest(connFd, sslMode, sessionId, 0);
+    _SFCB_EXIT();
+  }
+
+  if (doFork && !inHttpWorker) {
     _SFCB_TRACE(1, ("--- Forking request processor"));
     semAcquire(httpWorkSem, 0);
     semAcquire(httpProcSem, 0);
@@ -1733,7 +1863,7 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
       conn_fd.ssl = NULL;
     }
 #endif
-    numRequest = 0;
+    numRequest = httpConnRequests;
     FD_ZERO(&httpfds);
     FD_SET(conn_fd.socket, &httpfds);
     do {
@@ -1752,6 +1882,15 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
         _SFCB_TRACE(1,("--- keepalive disabled or max requests exceeded"));
         break;
       }
+      if (inHttpWorker && httpParkConnections && !sslMode) {
+        /*
+         * let the daemon wait for the next request, this handler is free
+         * for other connections in the meantime 
+         */
+        _SFCB_TRACE(1, ("--- keepalive enabled, parking connection"));
+        parkedConnFd = dup(conn_fd.socket);
+        break;
+      }
       _SFCB_TRACE(1, ("--- keepalive enabled, waiting for new request"));
       /*
        * wait for next request or timeout 
@@ -1773,7 +1912,7 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
     } while (1);
 
     commClose(conn_fd);
-    if (!doFork) {
+    if (!doFork || inHttpWorker) {
       _SFCB_TRACE(1, ("--- Request processor completed"));
       _SFCB_EXIT();
     }
@@ -1785,6 +1924,567 @@ handleHttpRequest(int connFd, int __attribute__ ((unused)) sslMode)
 
 }
 
+/*
+ * pre-forked request handler pool (httpWorkerPool)
+ *
+ * Instead of forking per connection, httpProcs request handlers are forked
+ * at startup. The daemon passes each accepted connection to an idle handler
+ * over a socket pair (SCM_RIGHTS), the handler serves it and reports back on
+ * the same socket pair when it is ready for the next one. If the connection
+ * is kept alive, it is handed back with that report and the daemon parks it
+ * until the next request header is complete.
+ */
+
+static void
+httpWorkerLoop(int sock)
+{
+  int             connFd,
+                  fd,
+                  rc;
+  char            c;
+  void           *data;
+  unsigned long   sid;
+  long            served = 0;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "httpWorkerLoop");
+
+  for (;;) {
+    /* wait quietly, EOF means the daemon is stopping or recycling us */
+    do {
+      rc = recv(sock, &c, 1, MSG_PEEK);
+    } while (rc < 0 && errno == EINTR);
+    if (rc <= 0)
+      break;
+
+    rc = spRecvCtlResult(&sock, &connFd, &data, &sid);
+    if (rc != MSG_X_HTTP_CONN) {
+      mlogf(M_ERROR, M_SHOW, "--- %s %d: unexpected message %d\n",
+            processName, currentProc, rc);
+      break;
+    }
+
+    /* don't let one connection's state leak into the next one */
+    sessionId = sid;
+    doBa = doBaCfg;
+#if defined USE_SSL
+    x509 = NULL;
+#endif
+    httpConnRequests = HTTP_CONN_NREQ(data);
+    parkedConnFd = -1;
+
+    handleHttpRequest(connFd, HTTP_CONN_SSL(data));
+
+    served += numRequest - httpConnRequests;
+
+    /* done - hand back a kept alive connection, if any */
+    fd = parkedConnFd > 0 ? parkedConnFd : 0;
+    rc = spSendCtlResult(&sock, &fd, MSG_X_HTTP_CONN, sessionId,
+                         HTTP_CONN_DATA(0, numRequest), 0);
+    if (parkedConnFd >= 0)
+      close(parkedConnFd);
+    if (rc)
+      break;
+
+    if (httpWorkerMaxRequests && served >= httpWorkerMaxRequests) {
+      _SFCB_TRACE(1, ("--- Request processor %d recycling after %ld requests",
+                      currentProc, served));
+      break;
+    }
+  }
+
+  _SFCB_TRACE(1, ("--- Request processor exiting %d", currentProc));
+  dumpTiming(currentProc);
+  exit(0);
+}
+
+static void
+startHttpWorker(int w)
+{
+  ComSockets      sp;
+  ParkedConn     *pc;
+  pid_t           pid;
+  int             i;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "startHttpWorker");
+
+  sp = getSocketPair("startHttpWorker");
+  pid = fork();
+
+  /*
+   * child's thread of execution
+   */
+  if (pid == 0) {
+    currentProc = getpid();
+    processName = "CIMREQ-Processor";
+    inHttpWorker = 1;
+    httpProcIdX = w + 1;
+
+    /* keep only what this handler needs, clients must see EOF when the
+     * daemon or another handler closes their connection */
+    for (i = 0; i < hMax; i++)
+      if (httpWorkers[i].sock >= 0)
+        close(httpWorkers[i].sock);
+    close(sp.send);
+    if (httpConnInFlight >= 0)
+      close(httpConnInFlight);
+    for (pc = parkedFirst; pc; pc = pc->next)
+      close(pc->fd);
+    for (pc = queuedFirst; pc; pc = pc->next)
+      close(pc->fd);
+    if (parkFd >= 0)
+      close(parkFd);
+    parkFd = -1;
+
+    semReleaseUnDo(httpProcSem, httpProcIdX);
+    atexit(releaseAuthHandle);
+    atexit(uninitGarbageCollector);
+    atexit(sunsetControl);
+
+    /* Label the process by modifying the cmdline */
+    extern void append2Argv(char *appendstr);
+    extern unsigned int labelProcs;
+    if (labelProcs) {
+      append2Argv(" -reqhandler: ");
+      char handlerId[8];
+      sprintf(handlerId, "%d", httpProcIdX);
+      append2Argv(handlerId);
+    }
+
+    _SFCB_TRACE(1, ("--- Pre-forked request processor %d", currentProc));
+    httpWorkerLoop(sp.receive);
+  }
+
+  close(sp.receive);
+  if (pid < 0) {
+    mlogf(M_ERROR, M_SHOW, "--- fork handler: %s\n", strerror(errno));
+    close(sp.send);
+    _SFCB_EXIT();
+  }
+
+  running++;
+  httpWorkers[w].pid = pid;
+  httpWorkers[w].sock = sp.send;
+  httpWorkers[w].idle = 1;
+  _SFCB_EXIT();
+}
+
+/* (re)start the handlers of all empty slots */
+static void
+startHttpWorkers()
+{
+  int             w;
+
+  if (stopAccepting)
+    return;
+  for (w = 0; w < hMax; w++)
+    if (httpWorkers[w].sock < 0)
+      startHttpWorker(w);
+}
+
+/* close our end of all handler socket pairs; each handler exits as soon as
+ * its current connection is done */
+static void
+stopHttpWorkers()
+{
+  int             w;
+
+  for (w = 0; w < hMax; w++) {
+    if (httpWorkers[w].sock >= 0)
+      close(httpWorkers[w].sock);
+    httpWorkers[w].sock = -1;
+    httpWorkers[w].idle = 0;
+  }
+}
+
+static int
+setHttpWorkerFds(fd_set *fds, int maxfdp1)
+{
+  int             w;
+
+  for (w = 0; w < hMax; w++) {
+    if (httpWorkers[w].sock >= 0) {
+      FD_SET(httpWorkers[w].sock, fds);
+      if (httpWorkers[w].sock >= maxfdp1)
+        maxfdp1 = httpWorkers[w].sock + 1;
+    }
+  }
+  return maxfdp1;
+}
+
+/* pick up reports of handlers that are done with their connection; EOF
+ * means the handler has exited (recycled, crashed, timed out) */
+static void
+collectHttpWorkers(fd_set *fds)
+{
+  int             w,
+                  rc,
+                  fd;
+  char            c;
+  void           *data;
+  unsigned long   sid;
+
+  for (w = 0; w < hMax; w++) {
+    if (httpWorkers[w].sock < 0 || !FD_ISSET(httpWorkers[w].sock, fds))
+      continue;
+    do {
+      rc = recv(httpWorkers[w].sock, &c, 1, MSG_PEEK);
+    } while (rc < 0 && errno == EINTR);
+    if (rc > 0
+        && spRecvCtlResult(&httpWorkers[w].sock, &fd, &data,
+                           &sid) == MSG_X_HTTP_CONN) {
+      httpWorkers[w].idle = 1;
+      if (fd > 0)
+        parkHttpConnection(fd, sid, HTTP_CONN_NREQ(data));
+    } else {
+      close(httpWorkers[w].sock);
+      httpWorkers[w].sock = -1;
+      httpWorkers[w].idle = 0;
+    }
+  }
+}
+
+/* hand a connection to an idle request handler; returns -1 if all of them
+ * are busy */
+static int
+passHttpConnection(int connFd, int sslMode, unsigned int sid, long nreq)
+{
+  int             w;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "passHttpConnection");
+
+  startHttpWorkers();
+  for (w = 0; w < hMax; w++) {
+    if (httpWorkers[w].sock < 0 || !httpWorkers[w].idle)
+      continue;
+    if (spSendCtlResult(&httpWorkers[w].sock, &connFd, MSG_X_HTTP_CONN,
+                        sid, HTTP_CONN_DATA(sslMode, nreq), 0) == 0) {
+      _SFCB_TRACE(1, ("--- Passed connection to request processor %d",
+                      httpWorkers[w].pid));
+      httpWorkers[w].idle = 0;
+      _SFCB_RETURN(0);
+    }
+    /* handler went away under us, try the next one */
+    close(httpWorkers[w].sock);
+    httpWorkers[w].sock = -1;
+    httpWorkers[w].idle = 0;
+  }
+  _SFCB_RETURN(-1);
+}
+
+/* dispatch a connection, waiting for a handler if all are busy; only used
+ * when connections are not parked, otherwise they are queued */
+static void
+dispatchHttpRequest(int connFd, int sslMode, unsigned int sid, long nreq)
+{
+  fd_set          fds;
+  int             rc,
+                  maxfdp1;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "dispatchHttpRequest");
+
+  httpConnInFlight = connFd;
+  for (;;) {
+    if (passHttpConnection(connFd, sslMode, sid, nreq) == 0) {
+      httpConnInFlight = -1;
+      _SFCB_EXIT();
+    }
+
+    if (stopAccepting)
+      break;
+
+    /*
+     * all handlers busy - wait for one of them to finish
+     */
+    FD_ZERO(&fds);
+    maxfdp1 = setHttpWorkerFds(&fds, 0);
+    if (maxfdp1 == 0) {
+      sleep(1);
+      continue;
+    }
+    rc = select(maxfdp1, &fds, NULL, NULL, NULL);
+    if (rc > 0)
+      collectHttpWorkers(&fds);
+  }
+
+  _SFCB_TRACE(1, ("--- Stopping, connection not dispatched"));
+  httpConnInFlight = -1;
+  _SFCB_EXIT();
+}
+
+/*
+ * connection parking (httpParkConnections)
+ *
+ * Connections without a complete request header - new ones as well as kept
+ * alive ones between requests - wait in an epoll set of the daemon instead
+ * of tying up a request handler. Once the header is complete they are
+ * queued and passed on as handlers become idle, so the daemon keeps
+ * serving the epoll set while all handlers are busy. Parked connections
+ * that stay idle too long are closed.
+ */
+
+#ifdef HAVE_SYS_EPOLL_H
+
+static void
+unparkHttpConnection(ParkedConn * pc)
+{
+  epoll_ctl(parkFd, EPOLL_CTL_DEL, pc->fd, NULL);
+  if (pc->prev)
+    pc->prev->next = pc->next;
+  else
+    parkedFirst = pc->next;
+  if (pc->next)
+    pc->next->prev = pc->prev;
+  else
+    parkedLast = pc->prev;
+  heldConnections--;
+  free(pc);
+}
+
+static void
+parkHttpConnection(int fd, unsigned int sid, long nreq)
+{
+  ParkedConn     *pc,
+                 *p;
+  struct epoll_event ev;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "parkHttpConnection");
+
+  if (fd < 0) {
+    mlogf(M_ERROR, M_SHOW, "--- park connection: %s\n", strerror(errno));
+    _SFCB_EXIT();
+  }
+
+  pc = malloc(sizeof(*pc));
+  pc->fd = fd;
+  pc->sessionId = sid;
+  pc->numRequest = nreq;
+  /* same limits as in the handler: selectTimeout for the first request,
+   * keepaliveTimeout between requests */
+  pc->expires = time(NULL) + (nreq ? keepaliveTimeout : selectTimeout);
+
+  /* edge triggered: a partial header must not wake us up again until more
+   * data has arrived */
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  ev.data.ptr = pc;
+  if (epoll_ctl(parkFd, EPOLL_CTL_ADD, fd, &ev)) {
+    mlogf(M_ERROR, M_SHOW, "--- park connection: %s\n", strerror(errno));
+    close(fd);
+    free(pc);
+    _SFCB_EXIT();
+  }
+
+  for (p = parkedLast; p && p->expires > pc->expires; p = p->prev);
+  pc->prev = p;
+  pc->next = p ? p->next : parkedFirst;
+  if (pc->next)
+    pc->next->prev = pc;
+  else
+    parkedLast = pc;
+  if (p)
+    p->next = pc;
+  else
+    parkedFirst = pc;
+  heldConnections++;
+
+  _SFCB_TRACE(1, ("--- Parked connection %d (%ld requests)", fd, nreq));
+  _SFCB_EXIT();
+}
+
+/* takes the first connection off the queue */
+static void
+unqueueHttpConnection()
+{
+  ParkedConn     *pc = queuedFirst;
+
+  queuedFirst = pc->next;
+  if (queuedFirst)
+    queuedFirst->prev = NULL;
+  else
+    queuedLast = NULL;
+  heldConnections--;
+  free(pc);
+}
+
+/* close parked connections that stayed idle too long, and queued ones no
+ * handler took in time; returns the number of seconds until the next one
+ * expires, -1 if none is held */
+static long
+expireHttpConnections()
+{
+  time_t          now = time(NULL),
+                  next;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "expireHttpConnections");
+
+  while (parkedFirst && parkedFirst->expires <= now) {
+    _SFCB_TRACE(1, ("--- HTTP connection timeout, closing %d",
+                    parkedFirst->fd));
+    close(parkedFirst->fd);
+    unparkHttpConnection(parkedFirst);
+  }
+  /* queued in order, so they expire in order */
+  while (queuedFirst && queuedFirst->expires <= now) {
+    _SFCB_TRACE(1, ("--- HTTP connection not dispatched in time, closing %d",
+                    queuedFirst->fd));
+    close(queuedFirst->fd);
+    unqueueHttpConnection();
+  }
+
+  if (parkedFirst == NULL && queuedFirst == NULL)
+    _SFCB_RETURN(-1);
+  if (parkedFirst == NULL)
+    next = queuedFirst->expires;
+  else if (queuedFirst == NULL || parkedFirst->expires < queuedFirst->expires)
+    next = parkedFirst->expires;
+  else
+    next = queuedFirst->expires;
+  _SFCB_RETURN(next - now);
+}
+
+static void
+closeHttpConnections()
+{
+  while (parkedFirst) {
+    close(parkedFirst->fd);
+    unparkHttpConnection(parkedFirst);
+  }
+  while (queuedFirst) {
+    close(queuedFirst->fd);
+    unqueueHttpConnection();
+  }
+}
+
+/* queue a connection with a complete request header (or an SSL one) until
+ * a request handler is idle, the daemon must not block on busy handlers
+ * while it keeps parked connections. If none gets idle within
+ * selectTimeout the connection is closed. */
+static void
+queueHttpConnection(int fd, int sslMode, unsigned int sid, long nreq)
+{
+  ParkedConn     *pc;
+
+  if (fd < 0) {
+    mlogf(M_ERROR, M_SHOW, "--- queue connection: %s\n", strerror(errno));
+    return;
+  }
+
+  pc = malloc(sizeof(*pc));
+  pc->fd = fd;
+  pc->sslMode = sslMode;
+  pc->sessionId = sid;
+  pc->numRequest = nreq;
+  pc->expires = time(NULL) + selectTimeout;
+  pc->next = NULL;
+  pc->prev = queuedLast;
+  if (queuedLast)
+    queuedLast->next = pc;
+  else
+    queuedFirst = pc;
+  queuedLast = pc;
+  heldConnections++;
+}
+
+/* pass queued connections on in order while there are idle handlers */
+static void
+dispatchHttpConnections()
+{
+  ParkedConn     *pc;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "dispatchHttpConnections");
+
+  while ((pc = queuedFirst)
+         && passHttpConnection(pc->fd, pc->sslMode, pc->sessionId,
+                               pc->numRequest) == 0) {
+    close(pc->fd);
+    unqueueHttpConnection();
+  }
+  _SFCB_EXIT();
+}
+
+/* queue parked connections whose request header is complete */
+static void
+serviceHttpConnections()
+{
+  struct epoll_event ev[64];
+  char            buf[hdrLimmit + 1];
+  ParkedConn     *pc;
+  unsigned int    sid;
+  long            nreq;
+  int             n,
+                  i,
+                  r,
+                  fd;
+
+  _SFCB_ENTER(TRACE_HTTPDAEMON, "serviceHttpConnections");
+
+  n = epoll_wait(parkFd, ev, sizeof(ev) / sizeof(ev[0]), 0);
+  for (i = 0; i < n; i++) {
+    pc = ev[i].data.ptr;
+    r = recv(pc->fd, buf, hdrLimmit, MSG_PEEK | MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EINTR))
+      continue;
+    if (r > 0) {
+      buf[r] = 0;
+      /* same success condition as getHdrs(); an oversized header is left
+       * to the handler to reject */
+      if (strstr(buf, "\r\n\r\n") == NULL && strstr(buf, "\n\n") == NULL
+          && r < hdrLimmit)
+        continue;
+      fd = pc->fd;
+      sid = pc->sessionId;
+      nreq = pc->numRequest;
+      unparkHttpConnection(pc);
+      queueHttpConnection(fd, 0, sid, nreq);
+      continue;
+    }
+    /* client went away (or the connection broke) while idle */
+    _SFCB_TRACE(1, ("--- Parked connection %d closed by client", pc->fd));
+    close(pc->fd);
+    unparkHttpConnection(pc);
+  }
+  _SFCB_EXIT();
+}
+
+#else
+
+static void
+parkHttpConnection(int fd, unsigned int sid, long nreq)
+{
+  dispatchHttpRequest(fd, 0, sid, nreq);
+  close(fd);
+}
+
+static long
+expireHttpConnections()
+{
+  return -1;
+}
+
+static void
+closeHttpConnections()
+{
+}
+
+static void
+serviceHttpConnections()
+{
+}
+
+static void
+queueHttpConnection(int fd, int sslMode, unsigned int sid, long nreq)
+{
+  dispatchHttpRequest(fd, sslMode, sid, nreq);
+  close(fd);
+}
+
+static void
+dispatchHttpConnections()
+{
+}
+
+#endif                          // HAVE_SYS_EPOLL_H
+
 int
 isDir(const char __attribute__ ((unused)) *path)
 {
@@ -2179,6 +2879,11 @@ httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr,
   int             enableHttp = 0;
   fd_set          httpfds;
   int             maxfdp1;      /* highest-numbered fd +1 */
+  int             selfdp1,
+                  accepting,
+                  i;
+  long            parkWait;
+  struct timeval  parkTimeout;
 
 #ifdef USE_SSL
 #ifdef HAVE_IPV6
@@ -2225,6 +2930,14 @@ httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr,
 
   if (getControlNum("httpProcs", &hMax))
     hMax = 10;
+  if (getControlBool("httpWorkerPool", &httpWorkerPool))
+    httpWorkerPool = 0;
+  if (getControlNum("httpWorkerMaxRequests", &httpWorkerMaxRequests))
+    httpWorkerMaxRequests = 1000;
+  if (getControlBool("httpParkConnections", &httpParkConnections))
+    httpParkConnections = 1;
+  if (getControlNum("httpMaxParkedConnections", &httpMaxParkedConnections))
+    httpMaxParkedConnections = 1024;
   if (getControlBool("enableHttp", &enableHttp))
     enableHttp = 1;
 #ifdef HAVE_UDS
@@ -2239,12 +2952,17 @@ httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr,
   if (hMax == 1) {
     mlogf(M_INFO, M_SHOW, "--- Forking of http request handlers disabled\n");
     doFork = 0;
+  } else if (httpWorkerPool) {
+    mlogf(M_INFO, M_SHOW,
+          "--- Pre-forking http request handlers, max requests per handler: %ld\n",
+          httpWorkerMaxRequests);
   }
 
   initHttpProcCtl(hMax, adapterNum);
 
   if (getControlBool("doBasicAuth", &doBa))
     doBa = 0;
+  doBaCfg = doBa;
 
 #ifdef HAVE_UDS
   if (getControlBool("doUdsAuth", &doUdsAuth))
@@ -2426,36 +3144,83 @@ httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr,
   semAcquire(sfcbSem, INIT_PROV_MGR_ID);
 #endif
 
+  if (doFork && httpWorkerPool) {
+    httpWorkers = calloc(hMax, sizeof(HttpWorker));
+    for (i = 0; i < hMax; i++)
+      httpWorkers[i].sock = -1;
+#ifdef HAVE_SYS_EPOLL_H
+    if (httpParkConnections && (parkFd = epoll_create(64)) < 0)
+      mlogf(M_ERROR, M_SHOW, "--- epoll_create: %s - not parking connections\n",
+            strerror(errno));
+#endif
+  }
+  /* handlers only hand back connections if the daemon can park them */
+  if (parkFd < 0)
+    httpParkConnections = 0;
+
   for (;;) {
 
+    if (httpWorkers)
+      startHttpWorkers();
+
     /*
      * select() modifies httpfds in-place, so reset after every select() 
      */
     FD_ZERO(&httpfds);
-    if (httpListenFd >= 0) {
+    /*
+     * holding httpMaxParkedConnections already, further clients wait in
+     * the listen backlog until some are passed on or expire 
+     */
+    accepting = parkFd < 0 || httpMaxParkedConnections <= 0
+        || heldConnections < httpMaxParkedConnections;
+    if (httpListenFd >= 0 && accepting) {
       FD_SET(httpListenFd, &httpfds);
     }
 #ifdef USE_SSL
-    if (httpsListenFd >= 0) {
+    if (httpsListenFd >= 0 && accepting) {
       FD_SET(httpsListenFd, &httpfds);
     }
 #endif                          // USE_SSL
 #ifdef HAVE_UDS
-    if (udsListenFd >= 0) {
+    if (udsListenFd >= 0 && accepting) {
       FD_SET(udsListenFd, &httpfds);
     }
 #endif                          // USE_UDS
-
-    rc = select(maxfdp1, &httpfds, NULL, NULL, NULL);
-
-    if (stopAccepting)
+    selfdp1 = maxfdp1;
+    if (httpWorkers)
+      selfdp1 = setHttpWorkerFds(&httpfds, maxfdp1);
+    parkWait = -1;
+    if (parkFd >= 0) {
+      FD_SET(parkFd, &httpfds);
+      if (parkFd >= selfdp1)
+        selfdp1 = parkFd + 1;
+      parkWait = expireHttpConnections();
+      /* retry queued connections even if no handler reports back, one
+       * may have to be restarted */
+      if (queuedFirst && (parkWait < 0 || parkWait > 1))
+        parkWait = 1;
+    }
+    parkTimeout.tv_sec = parkWait;
+    parkTimeout.tv_usec = 0;
+
+    rc = select(selfdp1, &httpfds, NULL, NULL,
+                parkWait < 0 ? NULL : &parkTimeout);
+
+    if (stopAccepting) {
+      if (httpWorkers)
+        stopHttpWorkers();
+      closeHttpConnections();
       break;
+    }
 
 #ifdef USE_SSL
     if (sslReloadRequested) {
       sunsetControl();
       setupControl(configfile);
       initSSL();
+      /* pooled handlers still hold the old context */
+      if (httpWorkers)
+        stopHttpWorkers();
       sleep(1);
       continue;
     }
@@ -2466,6 +3231,13 @@ httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr,
       }
     }
 
+    if (httpWorkers && rc > 0)
+      collectHttpWorkers(&httpfds);
+    if (parkFd >= 0 && rc > 0 && FD_ISSET(parkFd, &httpfds))
+      serviceHttpConnections();
+    if (parkFd >= 0)
+      dispatchHttpConnections();
+
     if (httpListenFd >= 0 && FD_ISSET(httpListenFd, &httpfds)) {
       _SFCB_TRACE(1, ("--- Processing http request"));
       acceptRequest(httpListenFd, &httpSin, httpSin_len, 0);
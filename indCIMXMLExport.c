@@ -24,6 +24,7 @@
 #include "trace.h"
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "control.h"
 
 extern UtilStringBuffer *newStringBuffer(int);
@@ -269,7 +270,8 @@ genRequest(CurlData * cd, char *url, char **msg)
   rv = curl_easy_setopt(cd->mHandle, CURLOPT_WRITEFUNCTION, writeCb);
 
   // Use CURLOPT_FILE instead of CURLOPT_WRITEDATA - more portable
-  cd->mResponse = newStringBuffer(4096);
+  if (cd->mResponse == NULL)
+    cd->mResponse = newStringBuffer(4096);
   rv = curl_easy_setopt(cd->mHandle, CURLOPT_FILE, cd->mResponse);
 
   // Fail if we receive an error (HTTP response code >= 300)
@@ -417,53 +419,185 @@ addPayload(CurlData * cd, char *pl, char **msg)
   return 0;
 }
 
-int
-exportIndication(char *url, char *payload, char **resp, char **msg)
-{
+/*
+ * A delivery channel keeps what is needed to reach one destination
+ * between indications: the curl handle, which holds on to the connection
+ * to the listener, or the open file of a file:// destination. Channels are
+ * not thread safe, the handler serializes their use.
+ */
+typedef struct exportChannel {
+  char           *url;
   CurlData        cd;
+  int             ready;        /* cd set up by genRequest() */
+  FILE           *out;
+  struct curl_slist *multiHeaders;      /* for MULTIEXPREQ messages */
+  int             noMulti;      /* listener rejected a MULTIEXPREQ */
+} ExportChannel;
+
+ExportChannel  *
+openExportChannel(const char *url)
+{
+  ExportChannel  *ch = calloc(1, sizeof(*ch));
+  ch->url = strdup(url);
+  return ch;
+}
+
+static void
+resetExportChannel(ExportChannel * ch)
+{
+  if (ch->ready)
+    uninit(&ch->cd);
+  ch->ready = 0;
+  if (ch->out)
+    fclose(ch->out);
+  ch->out = NULL;
+}
+
+void
+closeExportChannel(ExportChannel * ch)
+{
+  resetExportChannel(ch);
+  if (ch->multiHeaders)
+    curl_slist_free_all(ch->multiHeaders);
+  free(ch->url);
+  free(ch);
+}
+
+/* the open file of ch, reopened if it was removed or renamed meanwhile;
+ * a rename (logrotate) leaves the file linked, so the path must still
+ * lead to the file that is open */
+static FILE    *
+channelFile(ExportChannel * ch)
+{
+  struct stat     st,
+                  pst;
+
+  if (ch->out && (fstat(fileno(ch->out), &st) || st.st_nlink == 0
+                  || stat(ch->url + 7, &pst) || pst.st_dev != st.st_dev
+                  || pst.st_ino != st.st_ino)) {
+    fclose(ch->out);
+    ch->out = NULL;
+  }
+  if (ch->out == NULL)
+    ch->out = fopen(ch->url + 7, "a+");
+  return ch->out;
+}
+
+/* the headers of initializeHeaders() for a multiple export request */
+static struct curl_slist *
+getMultiHeaders(ExportChannel * ch)
+{
+  unsigned int    i;
+  int             opt;
+
+  if (ch->multiHeaders)
+    return ch->multiHeaders;
+  for (i = 0; i < NUM_HEADERS; i++)
+    if (strncmp(headers[i], "CIMExport", 9))
+      ch->multiHeaders = curl_slist_append(ch->multiHeaders, headers[i]);
+  ch->multiHeaders = curl_slist_append(ch->multiHeaders,
+                                       "CIMExport: MultipleExportRequest");
+  if (getControlBool("indicationCurlUseExpect100", &opt) || !opt)
+    ch->multiHeaders = curl_slist_append(ch->multiHeaders, "Expect: ");
+  return ch->multiHeaders;
+}
+
+static int
+exportOn(ExportChannel * ch, char *payload, char **resp, char **msg,
+         int multi)
+{
   int             rc = 0;
   FILE           *out;
 
   *msg = NULL;
   *resp = NULL;
 
-  _SFCB_ENTER(TRACE_INDPROVIDER, "exportIndication");
+  _SFCB_ENTER(TRACE_INDPROVIDER, "exportOn");
 
-  if (strncasecmp(url, "file://", 7) == 0) {
-    out = fopen(url + 7, "a+");
+  if (strncasecmp(ch->url, "file://", 7) == 0) {
+    out = channelFile(ch);
     if (out) {
       fprintf(out, "%s\n", payload);
       fprintf(out, "=========== End of Indication ===========\n");
-      fclose(out);
+      if (fflush(out)) {
+        rc = 1;
+        resetExportChannel(ch);
+      }
     } else {
       rc = 1;
       mlogf(M_ERROR, M_SHOW,
-            "Unable to open file to process indication: %s\n", url);
-      _SFCB_TRACE(1, ("--- Unable to open file: %s", url));
+            "Unable to open file to process indication: %s\n", ch->url);
+      _SFCB_TRACE(1, ("--- Unable to open file: %s", ch->url));
     }
     _SFCB_RETURN(rc);
   }
 
-  init(&cd);
-  if ((rc = genRequest(&cd, url, msg)) == 0) {
-    if ((rc = addPayload(&cd, payload, msg)) == 0) {
-      if ((rc = getResponse(&cd, msg)) == 0) {
-        *resp = strdup(cd.mResponse->ft->getCharPtr(cd.mResponse));
+  if (ch->ready == 0) {
+    init(&ch->cd);
+    ch->ready = 1;
+    rc = genRequest(&ch->cd, ch->url, msg);
+  } else {
+    ch->cd.mBody->ft->reset(ch->cd.mBody);
+    ch->cd.mResponse->ft->reset(ch->cd.mResponse);
+  }
+  if (rc == 0) {
+    curl_easy_setopt(ch->cd.mHandle, CURLOPT_HTTPHEADER,
+                     multi ? getMultiHeaders(ch) : ch->cd.mHeaders);
+    if ((rc = addPayload(&ch->cd, payload, msg)) == 0) {
+      if ((rc = getResponse(&ch->cd, msg)) == 0) {
+        *resp = strdup(ch->cd.mResponse->ft->getCharPtr(ch->cd.mResponse));
       }
     }
   }
 
-  _SFCB_TRACE(1, ("--- url: %s rc: %d %s", url, rc, *msg));
-  if (rc) {
+  _SFCB_TRACE(1, ("--- url: %s rc: %d %s", ch->url, rc, *msg));
+  if (multi && (rc == 400 || rc == 501)) {
+    mlogf(M_INFO, M_SHOW,
+          "--- %s does not take multiple export requests\n", ch->url);
+    ch->noMulti = 1;
+  } else if (rc) {
     mlogf(M_ERROR, M_SHOW,
-          "Problem processing indication to %s. sfcb rc: %d %s\n", url, rc,
-          *msg);
+          "Problem processing indication to %s. sfcb rc: %d %s\n", ch->url,
+          rc, *msg);
+    /* start over with a new handle and connection next time */
+    resetExportChannel(ch);
   }
 
-  uninit(&cd);
-
   _SFCB_RETURN(rc);
 }
+
+int
+exportIndicationOn(ExportChannel * ch, char *payload, char **resp,
+                   char **msg)
+{
+  return exportOn(ch, payload, resp, msg, 0);
+}
+
+/*
+ * sends a MULTIEXPREQ message; returns 501 without sending it if the
+ * listener rejected one before, the caller then exports the indications
+ * one by one 
+ */
+int
+exportIndicationsOn(ExportChannel * ch, char *payload, char **resp,
+                    char **msg)
+{
+  if (ch->noMulti || strncasecmp(ch->url, "file://", 7) == 0) {
+    *msg = NULL;
+    *resp = NULL;
+    return 501;
+  }
+  return exportOn(ch, payload, resp, msg, 1);
+}
+
+int
+exportIndication(char *url, char *payload, char **resp, char **msg)
+{
+  ExportChannel  *ch = openExportChannel(url);
+  int             rc = exportIndicationOn(ch, payload, resp, msg);
+  closeExportChannel(ch);
+  return rc;
+}
 /* MODELINES */
 /* DO NOT EDIT BELOW THIS COMMENT */
 /* Modelines are added by 'make pretty' */
@@ -38,14 +38,22 @@
 #include "support.h"
 
 extern void     closeProviderContext(BinRequestContext * ctx);
-extern int      exportIndication(char *url, char *payload, char **resp,
-                                 char **msg);
+struct exportChannel;
+extern struct exportChannel *openExportChannel(const char *url);
+extern void     closeExportChannel(struct exportChannel *ch);
+extern int      exportIndicationOn(struct exportChannel *ch, char *payload,
+                                   char **resp, char **msg);
+extern int      exportIndicationsOn(struct exportChannel *ch,
+                                    char *payload, char **resp,
+                                    char **msg);
 extern void     dumpSegments(void *);
 extern UtilStringBuffer *segments2stringBuffer(RespSegment * rs);
 extern UtilStringBuffer *newStringBuffer(int);
 extern void     setStatus(CMPIStatus *st, CMPIrc rc, char *msg);
 
 extern ExpSegments exportIndicationReq(CMPIInstance *ci, char *id);
+extern UtilStringBuffer *exportIndicationsReq(CMPIInstance **ci, int n,
+                                              char *id);
 
 extern void     memLinkObjectPath(CMPIObjectPath * op);
 
@@ -65,6 +73,98 @@ interOpNameSpace(const CMPIObjectPath * cop, CMPIStatus *st)
 
 int RIEnabled=-1;
 
+/*
+ * Delivery channels by destination url, so that indications to the same
+ * listener reuse its connection. A channel is used by one thread at a
+ * time; a dropped channel is closed once the last user released it.
+ */
+typedef struct destChannel {
+  struct exportChannel *ch;
+  pthread_mutex_t lock;
+  int             refs;
+  int             dropped;
+} DestChannel;
+
+static UtilHashTable *channels = NULL;
+static pthread_mutex_t channelsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static DestChannel *
+getChannel(const char *url)
+{
+  DestChannel    *dc;
+
+  pthread_mutex_lock(&channelsLock);
+  if (channels == NULL) {
+    channels = UtilFactory->newHashTable(61, UtilHashTable_charKey);
+    channels->ft->setReleaseFunctions(channels, free, NULL);
+  }
+  if ((dc = channels->ft->get(channels, url)) == NULL) {
+    dc = calloc(1, sizeof(*dc));
+    dc->ch = openExportChannel(url);
+    pthread_mutex_init(&dc->lock, NULL);
+    channels->ft->put(channels, strdup(url), dc);
+  }
+  dc->refs++;
+  pthread_mutex_unlock(&channelsLock);
+  pthread_mutex_lock(&dc->lock);
+  return dc;
+}
+
+static void
+closeChannel(DestChannel * dc)
+{
+  closeExportChannel(dc->ch);
+  pthread_mutex_destroy(&dc->lock);
+  free(dc);
+}
+
+static void
+releaseChannel(DestChannel * dc)
+{
+  pthread_mutex_unlock(&dc->lock);
+  pthread_mutex_lock(&channelsLock);
+  if (--dc->refs == 0 && dc->dropped)
+    closeChannel(dc);
+  pthread_mutex_unlock(&channelsLock);
+}
+
+static void
+dropChannel(DestChannel * dc)
+{
+  if (dc->refs)
+    dc->dropped = 1;
+  else
+    closeChannel(dc);
+}
+
+/* closes the channel of url, or all channels if url is NULL */
+static void
+dropChannels(const char *url)
+{
+  HashTableIterator *it;
+  DestChannel    *dc;
+  char           *key;
+
+  pthread_mutex_lock(&channelsLock);
+  if (channels == NULL)
+    ;
+  else if (url) {
+    if ((dc = channels->ft->get(channels, url)) != NULL) {
+      channels->ft->remove(channels, url);
+      dropChannel(dc);
+    }
+  } else {
+    for (it = channels->ft->getFirst(channels, (void **) &key,
+                                     (void **) &dc); it;
+         it = channels->ft->getNext(channels, it, (void **) &key,
+                                    (void **) &dc))
+      dropChannel(dc);
+    channels->ft->release(channels);
+    channels = NULL;
+  }
+  pthread_mutex_unlock(&channelsLock);
+}
+
 /*
  * ------------------------------------------------------------------ *
  * Instance MI Cleanup
@@ -502,13 +602,15 @@ IndCIMXMLHandlerDeleteInstance(CMPIInstanceMI * mi,
   CMPIArgs       *in,
                  *out = NULL;
   CMPIObjectPath *op;
+  CMPIInstance   *hci;
+  CMPIString     *dest;
 
   _SFCB_ENTER(TRACE_INDPROVIDER, "IndCIMXMLHandlerDeleteInstance");
 
   if (interOpNameSpace(cop, &st) == 0)
     _SFCB_RETURN(st);
 
-  internalProviderGetInstance(cop, &st);
+  hci = internalProviderGetInstance(cop, &st);
   if (st.rc)
     _SFCB_RETURN(st);
 
@@ -521,6 +623,11 @@ IndCIMXMLHandlerDeleteInstance(CMPIInstanceMI * mi,
   if (st.rc == CMPI_RC_OK) {
     st = InternalProviderDeleteInstance(NULL, ctx, rslt, cop);
   }
+  if (st.rc == CMPI_RC_OK) {
+    dest = CMGetProperty(hci, "destination", NULL).value.string;
+    if (dest)
+      dropChannels((char *) dest->hdl);
+  }
 
   _SFCB_RETURN(st);
 }
@@ -566,6 +673,7 @@ IndCIMXMLHandlerMethodCleanup(CMPIMethodMI * mi,
     pthread_join(t, NULL);
     _SFCB_TRACE(1, ("--- Indication retry thread stopped"));
   }
+  dropChannels(NULL);
   _SFCB_RETURN(st);
 }
 
@@ -575,6 +683,8 @@ IndCIMXMLHandlerMethodCleanup(CMPIMethodMI * mi,
  *  the target destination
  */
 
+static int      exportId = 1;
+
 int
 deliverInd(const CMPIObjectPath * ref, const CMPIArgs * in, CMPIInstance * ind)
 {
@@ -585,10 +695,10 @@ deliverInd(const CMPIObjectPath * ref, const CMPIArgs * in, CMPIInstance * ind)
   char            strId[64];
   ExpSegments     xs;
   UtilStringBuffer *sb;
-  static int      id = 1;
   char           *resp;
   char           *msg;
   int            rc = 0;
+  DestChannel    *dc;
 
   if ((hci = internalProviderGetInstance(ref, &st)) == NULL) {
     _SFCB_RETURN(1);
@@ -596,11 +706,13 @@ deliverInd(const CMPIObjectPath * ref, const CMPIArgs * in, CMPIInstance * ind)
   dest = CMGetProperty(hci, "destination", NULL).value.string;
   _SFCB_TRACE(1, ("--- destination: %s\n", (char *) dest->hdl));
 
-  sprintf(strId, "%d", id++);
+  sprintf(strId, "%d", exportId++);
   xs = exportIndicationReq(ind, strId);
   sb = segments2stringBuffer(xs.segments);
-  rc = exportIndication((char*)dest->hdl,
-               (char*)sb->ft->getCharPtr(sb), &resp, &msg);
+  dc = getChannel((char *) dest->hdl);
+  rc = exportIndicationOn(dc->ch, (char *) sb->ft->getCharPtr(sb), &resp,
+                          &msg);
+  releaseChannel(dc);
   RespSegment     rs = xs.segments[5];
   UtilStringBuffer *usb = (UtilStringBuffer *) rs.txt;
   CMRelease(usb);
@@ -612,6 +724,59 @@ deliverInd(const CMPIObjectPath * ref, const CMPIArgs * in, CMPIInstance * ind)
   _SFCB_RETURN(rc);
 }
 
+/** \brief deliverInds - Sends several indications to the destination
+ *
+ *  Sends the indications as one multiple export request, or one by one
+ *  if the destination does not take those
+ */
+
+static int
+deliverInds(const CMPIObjectPath * ref, CMPIArray * inds)
+{
+  _SFCB_ENTER(TRACE_INDPROVIDER, "deliverInds");
+  CMPIInstance   *hci;
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  CMPIString     *dest;
+  CMPIInstance  **ci;
+  char            strId[64];
+  UtilStringBuffer *sb;
+  DestChannel    *dc;
+  char           *resp;
+  char           *msg;
+  int             i,
+                  n = CMGetArrayCount(inds, NULL),
+      rc = 0;
+
+  if ((hci = internalProviderGetInstance(ref, &st)) == NULL) {
+    _SFCB_RETURN(1);
+  }
+  dest = CMGetProperty(hci, "destination", NULL).value.string;
+  _SFCB_TRACE(1, ("--- destination: %s, %d indications\n",
+                  (char *) dest->hdl, n));
+
+  ci = malloc(sizeof(*ci) * n);
+  for (i = 0; i < n; i++)
+    ci[i] = CMGetArrayElementAt(inds, i, NULL).value.inst;
+  sprintf(strId, "%d", exportId++);
+  sb = exportIndicationsReq(ci, n, strId);
+  dc = getChannel((char *) dest->hdl);
+  rc = exportIndicationsOn(dc->ch, (char *) sb->ft->getCharPtr(sb), &resp,
+                           &msg);
+  releaseChannel(dc);
+  CMRelease(sb);
+  if (resp)
+    free(resp);
+  if (msg)
+    free(msg);
+
+  if (rc == 400 || rc == 501)
+    for (i = 0, rc = 0; i < n; i++)
+      if (deliverInd(ref, NULL, ci[i]))
+        rc = 1;
+  free(ci);
+  _SFCB_RETURN(rc);
+}
+
 // Retry queue element and control vars
 typedef struct rtelement {
   CMPIObjectPath * ref; // LD
@@ -904,6 +1069,31 @@ IndCIMXMLHandlerInvokeMethod(CMPIMethodMI * mi,
     }
 #endif
 
+    /* several indications of one subscription, see interopProvider.c */
+    CMPIArray *inds=CMGetArg(in,"indications",NULL).value.array;
+    if (inds) {
+      int i;
+      if (RIEnabled == 0) {
+        if (deliverInds(ref, inds))
+          st.rc = CMPI_RC_ERR_FAILED;
+        _SFCB_RETURN(st);
+      }
+      // each indication needs its own sequence number and retry
+      CMPIStatus ist;
+      for (i = 0; i < CMGetArrayCount(inds, NULL); i++) {
+        CMPIInstance *ii=CMGetArrayElementAt(inds,i,NULL).value.inst;
+        CMPIInstance *sub=CMGetArg(in,"subscription",NULL).value.inst;
+        CMPIArgs *iin=CMNewArgs(_broker,NULL);
+        CMAddArg(iin,"indication",&ii,CMPI_instance);
+        CMAddArg(iin,"subscription",&sub,CMPI_instance);
+        CMAddArg(iin,"nameSpace",CMGetArg(in,"nameSpace",NULL).value.string->hdl,CMPI_chars);
+        ist=IndCIMXMLHandlerInvokeMethod(mi,ctx,rslt,ref,methodName,iin,out);
+        if (ist.rc != CMPI_RC_OK)
+          st=ist;
+      }
+      _SFCB_RETURN(st);
+    }
+
     CMPIInstance *indo=CMGetArg(in,"indication",NULL).value.inst;
     CMPIInstance *ind=CMClone(indo,NULL);
     CMPIContext    *ctxLocal=NULL;
@@ -1010,6 +1200,9 @@ IndCIMXMLHandlerInvokeMethod(CMPIMethodMI * mi,
         CMRelease(ctxLocal);
     }
     CMRelease(ind);
+    // tell the interop provider, it counts failed deliveries
+    if (drc)
+      st.rc = CMPI_RC_ERR_FAILED;
   }
   else {
     printf("--- ClassProvider: Invalid request %s\n", methodName);
@@ -51,6 +51,9 @@ extern const char *ClInstanceGetClassName(ClInstance * inst);
 extern const char *ClInstanceGetNameSpace(ClInstance * inst);
 extern unsigned long ClSizeInstance(ClInstance * inst);
 extern ClInstance *ClInstanceRebuild(ClInstance * inst, void *area);
+extern unsigned long ClSizeInstanceExternal(ClInstance * inst);
+extern ClInstance *ClInstanceRebuildExternal(ClInstance * inst,
+                                             void *area);
 extern void     ClInstanceRelocateInstance(ClInstance * inst);
 extern CMPIArray *native_make_CMPIArray(CMPIData *av, CMPIStatus *rc,
                                         ClObjectHdr * hdr);
@@ -936,8 +939,25 @@ NATIVE_FT_VERSION,
 
 CMPIInstanceFT *CMPI_Instance_FT = &ift;
 
+/*
+ * the serialized instance may end up outside the sfcb processes sharing
+ * the intern table (repository, local clients, embedded objects), so
+ * interned property names are copied into the serialized instance; ci
+ * itself is left alone 
+ */
 unsigned long
 getInstanceSerializedSize(const CMPIInstance *ci)
+{
+  ClInstance     *cli = (ClInstance *) ci->hdl;
+  return ClSizeInstanceExternal(cli) + sizeof(struct native_instance);
+}
+
+/*
+ * size for an instance that is only read by sfcb processes sharing the
+ * intern table 
+ */
+unsigned long
+getInstanceSerializedSizeShared(const CMPIInstance *ci)
 {
   ClInstance     *cli = (ClInstance *) ci->hdl;
   return ClSizeInstance(cli) + sizeof(struct native_instance);
@@ -945,6 +965,21 @@ getInstanceSerializedSize(const CMPIInstance *ci)
 
 void
 getSerializedInstance(const CMPIInstance *ci, void *area)
+{
+  memcpy(area, ci, sizeof(struct native_instance));
+  ClInstanceRebuildExternal((ClInstance *) ci->hdl,
+                            (void *) ((char *) area +
+                                      sizeof(struct native_instance)));
+  ((CMPIInstance *) (area))->hdl =
+      (ClInstance *) ((char *) area + sizeof(struct native_instance));
+}
+
+/*
+ * serialized instance keeping its interned names, sized with
+ * getInstanceSerializedSizeShared() 
+ */
+void
+getSerializedInstanceShared(const CMPIInstance *ci, void *area)
 {
   memcpy(area, ci, sizeof(struct native_instance));
   ClInstanceRebuild((ClInstance *) ci->hdl,
@@ -36,6 +36,7 @@
 #include "native.h"
 #include "objectpath.h"
 #include "sfcbmacs.h"
+#include "mlog.h"
 
 #define LOCALCLASSNAME "InternalProvider"
 
@@ -52,6 +53,10 @@ extern void     setStatus(CMPIStatus *st, CMPIrc rc, const char *msg);
 
 static const CMPIBroker *_broker;
 
+static void     updateRefIndex(const char *ns, const char *cls,
+                               const char *key, const CMPIInstance *oldCi,
+                               const CMPIInstance *newCi);
+
 static CMPIInstance *
 instifyBlob(void *blob)
 {
@@ -78,6 +83,8 @@ static CMPIInstance *
 ipGetFirst(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
 {
   void           *blob = getFirst(bi, len, keyb, keybl);
+  if (blob && bi->map)
+    return relocateSerializedInstance(blob);
   return instifyBlob(blob);
 }
 
@@ -85,9 +92,26 @@ static CMPIInstance *
 ipGetNext(BlobIndex * bi, int *len, char **keyb, size_t * keybl)
 {
   void           *blob = getNext(bi, len, keyb, keybl);
+  if (blob && bi->map)
+    return relocateSerializedInstance(blob);
   return instifyBlob(blob);
 }
 
+/*
+ * keeps a mapped data file alive until the thread's tracked memory is
+ * released, instances handed out may be referenced until then 
+ */
+static CMPIStatus
+releaseBlobMapObj(void *obj)
+{
+  Object         *o = (Object *) obj;
+  releaseBlobMap(o->hdl);
+  free(o);
+  CMReturn(CMPI_RC_OK);
+}
+
+static ObjectFT blobMapObjFt = { 1, releaseBlobMapObj };
+
 static char   **nsTab = NULL;
 static int      nsTabLen = 0;
 
@@ -126,9 +150,17 @@ static BlobIndex *
 _getIndex(const char *ns, const char *cn)
 {
   BlobIndex      *bi;
-  if (getIndex(ns, cn, strlen(ns) + strlen(cn) + 64, 0, &bi))
+  Object          o = { NULL, &blobMapObjFt };
+  int             state;
+
+  if (getIndex(ns, cn, strlen(ns) + strlen(cn) + 64, 0, &bi)) {
+    /* enumerate from the mapped data file instead of copies */
+    if (mapBlobIndex(bi) == 0) {
+      o.hdl = holdBlobMap(bi);
+      memAddEncObj(MEM_TRACKED, &o, sizeof(o), &state);
+    }
     return bi;
-  else
+  } else
     return NULL;
 }
 
@@ -446,6 +478,9 @@ InternalProviderCreateInstance(CMPIInstanceMI __attribute__ ((unused)) *mi,
   }
   free(blob);
 
+  if (cc != NULL && cc->ft->isAssociation(cc))
+    updateRefIndex(nss, cns, key, NULL, ci);
+
   if (rslt) {
     CMReturnObjectPath(rslt, cop);
   }
@@ -470,6 +505,9 @@ InternalProviderModifyInstance(CMPIInstanceMI __attribute__ ((unused)) *mi,
   char           *key = normalizeObjectPathCharsDup(cop);
   const char     *nss = ns->ft->getCharPtr(ns, NULL);
   const char     *cns = cn->ft->getCharPtr(cn, NULL);
+  CMPIConstClass *cc;
+  CMPIInstance   *old = NULL;
+  int             l;
 
   _SFCB_ENTER(TRACE_INTERNALPROVIDER, "InternalProviderSetInstance");
 
@@ -488,11 +526,19 @@ InternalProviderModifyInstance(CMPIInstanceMI __attribute__ ((unused)) *mi,
     ci->ft->setPropertyFilter((CMPIInstance *) ci, properties, NULL);
   }
 
+  cc = getConstClass(nss, cns);
+  if (cc != NULL && cc->ft->isAssociation(cc))
+    old = ipGetBlob(nss, cns, key, &l);
+
   len = getInstanceSerializedSize(ci);
   blob = malloc(len + 64);
   getSerializedInstance(ci, blob);
   addBlob(nss, cns, key, blob, (int) len);
   free(blob);
+
+  /* the stored instance, ci may be filtered */
+  if (old)
+    updateRefIndex(nss, cns, key, old, ipGetBlob(nss, cns, key, &l));
   free(key);
   _SFCB_RETURN(st);
 }
@@ -509,6 +555,9 @@ InternalProviderDeleteInstance(CMPIInstanceMI __attribute__ ((unused)) *mi,
   char           *key = normalizeObjectPathCharsDup(cop);
   const char     *nss = ns->ft->getCharPtr(ns, NULL);
   const char     *cns = cn->ft->getCharPtr(cn, NULL);
+  CMPIConstClass *cc;
+  CMPIInstance   *old = NULL;
+  int             l;
 
   _SFCB_ENTER(TRACE_INTERNALPROVIDER, "InternalProviderDeleteInstance");
 
@@ -523,8 +572,14 @@ InternalProviderDeleteInstance(CMPIInstanceMI __attribute__ ((unused)) *mi,
     _SFCB_RETURN(st);
   }
 
+  cc = getConstClass(nss, cns);
+  if (cc != NULL && cc->ft->isAssociation(cc))
+    old = ipGetBlob(nss, cns, key, &l);
+
   deleteBlob(nss, cns, key);
 
+  if (old)
+    updateRefIndex(nss, cns, key, old, NULL);
   free(key);
   _SFCB_RETURN(st);
 }
@@ -572,16 +627,353 @@ objectPathEquals(UtilStringBuffer * pn, CMPIObjectPath * op,
                  UtilStringBuffer ** retName, int eq)
 {
   int             rc = 0;
-  UtilStringBuffer *opn = normalizeObjectPathStrBuf(op);
-  if (strcmp(pn->ft->getCharPtr(pn), opn->ft->getCharPtr(opn)) == 0)
+  if (strcmp(pn->ft->getCharPtr(pn), objectpathKey(op)) == 0)
     rc = 1;
   if (retName && rc == eq)
-    *retName = opn;
-  else
-    opn->ft->release(opn);
+    *retName = normalizeObjectPathStrBuf(op);
   return rc;
 }
 
+/*
+ * Reference index
+ *
+ * For every object path referenced by association instances of a name
+ * space the repository holds a REFINDEX blob, keyed by the normalized
+ * path, listing class name and key of each of these instances as pairs of
+ * strings. getRefs() reads the instances named there instead of scanning
+ * all association instances. The index of a name space is built by the
+ * first getRefs() call that needs it; the REFINDEX_BUILT entry marks it as
+ * complete, before that creates and deletes do not maintain it.
+ *
+ * Every provider process hosting the internal provider updates the index,
+ * so the read-modify-write cycles on it run under the repository lock of
+ * the name space, see lockNameSpace().
+ */
+
+#define REFINDEX "assocrefs"
+#define REFINDEX_BUILT "$built$"
+
+typedef struct refList {
+  char           *data;
+  int             len,
+                  max;
+} RefList;
+
+static void
+addRefEntry(RefList * l, const char *cls, const char *key)
+{
+  int             cl = strlen(cls) + 1,
+      kl = strlen(key) + 1;
+
+  if (l->len + cl + kl > l->max) {
+    l->max = (l->len + cl + kl) * 2;
+    l->data = realloc(l->data, l->max);
+  }
+  memcpy(l->data + l->len, cls, cl);
+  memcpy(l->data + l->len + cl, key, kl);
+  l->len += cl + kl;
+}
+
+/* removes the entry for cls and key from an index blob, returns its length */
+static int
+removeRefEntry(char *blob, int len, const char *cls, const char *key)
+{
+  char           *c,
+                 *k;
+  int             l;
+
+  for (c = blob; c < blob + len; c = k + strlen(k) + 1) {
+    k = c + strlen(c) + 1;
+    if (strcasecmp(c, cls) == 0 && strcmp(k, key) == 0) {
+      l = k + strlen(k) + 1 - c;
+      memmove(c, c + l, blob + len - c - l);
+      return len - l;
+    }
+  }
+  return len;
+}
+
+/* the distinct normalized object paths referenced by ci */
+static char   **
+instanceRefs(const CMPIInstance *ci, int *n)
+{
+  char          **refs;
+  char           *r;
+  int             i,
+                  j,
+                  m = CMGetPropertyCount(ci, NULL);
+
+  refs = malloc(sizeof(char *) * (m + 1));
+  for (*n = i = 0; i < m; i++) {
+    CMPIData        data = CMGetPropertyAt(ci, i, NULL, NULL);
+    if (data.type != CMPI_ref || (data.state & CMPI_nullValue)
+        || data.value.ref == NULL)
+      continue;
+    r = normalizeObjectPathCharsDup(data.value.ref);
+    for (j = 0; j < *n && strcmp(refs[j], r); j++);
+    if (j < *n)
+      free(r);
+    else
+      refs[(*n)++] = r;
+  }
+  return refs;
+}
+
+static void
+freeRefs(char **refs, int n)
+{
+  while (n)
+    free(refs[--n]);
+  free(refs);
+}
+
+/*
+ * moves the association instance cls/key from the index entries of the
+ * paths referenced by oldCi to those referenced by newCi, either may be
+ * NULL
+ */
+static void
+updateRefIndex(const char *ns, const char *cls, const char *key,
+               const CMPIInstance *oldCi, const CMPIInstance *newCi)
+{
+  char          **oldRefs = NULL,
+      **newRefs = NULL,
+      **ids;
+  void          **blobs;
+  int            *lens;
+  int             no = 0,
+      nn = 0,
+      n = 0,
+      i,
+      j,
+      len;
+  RefList         l;
+
+  _SFCB_ENTER(TRACE_INTERNALPROVIDER, "updateRefIndex");
+
+  if (lockNameSpace(ns))
+    _SFCB_EXIT();
+  if (existingBlob(ns, REFINDEX, REFINDEX_BUILT) == 0) {
+    unlockNameSpace(ns);
+    _SFCB_EXIT();
+  }
+
+  if (oldCi)
+    oldRefs = instanceRefs(oldCi, &no);
+  if (newCi)
+    newRefs = instanceRefs(newCi, &nn);
+  ids = malloc(sizeof(char *) * (no + nn + 1));
+  blobs = malloc(sizeof(void *) * (no + nn + 1));
+  lens = malloc(sizeof(int) * (no + nn + 1));
+
+  for (i = 0; i < no; i++) {
+    for (j = 0; j < nn && strcmp(oldRefs[i], newRefs[j]); j++);
+    if (j < nn)
+      continue;
+    if ((blobs[n] = getBlob(ns, REFINDEX, oldRefs[i], &len)) == NULL)
+      continue;
+    lens[n] = removeRefEntry(blobs[n], len, cls, key);
+    ids[n++] = oldRefs[i];
+  }
+  for (j = 0; j < nn; j++) {
+    for (i = 0; i < no && strcmp(oldRefs[i], newRefs[j]); i++);
+    if (i < no)
+      continue;
+    /*
+     * a buildRefIndex() run between storing the instance and getting the
+     * lock may have indexed it already 
+     */
+    l.data = getBlob(ns, REFINDEX, newRefs[j], &l.len);
+    if (l.data == NULL)
+      l.len = 0;
+    else
+      l.len = removeRefEntry(l.data, l.len, cls, key);
+    l.max = l.len;
+    addRefEntry(&l, cls, key);
+    blobs[n] = l.data;
+    lens[n] = l.len;
+    ids[n++] = newRefs[j];
+  }
+
+  _SFCB_TRACE(1, ("--- %d reference index entries for %s", n, key));
+  if (n && addBlobs(ns, REFINDEX, n, ids, blobs, lens))
+    mlogf(M_ERROR, M_SHOW, "--- reference index of %s not updated for %s\n",
+          ns, key);
+  unlockNameSpace(ns);
+
+  while (n)
+    free(blobs[--n]);
+  free(blobs);
+  free(lens);
+  free(ids);
+  if (oldRefs)
+    freeRefs(oldRefs, no);
+  if (newRefs)
+    freeRefs(newRefs, nn);
+  _SFCB_EXIT();
+}
+
+/* index the instances of all association classes, name space locked */
+static int
+buildRefIndex(const CMPIContext *ctx, const char *ns)
+{
+  UtilHashTable  *ht;
+  HashTableIterator *it;
+  BlobIndex      *bi;
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  CMPIObjectPath *op;
+  CMPIArgs       *in,
+                 *out;
+  CMPIArray      *ar;
+  CMPIInstance   *ci;
+  RefList        *l;
+  char          **refs,
+      **ids;
+  void          **blobs;
+  int            *lens;
+  char           *name,
+                 *kp,
+                 *key;
+  size_t          ekl;
+  int             i,
+                  j,
+                  m,
+                  n,
+                  len,
+                  rc;
+
+  _SFCB_ENTER(TRACE_INTERNALPROVIDER, "buildRefIndex");
+
+  op = CMNewObjectPath(Broker, ns, "$ClassProvider$", &st);
+  in = CMNewArgs(Broker, NULL);
+  out = CMNewArgs(Broker, NULL);
+  CBInvokeMethod(Broker, ctx, op, "getassocs", in, out, &st);
+  if (st.rc != CMPI_RC_OK
+      || (ar = CMGetArg(out, "assocs", NULL).value.array) == NULL)
+    _SFCB_RETURN(-1);
+
+  ht = UtilFactory->newHashTable(65521, UtilHashTable_charKey);
+  for (i = 0, m = CMGetArrayCount(ar, NULL); i < m; i++) {
+    name = CMGetArrayElementAt(ar, i, NULL).value.string->hdl;
+    if (name == NULL || (bi = _getIndex(ns, name)) == NULL)
+      continue;
+    for (ci = ipGetFirst(bi, &len, &kp, &ekl); ci;
+         ci = ipGetNext(bi, &len, &kp, &ekl)) {
+      key = strndup(kp, ekl);
+      refs = instanceRefs(ci, &n);
+      for (j = 0; j < n; j++) {
+        if ((l = ht->ft->get(ht, refs[j])) == NULL) {
+          l = calloc(1, sizeof(*l));
+          ht->ft->put(ht, refs[j], l);
+        } else
+          free(refs[j]);
+        addRefEntry(l, name, key);
+      }
+      free(refs);
+      free(key);
+    }
+    freeBlobIndex(&bi, 1);
+  }
+
+  n = ht->ft->size(ht);
+  ids = malloc(sizeof(char *) * (n + 1));
+  blobs = malloc(sizeof(void *) * (n + 1));
+  lens = malloc(sizeof(int) * (n + 1));
+  for (n = 0, it = ht->ft->getFirst(ht, (void **) &key, (void **) &l); it;
+       it = ht->ft->getNext(ht, it, (void **) &key, (void **) &l), n++) {
+    ids[n] = key;
+    blobs[n] = l->data;
+    lens[n] = l->len;
+  }
+  ids[n] = REFINDEX_BUILT;
+  blobs[n] = REFINDEX_BUILT;
+  lens[n] = sizeof(REFINDEX_BUILT);
+  rc = addBlobs(ns, REFINDEX, n + 1, ids, blobs, lens);
+  _SFCB_TRACE(1, ("--- %d paths in reference index of %s rc %d", n, ns, rc));
+
+  for (it = ht->ft->getFirst(ht, (void **) &key, (void **) &l); it;
+       it = ht->ft->getNext(ht, it, (void **) &key, (void **) &l)) {
+    free(key);
+    free(l->data);
+    free(l);
+  }
+  ht->ft->release(ht);
+  free(ids);
+  free(blobs);
+  free(lens);
+  _SFCB_RETURN(rc);
+}
+
+/*
+ * appends the association instances referencing cop to refs, if the
+ * reference index is available; only instances of assocClass and its
+ * subclasses if assocClass is set
+ */
+static int
+refIndexLookup(const CMPIContext *ctx, UtilList * refs, const char *ns,
+               const CMPIObjectPath * cop, const char *assocClass,
+               const char **propertyList)
+{
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  CMPIArray      *ar = NULL;
+  CMPIInstance   *ci;
+  char           *pn = normalizeObjectPathCharsDup(cop);
+  char           *blob,
+                 *c,
+                 *k;
+  int             i,
+                  m,
+                  len;
+
+  _SFCB_ENTER(TRACE_INTERNALPROVIDER, "refIndexLookup");
+
+  if (lockNameSpace(ns)) {
+    free(pn);
+    _SFCB_RETURN(0);
+  }
+  if (existingBlob(ns, REFINDEX, REFINDEX_BUILT) == 0
+      && buildRefIndex(ctx, ns)) {
+    unlockNameSpace(ns);
+    free(pn);
+    _SFCB_RETURN(0);
+  }
+  blob = getBlob(ns, REFINDEX, pn, &len);
+  unlockNameSpace(ns);
+  free(pn);
+
+  if (blob == NULL)
+    _SFCB_RETURN(1);
+
+  if (assocClass) {
+    CMPIObjectPath *op =
+        CMNewObjectPath(Broker, ns, "$ClassProvider$", &st);
+    CMPIArgs       *in = CMNewArgs(Broker, NULL);
+    CMPIArgs       *out = CMNewArgs(Broker, NULL);
+    CMAddArg(in, "classignoreprov", assocClass, CMPI_chars);
+    CBInvokeMethod(Broker, ctx, op, "getallchildren", in, out, &st);
+    ar = CMGetArg(out, "children", NULL).value.array;
+  }
+
+  for (c = blob; c < blob + len; c = k + strlen(k) + 1) {
+    k = c + strlen(c) + 1;
+    if (assocClass && strcasecmp(c, assocClass)) {
+      for (i = 0, m = ar ? CMGetArrayCount(ar, NULL) : 0; i < m; i++)
+        if (strcasecmp(c, (char *) CMGetArrayElementAt(ar, i, NULL).
+                       value.string->hdl) == 0)
+          break;
+      if (i == m)
+        continue;
+    }
+    if ((ci = ipGetBlob(ns, c, k, &i)) == NULL)
+      continue;
+    if (propertyList)
+      ci->ft->setPropertyFilter(ci, propertyList, NULL);
+    refs->ft->append(refs, ci);
+  }
+  free(blob);
+  _SFCB_RETURN(1);
+}
+
 CMPIStatus
 getRefs(const CMPIContext *ctx, const CMPIResult *rslt,
         const CMPIObjectPath * cop,
@@ -606,12 +998,14 @@ getRefs(const CMPIContext *ctx, const CMPIResult *rslt,
       refs->ft->release(refs);
       _SFCB_RETURN(st);
     }
-    path = CMNewObjectPath(_broker, ns, assocClass, NULL);
-    SafeInternalProviderAddEnumInstances(refs, NULL, ctx, path,
-                                         propertyList, &st, 1);
+    if (refIndexLookup(ctx, refs, ns, cop, assocClass, propertyList) == 0) {
+      path = CMNewObjectPath(_broker, ns, assocClass, NULL);
+      SafeInternalProviderAddEnumInstances(refs, NULL, ctx, path,
+                                           propertyList, &st, 1);
+    }
   }
 
-  else {
+  else if (refIndexLookup(ctx, refs, ns, cop, NULL, propertyList) == 0) {
     CMPIObjectPath *op =
         CMNewObjectPath(Broker, ns, "$ClassProvider$", &st);
     CMPIArgs       *in = CMNewArgs(Broker, NULL);
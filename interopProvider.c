@@ -40,6 +40,7 @@
 #include <time.h>
 #include "instance.h"
 #include "control.h"
+#include "latencyStats.h"
 
 #define LOCALCLASSNAME "InteropProvider"
 
@@ -70,10 +71,13 @@ static const CMPIBroker *_broker;
 static int      firstTime = 1;
 int RIEnabled=0;
 
+struct subscription;
+
 typedef struct filter {
   CMPIInstance   *fci;
   QLStatement    *qs;
   int             useCount;
+  struct subscription *subs;    /* subscriptions using this filter */
   char           *query;
   char           *lang;
   char           *type;
@@ -91,6 +95,8 @@ typedef struct subscription {
   CMPIInstance   *sci;
   Filter         *fi;
   Handler        *ha;
+  char           *key;          /* owned by subscriptionHt */
+  struct subscription *nextForFilter;
 } Subscription;
 
 static UtilHashTable *filterHt = NULL;
@@ -102,19 +108,64 @@ static pthread_mutex_t filterHTlock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t handlerHTlock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t subHTlock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t subDelLock = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Protects the filters' subscription lists and the subscription instances,
+ * _deliver only reads them. Taken after subHTlock.
+ */
+static pthread_rwlock_t subRouteLock = PTHREAD_RWLOCK_INITIALIZER;
 
-/* for indication delivery */
+/*
+ * Indication delivery
+ *
+ * Indications are queued per listener destination and delivered by a
+ * fixed pool of indicationDeliveryThreadLimit worker threads. A queue is
+ * served by one worker at a time, so a destination receives indications
+ * in the order they were queued while other destinations are served in
+ * parallel. A queue holds at most indicationDeliveryQueueDepth
+ * indications, indicationDeliveryOverflow tells what happens to one more:
+ * "block" waits up to indicationDeliveryThreadTimeout seconds (0 is
+ * forever) for room and then drops it, "dropnew" drops it right away and
+ * "dropold" drops the oldest queued one instead. Up to
+ * indicationDeliveryBatchSize consecutive indications of a subscription
+ * are handed to the handler at once.
+ */
 static long MAX_IND_THREADS;
 static long IND_THREAD_TO;
-static sem_t availThreadsSem;
-struct timespec availThreadWait;
+static long IND_QUEUE_DEPTH;
+static long IND_BATCH_SIZE;
+
+#define OVERFLOW_BLOCK 0
+#define OVERFLOW_DROPNEW 1
+#define OVERFLOW_DROPOLD 2
+static int      indOverflow;
+
+static void     initDelivery();
 
 typedef struct delivery_info {
   const CMPIContext* ctx;
   CMPIObjectPath *hop;  
   CMPIArgs* hin;
+  char           *subKey;       /* subscription the indication is for */
+  struct delivery_info *next;
 } DeliveryInfo;
 
+typedef struct delivery_queue {
+  DeliveryInfo   *first,
+                 *last;
+  long            depth;
+  int             busy;         /* a worker delivers from this queue */
+  int             ready;        /* on the ready list */
+  struct delivery_queue *nextReady;
+} DeliveryQueue;
+
+static UtilHashTable *deliveryQueues = NULL;
+static DeliveryQueue *readyFirst = NULL,
+    *readyLast = NULL;
+static int      deliveryWorkers = 0;
+static pthread_mutex_t deliveryLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t deliveryWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t deliveryRoom = PTHREAD_COND_INITIALIZER;
+
 
 /*
  * ------------------------------------------------------------------------- 
@@ -183,8 +234,14 @@ addSubscription(const CMPIInstance *ci,
   fi->useCount++;
   su->ha = ha;
   ha->useCount++;
+  su->key = (char *) key;
   subscriptionHt->ft->put(subscriptionHt, key, su);
 
+  pthread_rwlock_wrlock(&subRouteLock);
+  su->nextForFilter = fi->subs;
+  fi->subs = su;
+  pthread_rwlock_unlock(&subRouteLock);
+
   pthread_mutex_unlock(&subHTlock);
   _SFCB_RETURN(su);
 }
@@ -216,7 +273,17 @@ removeSubscription(Subscription * su, char *key)
 {
   _SFCB_ENTER(TRACE_INDPROVIDER, "removeSubscription");
 
+  Subscription  **sp;
+
   pthread_mutex_lock(&subHTlock);
+  pthread_rwlock_wrlock(&subRouteLock);
+  if (su && su->fi) {
+    for (sp = &su->fi->subs; *sp; sp = &(*sp)->nextForFilter)
+      if (*sp == su) {
+        *sp = su->nextForFilter;
+        break;
+      }
+  }
   if (subscriptionHt) {
     subscriptionHt->ft->remove(subscriptionHt, key);
     if (su) {
@@ -233,6 +300,7 @@ removeSubscription(Subscription * su, char *key)
     free(su);
   }
 
+  pthread_rwlock_unlock(&subRouteLock);
   pthread_mutex_unlock(&subHTlock);
   _SFCB_EXIT();
 }
@@ -270,6 +338,7 @@ addFilter(const CMPIInstance *ci,
   fi = malloc(sizeof(*fi));
   fi->fci = CMClone(ci, NULL);
   fi->useCount = 0;
+  fi->subs = NULL;
   fi->qs = qs;
   fi->query = strdup(query);
   fi->lang = strdup(lang);
@@ -923,9 +992,7 @@ initInterOp(const CMPIBroker * broker, const CMPIContext *ctx)
   }
   CMRelease(ctxLocal);
 
-  getControlNum("indicationDeliveryThreadLimit",&MAX_IND_THREADS);
-  getControlNum("indicationDeliveryThreadTimeout",&IND_THREAD_TO);
-  sem_init(&availThreadsSem, 0, MAX_IND_THREADS);
+  initDelivery();
 
   _SFCB_EXIT();
 }
@@ -1365,8 +1432,10 @@ InteropProviderModifyInstance(CMPIInstanceMI * mi,
     /*
      * replace the instance in the hashtable
      */
+    pthread_rwlock_wrlock(&subRouteLock);
     CMRelease(su->sci);
     su->sci = CMClone(ci, NULL);
+    pthread_rwlock_unlock(&subRouteLock);
     pthread_mutex_unlock(&subHTlock);
 
   } else if (isa("root/interop", cns, "cim_listenerdestination")) {
@@ -1511,20 +1580,223 @@ static CMPIStatus okCleanup(InteropProvider,Method);
  */
 
 
-void * sendIndForDelivery(void *di) {
+static void
+freeDeliveryInfo(DeliveryInfo * di)
+{
+  CMRelease((CMPIContext*)di->ctx);
+  CMRelease(di->hop);
+  CMRelease(di->hin);
+  free(di->subKey);
+  free(di);
+}
+
+/* called with deliveryLock held */
+static void
+readyQueue(DeliveryQueue * q)
+{
+  if (q->ready || q->busy || q->first == NULL)
+    return;
+  q->ready = 1;
+  q->nextReady = NULL;
+  if (readyLast)
+    readyLast->nextReady = q;
+  else
+    readyFirst = q;
+  readyLast = q;
+  pthread_cond_signal(&deliveryWork);
+}
+
+/* hands the n indications starting at di to the handler; returns 0 if it
+ * delivered them */
+static int
+sendIndForDelivery(DeliveryInfo * di, int n)
+{
+  CMPIArgs       *hin = di->hin;
+  CMPIArray      *ar;
+  CMPIInstance   *ind;
+  CMPIInstance   *sub;
+  DeliveryInfo   *d;
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  void           *hc = markHeap();
+  int             i;
 
   _SFCB_ENTER(TRACE_INDPROVIDER, "sendIndForDelivery");
 
-  DeliveryInfo* delInfo;
-  delInfo = (DeliveryInfo*)di;
-  CBInvokeMethod(_broker,delInfo->ctx,delInfo->hop,"_deliver",delInfo->hin,NULL,NULL);
-  sleep(5);
-  CMRelease((CMPIContext*)delInfo->ctx);
-  CMRelease(delInfo->hop);
-  CMRelease(delInfo->hin);
-  free(di);
-  sem_post(&availThreadsSem);
-  pthread_exit(NULL);
+  if (n > 1) {
+    ar = CMNewArray(_broker, n, CMPI_instance, NULL);
+    for (i = 0, d = di; i < n; i++, d = d->next) {
+      ind = CMGetArg(d->hin, "indication", NULL).value.inst;
+      CMSetArrayElementAt(ar, i, &ind, CMPI_instance);
+    }
+    sub = CMGetArg(di->hin, "subscription", NULL).value.inst;
+    hin = CMNewArgs(_broker, NULL);
+    CMAddArg(hin, "indications", &ar, CMPI_instanceA);
+    CMAddArg(hin, "subscription", &sub, CMPI_instance);
+    CMAddArg(hin, "nameSpace",
+             CMGetArg(di->hin, "nameSpace", NULL).value.string->hdl,
+             CMPI_chars);
+  }
+  CBInvokeMethod(_broker,di->ctx,di->hop,"_deliver",hin,NULL,&st);
+  releaseHeap(hc);
+
+  while (n--) {
+    d = di->next;
+    freeDeliveryInfo(di);
+    di = d;
+  }
+  _SFCB_RETURN(st.rc != CMPI_RC_OK);
+}
+
+static void    *
+deliveryWorker(void *arg)
+{
+  DeliveryQueue  *q;
+  DeliveryInfo   *di,
+                 *last;
+  int             n;
+
+  pthread_mutex_lock(&deliveryLock);
+  for (;;) {
+    while (readyFirst == NULL)
+      pthread_cond_wait(&deliveryWork, &deliveryLock);
+    q = readyFirst;
+    if ((readyFirst = q->nextReady) == NULL)
+      readyLast = NULL;
+    q->ready = 0;
+    q->busy = 1;
+
+    di = last = q->first;
+    for (n = 1; n < IND_BATCH_SIZE && last->next
+         && strcmp(last->next->subKey, di->subKey) == 0; n++)
+      last = last->next;
+    if ((q->first = last->next) == NULL)
+      q->last = NULL;
+    last->next = NULL;
+    q->depth -= n;
+    pthread_cond_broadcast(&deliveryRoom);
+    pthread_mutex_unlock(&deliveryLock);
+
+    /* a batch is delivered or fails as a whole */
+    countIndications(sendIndForDelivery(di, n) ? IND_COUNT_FAILED :
+                     IND_COUNT_DELIVERED, n);
+
+    pthread_mutex_lock(&deliveryLock);
+    q->busy = 0;
+    readyQueue(q);
+  }
+  return NULL;
+}
+
+static void
+initDelivery()
+{
+  char           *ov;
+
+  if (getControlNum("indicationDeliveryThreadLimit", &MAX_IND_THREADS)
+      || MAX_IND_THREADS < 1)
+    MAX_IND_THREADS = 1;
+  if (getControlNum("indicationDeliveryThreadTimeout", &IND_THREAD_TO))
+    IND_THREAD_TO = 0;
+  if (getControlNum("indicationDeliveryQueueDepth", &IND_QUEUE_DEPTH)
+      || IND_QUEUE_DEPTH < 1)
+    IND_QUEUE_DEPTH = 1;
+  if (getControlNum("indicationDeliveryBatchSize", &IND_BATCH_SIZE)
+      || IND_BATCH_SIZE < 1)
+    IND_BATCH_SIZE = 1;
+  indOverflow = OVERFLOW_BLOCK;
+  if (getControlChars("indicationDeliveryOverflow", &ov) == 0) {
+    if (strcasecmp(ov, "dropnew") == 0)
+      indOverflow = OVERFLOW_DROPNEW;
+    else if (strcasecmp(ov, "dropold") == 0)
+      indOverflow = OVERFLOW_DROPOLD;
+    else if (strcasecmp(ov, "block"))
+      mlogf(M_ERROR, M_SHOW,
+            "--- Invalid value for indicationDeliveryOverflow: %s, using block\n",
+            ov);
+  }
+}
+
+/*
+ * queues di for the destination key, starting the workers on first use;
+ * returns 1 if an indication was dropped 
+ */
+static int
+queueIndForDelivery(const char *key, DeliveryInfo * di)
+{
+  DeliveryQueue  *q;
+  DeliveryInfo   *old = NULL;
+  pthread_attr_t  it_attr;
+  pthread_t       ind_thread;
+  struct timespec wait;
+  int             rc = 0;
+
+  _SFCB_ENTER(TRACE_INDPROVIDER, "queueIndForDelivery");
+
+  pthread_mutex_lock(&deliveryLock);
+  if (deliveryQueues == NULL) {
+    deliveryQueues = UtilFactory->newHashTable(61, UtilHashTable_charKey);
+    deliveryQueues->ft->setReleaseFunctions(deliveryQueues, free, free);
+  }
+  while (deliveryWorkers < MAX_IND_THREADS) {
+    pthread_attr_init(&it_attr);
+    pthread_attr_setdetachstate(&it_attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&ind_thread, &it_attr, deliveryWorker, NULL)) {
+      mlogf(M_ERROR,M_SHOW,"pthread_create() failed for indication delivery thread\n");
+      if (deliveryWorkers)
+        break;
+      pthread_mutex_unlock(&deliveryLock);
+      freeDeliveryInfo(di);
+      countIndications(IND_COUNT_DROPPED, 1);
+      _SFCB_RETURN(1);
+    }
+    deliveryWorkers++;
+  }
+
+  if ((q = deliveryQueues->ft->get(deliveryQueues, key)) == NULL) {
+    q = calloc(1, sizeof(*q));
+    deliveryQueues->ft->put(deliveryQueues, strdup(key), q);
+  }
+
+  if (q->depth >= IND_QUEUE_DEPTH && indOverflow == OVERFLOW_BLOCK) {
+    wait.tv_sec = time(NULL) + IND_THREAD_TO;
+    wait.tv_nsec = 0;
+    while (q->depth >= IND_QUEUE_DEPTH)
+      if ((IND_THREAD_TO > 0 ?
+           pthread_cond_timedwait(&deliveryRoom, &deliveryLock, &wait) :
+           pthread_cond_wait(&deliveryRoom, &deliveryLock)) == ETIMEDOUT)
+        break;
+  }
+  if (q->depth >= IND_QUEUE_DEPTH) {
+    if (indOverflow == OVERFLOW_DROPOLD && q->first) {
+      old = q->first;
+      if ((q->first = old->next) == NULL)
+        q->last = NULL;
+      q->depth--;
+    } else {
+      old = di;
+      di = NULL;
+    }
+    countIndications(IND_COUNT_DROPPED, 1);
+    rc = 1;
+  }
+
+  if (di) {
+    if (q->last)
+      q->last->next = di;
+    else
+      q->first = di;
+    q->last = di;
+    q->depth++;
+    countIndications(IND_COUNT_QUEUED, 1);
+    readyQueue(q);
+  }
+  pthread_mutex_unlock(&deliveryLock);
+
+  if (old) {
+    mlogf(M_ERROR,M_SHOW,"Indication delivery queue full; dropping indication\n");
+    freeDeliveryInfo(old);
+  }
+  _SFCB_RETURN(rc);
 }
 
 
@@ -1547,9 +1819,9 @@ InteropProviderInvokeMethod(CMPIMethodMI * mi,
   _SFCB_TRACE(1, ("--- Method: %s", methodName));
 
   if (strcasecmp(methodName, "_deliver") == 0) {
-    HashTableIterator *i;
     Subscription   *su;
-    char           *suName;
+    DeliveryInfo   *dis = NULL,
+                   *di;
     char           *filtername = NULL;
     CMPIArgs       *hin = CMNewArgs(_broker, NULL);
     CMPIInstance   *indo = CMGetArg(in, "indication", NULL).value.inst;
@@ -1564,9 +1836,6 @@ InteropProviderInvokeMethod(CMPIMethodMI * mi,
     char           *ns =
         (char *) CMGetArg(in, "namespace", NULL).value.string->hdl;
 
-    pthread_t ind_thread;
-    pthread_attr_t it_attr;
-
     // Add indicationFilterName to the indication
     Filter *filter = filterId;
     CMPIData cd_name = CMGetProperty(filter->fci, "name", &fn_st);
@@ -1582,60 +1851,35 @@ InteropProviderInvokeMethod(CMPIMethodMI * mi,
     CMRelease(ind);
     CMAddArg(hin, "nameSpace", ns, CMPI_chars);
 
-    pthread_mutex_lock(&subHTlock);
-    if (subscriptionHt)
-      for (i = subscriptionHt->ft->getFirst(subscriptionHt,
-                                            (void **) &suName,
-                                            (void **) &su); i;
-           i =
-           subscriptionHt->ft->getNext(subscriptionHt, i,
-                                       (void **) &suName, (void **) &su)) {
-        if ((void *) su->fi == filterId) {
-          _SFCB_TRACE_VAR_PTR(CMPIString *str, CDToString(_broker, su->ha->hop, NULL));
-          _SFCB_TRACE_VAR_PTR(CMPIString *ns, CMGetNameSpace(su->ha->hop, NULL));
-          _SFCB_TRACE(1,
-                      ("--- invoke handler %s %s", (char *) ns->hdl,
-                       (char *) str->hdl));
-          CMAddArg(hin, "subscription", &su->sci, CMPI_instance);
-
-          pthread_attr_init(&it_attr);
-          pthread_attr_setdetachstate(&it_attr, PTHREAD_CREATE_DETACHED);
-          
-          DeliveryInfo* di = malloc(sizeof(DeliveryInfo));
-          di->ctx = native_clone_CMPIContext(ctx);
-          di->hop = CMClone(su->ha->hop, NULL);
-          di->hin = CMClone(hin, NULL);
-          errno = 0;
-	  if (IND_THREAD_TO > 0) {
-	    availThreadWait.tv_sec = time(NULL) + IND_THREAD_TO;
-	    while ((sem_timedwait(&availThreadsSem, &availThreadWait)) == -1) {
-	      if (errno == ETIMEDOUT) {
-		mlogf(M_ERROR,M_SHOW,"Timedout waiting to create indication delivery thread; dropping indication\n");
-		break;
-	      }
-	      else   /* probably EINTR */
-		continue;
-	    }
-	  }
-	  else {
-	    sem_wait(&availThreadsSem);
-	  }
-	  /* 
-	   * This is a shortcut, but errno is thread-safe and this could only
-	   * be true if set by sem_timedwait().
-	   */
-	  if (errno == ETIMEDOUT) {
-	    _SFCB_TRACE(2,("--- Timedout waiting to create indication delivery thread"));
-	    break;
-	  }
-	  int pcrc = pthread_create(&ind_thread, &it_attr,&sendIndForDelivery,(void *) di);
-	  
-	  _SFCB_TRACE(1,("--- indication delivery thread status: %d", pcrc));
-	  if (pcrc) 
-	    mlogf(M_ERROR,M_SHOW,"pthread_create() failed for indication delivery thread\n");
-        }
-      }
-    pthread_mutex_unlock(&subHTlock);
+    /*
+     * only the subscriptions of the filter are looked at; the delivery
+     * requests are built under the read lock and queued after it is
+     * released, as queueing may wait for room 
+     */
+    pthread_rwlock_rdlock(&subRouteLock);
+    for (su = filter->subs; su; su = su->nextForFilter) {
+      _SFCB_TRACE_VAR_PTR(CMPIString *str, CDToString(_broker, su->ha->hop, NULL));
+      _SFCB_TRACE_VAR_PTR(CMPIString *ns, CMGetNameSpace(su->ha->hop, NULL));
+      _SFCB_TRACE(1,
+                  ("--- invoke handler %s %s", (char *) ns->hdl,
+                   (char *) str->hdl));
+      CMAddArg(hin, "subscription", &su->sci, CMPI_instance);
+
+      di = malloc(sizeof(DeliveryInfo));
+      di->ctx = native_clone_CMPIContext(ctx);
+      di->hop = CMClone(su->ha->hop, NULL);
+      di->hin = CMClone(hin, NULL);
+      di->subKey = strdup(su->key);
+      di->next = dis;
+      dis = di;
+    }
+    pthread_rwlock_unlock(&subRouteLock);
+
+    while ((di = dis)) {
+      dis = di->next;
+      di->next = NULL;
+      queueIndForDelivery(objectpathKey(di->hop), di);
+    }
   }
 
   else if (strcasecmp(methodName, "_addHandler") == 0) {
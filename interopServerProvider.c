@@ -47,6 +47,8 @@
 #include "config.h"
 #include "objectpath.h"
 #include "sfcbmacs.h"
+#include "providerMgr.h"
+#include "latencyStats.h"
 
 #define NEW(x) ((x *) malloc(sizeof(x)))
 
@@ -630,6 +632,156 @@ ServiceProviderGetInstance(CMPIInstanceMI * mi,
 
 // ---------------------------------------------------------------
 
+extern char    *opsName[];
+
+static void
+setUint64Property(CMPIInstance *ci, const char *name, unsigned long value)
+{
+  CMPIUint64      v = value;
+  CMSetProperty(ci, name, &v, CMPI_uint64);
+}
+
+/*
+ * one SFCB_OperationLatency instance per CIM operation and per provider
+ * that has been called since sfcbd started; with id set only the
+ * instance with that InstanceID is returned
+ */
+static CMPIStatus
+LatencyProviderInstances(const CMPIResult *rslt, const char **properties,
+                         int names, const char *id)
+{
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  LatencySummary  s;
+  CMPIObjectPath *op;
+  CMPIInstance   *ci;
+  const char     *provider;
+  char            iid[256];
+  int             i,
+                  rc,
+                  found = 0;
+
+  _SFCB_ENTER(TRACE_PROVIDERS, "LatencyProviderInstances");
+
+  for (i = 0;; i++) {
+    provider = NULL;
+    if ((rc = getOperationLatency(i + 1, &s)) < 0
+        && (rc = getProviderLatency(i - OPS_EnumerationCount, &provider,
+                                    &s)) < 0)
+      break;
+    if (rc)
+      continue;
+
+    if (provider)
+      snprintf(iid, sizeof(iid), "SFCB:Provider:%s", provider);
+    else
+      snprintf(iid, sizeof(iid), "SFCB:Operation:%s", opsName[i + 1]);
+    if (id && strcasecmp(id, iid))
+      continue;
+    found = 1;
+
+    op = CMNewObjectPath(_broker, "root/interop", "SFCB_OperationLatency",
+                         NULL);
+    CMAddKey(op, "InstanceID", iid, CMPI_chars);
+    if (names) {
+      CMReturnObjectPath(rslt, op);
+      continue;
+    }
+
+    ci = CMNewInstance(_broker, op, NULL);
+    CMSetPropertyFilter(ci, properties, NULL);
+    CMSetProperty(ci, "InstanceID", iid, CMPI_chars);
+    CMSetProperty(ci, "ElementName", iid + 5, CMPI_chars);
+    if (provider)
+      CMSetProperty(ci, "ProviderName", provider, CMPI_chars);
+    else
+      CMSetProperty(ci, "Operation", opsName[i + 1], CMPI_chars);
+    setUint64Property(ci, "Count", s.count);
+    setUint64Property(ci, "TotalTime", s.total);
+    setUint64Property(ci, "MaxTime", s.max);
+    setUint64Property(ci, "P50Time", s.p50);
+    setUint64Property(ci, "P90Time", s.p90);
+    setUint64Property(ci, "P99Time", s.p99);
+    setUint64Property(ci, "P999Time", s.p999);
+    CMReturnInstance(rslt, ci);
+  }
+
+  if (id && !found)
+    st.rc = CMPI_RC_ERR_NOT_FOUND;
+  _SFCB_RETURN(st);
+}
+
+static CMPIStatus
+LatencyProviderGetInstance(const CMPIResult *rslt,
+                           const CMPIObjectPath * ref,
+                           const char **properties)
+{
+  CMPIStatus      st = { CMPI_RC_ERR_INVALID_PARAMETER, NULL };
+  CMPIString     *id = CMGetKey(ref, "InstanceID", NULL).value.string;
+
+  if (id && id->hdl)
+    return LatencyProviderInstances(rslt, properties, 0,
+                                    (char *) id->hdl);
+  return st;
+}
+
+#define IND_STATS_ID "SFCB:IndicationDelivery"
+
+/*
+ * the single SFCB_IndicationDeliveryStatistics instance, from the
+ * counters the interop provider keeps in the shared statistics
+ */
+static CMPIStatus
+IndStatsProviderInstances(const CMPIResult *rslt, const char **properties,
+                          int names)
+{
+  CMPIStatus      st = { CMPI_RC_OK, NULL };
+  unsigned long   c[IND_COUNTERS];
+  CMPIObjectPath *op;
+  CMPIInstance   *ci;
+
+  _SFCB_ENTER(TRACE_PROVIDERS, "IndStatsProviderInstances");
+
+  if (getIndicationCounters(c))
+    _SFCB_RETURN(st);
+
+  op = CMNewObjectPath(_broker, "root/interop",
+                       "SFCB_IndicationDeliveryStatistics", NULL);
+  CMAddKey(op, "InstanceID", IND_STATS_ID, CMPI_chars);
+  if (names) {
+    CMReturnObjectPath(rslt, op);
+    _SFCB_RETURN(st);
+  }
+
+  ci = CMNewInstance(_broker, op, NULL);
+  CMSetPropertyFilter(ci, properties, NULL);
+  CMSetProperty(ci, "InstanceID", IND_STATS_ID, CMPI_chars);
+  CMSetProperty(ci, "ElementName", "IndicationDelivery", CMPI_chars);
+  setUint64Property(ci, "Queued", c[IND_COUNT_QUEUED]);
+  setUint64Property(ci, "Delivered", c[IND_COUNT_DELIVERED]);
+  setUint64Property(ci, "Failed", c[IND_COUNT_FAILED]);
+  setUint64Property(ci, "Dropped", c[IND_COUNT_DROPPED]);
+  CMReturnInstance(rslt, ci);
+
+  _SFCB_RETURN(st);
+}
+
+static CMPIStatus
+IndStatsProviderGetInstance(const CMPIResult *rslt,
+                            const CMPIObjectPath * ref,
+                            const char **properties)
+{
+  CMPIStatus      st = { CMPI_RC_ERR_NOT_FOUND, NULL };
+  CMPIString     *id = CMGetKey(ref, "InstanceID", NULL).value.string;
+
+  if (id == NULL || id->hdl == NULL)
+    st.rc = CMPI_RC_ERR_INVALID_PARAMETER;
+  else if (strcasecmp((char *) id->hdl, IND_STATS_ID) == 0)
+    return IndStatsProviderInstances(rslt, properties, 0);
+  return st;
+}
+
+// ---------------------------------------------------------------
+
 static CMPIStatus
 ServerProviderCleanup(CMPIInstanceMI * mi, const CMPIContext *ctx,
                       CMPIBoolean terminate)
@@ -663,6 +815,11 @@ ServerProviderGetInstance(CMPIInstanceMI * mi,
       (_broker, ref, "CIM_IndicationServiceCapabilities", NULL))
     return IndServiceCapabilitiesProviderEnumInstances(mi, ctx, rslt, ref,
                                                        properties);
+  if (strcasecmp((char *) cls->hdl, "sfcb_operationlatency") == 0)
+    return LatencyProviderGetInstance(rslt, ref, properties);
+  if (strcasecmp((char *) cls->hdl, "sfcb_indicationdeliverystatistics")
+      == 0)
+    return IndStatsProviderGetInstance(rslt, ref, properties);
 
   return invClassSt;
 }
@@ -692,6 +849,11 @@ ServerProviderEnumInstanceNames(CMPIInstanceMI * mi,
       (_broker, ref, "CIM_IndicationServiceCapabilities", NULL))
     return IndServiceCapabilitiesProviderEnumInstanceNames(mi, ctx, rslt,
                                                            ref);
+  if (strcasecmp((char *) cls->hdl, "sfcb_operationlatency") == 0)
+    return LatencyProviderInstances(rslt, NULL, 1, NULL);
+  if (strcasecmp((char *) cls->hdl, "sfcb_indicationdeliverystatistics")
+      == 0)
+    return IndStatsProviderInstances(rslt, NULL, 1);
 
   return okSt;
 }
@@ -724,6 +886,11 @@ ServerProviderEnumInstances(CMPIInstanceMI * mi,
       (_broker, ref, "cim_indicationservicecapabilities", NULL))
     return IndServiceCapabilitiesProviderEnumInstances(mi, ctx, rslt, ref,
                                                        properties);
+  if (strcasecmp((char *) cls->hdl, "sfcb_operationlatency") == 0)
+    return LatencyProviderInstances(rslt, properties, 0, NULL);
+  if (strcasecmp((char *) cls->hdl, "sfcb_indicationdeliverystatistics")
+      == 0)
+    return IndStatsProviderInstances(rslt, properties, 0);
 
   return okSt;
 }
@@ -0,0 +1,270 @@
+/*
+ * latencyStats.c
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Latency histograms in the style of HdrHistogram: values up to 15us get
+ * a bucket each, above that every power of two is split into 16 buckets,
+ * so a percentile is off by at most 1/16 of its value. The histograms live
+ * in an anonymous shared mapping set up by sfcbd before it forks, request
+ * handlers add the time spent on each CIM operation, provider processes
+ * the time spent in each provider, all with atomic adds. The interop
+ * provider counts the indications it delivers there as well.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "latencyStats.h"
+#include "providerMgr.h"
+#include "mlog.h"
+
+#define LATENCY_SUB_BITS    4
+#define LATENCY_SUB         (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BIT     35  /* about 9.5 hours */
+#define LATENCY_BUCKETS     ((LATENCY_MAX_BIT - LATENCY_SUB_BITS + 2) * LATENCY_SUB)
+#define LATENCY_OPS         (OPS_EnumerationCount + 1)
+#define LATENCY_PROVIDERS   256
+#define LATENCY_NAME_LEN    64
+
+typedef struct latencyHistogram {
+  unsigned long   count;
+  unsigned long   total;
+  unsigned long   max;
+  unsigned long   bucket[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+typedef struct latencySlot {
+  int             state;        /* 0 free, 1 being claimed, 2 in use */
+  char            name[LATENCY_NAME_LEN];
+  LatencyHistogram hist;
+} LatencySlot;
+
+typedef struct latencyStats {
+  LatencyHistogram op[LATENCY_OPS];
+  LatencySlot     prov[LATENCY_PROVIDERS];
+  unsigned long   ind[IND_COUNTERS];
+} LatencyStats;
+
+static LatencyStats *stats = NULL;
+
+void
+initLatencyStats()
+{
+  void           *page;
+
+  page = mmap(NULL, sizeof(LatencyStats), PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    mlogf(M_ERROR, M_SHOW, "--- latency statistics disabled, mmap failed: %s\n",
+          strerror(errno));
+    return;
+  }
+  stats = page;
+}
+
+static int
+bucketOf(unsigned long v)
+{
+  int             k;
+
+  if (v < LATENCY_SUB)
+    return v;
+  k = 63 - __builtin_clzl(v);
+  if (k > LATENCY_MAX_BIT)
+    return LATENCY_BUCKETS - 1;
+  return (k - LATENCY_SUB_BITS + 1) * LATENCY_SUB +
+      ((v >> (k - LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+}
+
+/* highest value that lands in bucket b */
+static unsigned long
+bucketValue(int b)
+{
+  int             k;
+
+  if (b < LATENCY_SUB)
+    return b;
+  k = b / LATENCY_SUB + LATENCY_SUB_BITS - 1;
+  return ((unsigned long) (LATENCY_SUB + b % LATENCY_SUB + 1)
+          << (k - LATENCY_SUB_BITS)) - 1;
+}
+
+static void
+addLatency(LatencyHistogram * h, struct timeval *start)
+{
+  struct timeval  now;
+  unsigned long   v,
+                  max;
+  long            us;
+
+  gettimeofday(&now, NULL);
+  us = (now.tv_sec - start->tv_sec) * 1000000L +
+      (now.tv_usec - start->tv_usec);
+  v = us < 0 ? 0 : us;
+
+  __sync_fetch_and_add(&h->bucket[bucketOf(v)], 1);
+  __sync_fetch_and_add(&h->total, v);
+  __sync_fetch_and_add(&h->count, 1);
+  while ((max = h->max) < v)
+    if (__sync_bool_compare_and_swap(&h->max, max, v))
+      break;
+}
+
+void
+recordOperationLatency(int op, struct timeval *start)
+{
+  if (stats && op > 0 && op < LATENCY_OPS)
+    addLatency(&stats->op[op], start);
+}
+
+/*
+ * find the slot of a provider, claiming a free one the first time the
+ * provider is seen
+ */
+static LatencySlot *
+providerSlot(const char *provider)
+{
+  unsigned int    h = 0,
+                  i,
+                  n;
+  const char     *p;
+  LatencySlot    *s;
+
+  for (p = provider; *p; p++)
+    h = h * 31 + *p;
+
+  for (n = 0, i = h % LATENCY_PROVIDERS; n < LATENCY_PROVIDERS;
+       n++, i = (i + 1) % LATENCY_PROVIDERS) {
+    s = stats->prov + i;
+    if (s->state == 0 && __sync_bool_compare_and_swap(&s->state, 0, 1)) {
+      strncpy(s->name, provider, LATENCY_NAME_LEN - 1);
+      __sync_synchronize();
+      s->state = 2;
+      return s;
+    }
+    while (s->state == 1)
+      sched_yield();
+    if (strncmp(s->name, provider, LATENCY_NAME_LEN - 1) == 0)
+      return s;
+  }
+  return NULL;
+}
+
+void
+recordProviderLatency(const char *provider, struct timeval *start)
+{
+  LatencySlot    *s;
+
+  if (stats && provider && (s = providerSlot(provider)))
+    addLatency(&s->hist, start);
+}
+
+static void
+summarize(LatencyHistogram * h, LatencySummary * s)
+{
+  unsigned long   n = 0,
+                  seen = 0;
+  int             b;
+
+  for (b = 0; b < LATENCY_BUCKETS; b++)
+    n += h->bucket[b];
+
+  memset(s, 0, sizeof(*s));
+  s->count = h->count;
+  s->total = h->total;
+  s->max = h->max;
+
+  for (b = 0; b < LATENCY_BUCKETS && n; b++) {
+    if (h->bucket[b] == 0)
+      continue;
+    seen += h->bucket[b];
+    if (s->p50 == 0 && seen * 2 >= n)
+      s->p50 = bucketValue(b);
+    if (s->p90 == 0 && seen * 10 >= n * 9)
+      s->p90 = bucketValue(b);
+    if (s->p99 == 0 && seen * 100 >= n * 99)
+      s->p99 = bucketValue(b);
+    if (s->p999 == 0 && seen * 1000 >= n * 999)
+      s->p999 = bucketValue(b);
+  }
+
+  /* bucket bounds may overshoot the largest value seen */
+  if (s->p50 > s->max)
+    s->p50 = s->max;
+  if (s->p90 > s->max)
+    s->p90 = s->max;
+  if (s->p99 > s->max)
+    s->p99 = s->max;
+  if (s->p999 > s->max)
+    s->p999 = s->max;
+}
+
+/*
+ * returns -1 for an operation out of range, 1 if it has not been seen
+ */
+int
+getOperationLatency(int op, LatencySummary * s)
+{
+  if (stats == NULL || op <= 0 || op >= LATENCY_OPS)
+    return -1;
+  summarize(&stats->op[op], s);
+  return s->count ? 0 : 1;
+}
+
+/*
+ * returns -1 past the last slot, 1 for a slot not in use
+ */
+int
+getProviderLatency(int i, const char **provider, LatencySummary * s)
+{
+  if (stats == NULL || i < 0 || i >= LATENCY_PROVIDERS)
+    return -1;
+  if (stats->prov[i].state != 2)
+    return 1;
+  *provider = stats->prov[i].name;
+  summarize(&stats->prov[i].hist, s);
+  return 0;
+}
+
+void
+countIndications(int counter, unsigned long n)
+{
+  if (stats && counter >= 0 && counter < IND_COUNTERS)
+    __sync_fetch_and_add(&stats->ind[counter], n);
+}
+
+/*
+ * copies the IND_COUNTERS indication counters, returns -1 if there are
+ * none
+ */
+int
+getIndicationCounters(unsigned long *counters)
+{
+  int             i;
+
+  if (stats == NULL)
+    return -1;
+  for (i = 0; i < IND_COUNTERS; i++)
+    counters[i] = stats->ind[i];
+  return 0;
+}
+
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
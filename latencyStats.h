@@ -0,0 +1,58 @@
+/*
+ * latencyStats.h
+ *
+ * (C) Copyright IBM Corp. 2005, 2009
+ *
+ * THIS FILE IS PROVIDED UNDER THE TERMS OF THE ECLIPSE PUBLIC LICENSE
+ * ("AGREEMENT"). ANY USE, REPRODUCTION OR DISTRIBUTION OF THIS FILE
+ * CONSTITUTES RECIPIENTS ACCEPTANCE OF THE AGREEMENT.
+ *
+ * You can obtain a current copy of the Eclipse Public License from
+ * http://www.opensource.org/licenses/eclipse-1.0.php
+ *
+ * Description:
+ *
+ * Latency histograms per CIM operation and per provider, and indication
+ * delivery counters, kept in memory shared by sfcbd, its request handlers
+ * and provider processes.
+ *
+ */
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <sys/time.h>
+
+typedef struct latencySummary {
+  unsigned long   count;
+  unsigned long   total;        /* all values in microseconds */
+  unsigned long   max;
+  unsigned long   p50;
+  unsigned long   p90;
+  unsigned long   p99;
+  unsigned long   p999;
+} LatencySummary;
+
+/* indication delivery counters */
+#define IND_COUNT_QUEUED    0
+#define IND_COUNT_DELIVERED 1
+#define IND_COUNT_FAILED    2
+#define IND_COUNT_DROPPED   3
+#define IND_COUNTERS        4
+
+extern void     initLatencyStats();
+extern void     recordOperationLatency(int op, struct timeval *start);
+extern void     recordProviderLatency(const char *provider,
+                                      struct timeval *start);
+extern int      getOperationLatency(int op, LatencySummary * s);
+extern int      getProviderLatency(int i, const char **provider,
+                                   LatencySummary * s);
+extern void     countIndications(int counter, unsigned long n);
+extern int      getIndicationCounters(unsigned long *counters);
+
+#endif
+/* MODELINES */
+/* DO NOT EDIT BELOW THIS COMMENT */
+/* Modelines are added by 'make pretty' */
+/* -*- Mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
+/* vi:set ts=2 sts=2 sw=2 expandtab: */
@@ -413,6 +413,7 @@ spRcvMsg(int *s, int *from, void **data, unsigned long *length,
   switch (spMsg.xtra) {
   case MSG_X_PROVIDER:
   case MSG_X_SFCB_PROVIDER:
+  case MSG_X_HTTP_CONN:
     *length = spMsg.segments;
     *data = spMsg.provId;
   case MSG_X_INVALID_NAMESPACE:
@@ -652,7 +653,15 @@ spSendCtl(int *to, int *from, short code, unsigned long count, void *data)
   iov[0].iov_base = &spMsg;
   iov[0].iov_len = sizeof(spMsg);
 
-  if (sendmsg(*to, &msg, 0) < 0)
+  /* As in spSendMsg: only req handlers may be killed by SIGPIPE; everybody
+   * else (e.g. the http daemon handing a connection to a pooled handler
+   * that just went away) handles the error here */
+  int flags = 0;
+  extern int httpProcIdX;
+  if (httpProcIdX == 0)
+    flags = MSG_NOSIGNAL;
+
+  if (sendmsg(*to, &msg, flags) < 0)
     return spHandleError(to, em);
 
   _SFCB_RETURN(0);
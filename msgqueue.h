@@ -44,6 +44,7 @@
 #define MSG_X_FAILED             8
 #define MSG_X_LOCAL              9
 #define MSG_X_SFCB_PROVIDER      10
+#define MSG_X_HTTP_CONN          11
 
 #if defined(__FreeBSD__) || \
     defined(__GNU_LIBRARY__) && !defined(_SEM_SEMUN_UNDEFINED)
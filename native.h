@@ -118,7 +118,10 @@ extern CMPIBrokerMemFT *CMPI_BrokerMem_Ftab;
 MsgSegment      setObjectPathMsgSegment(const CMPIObjectPath * op);
 CMPIInstance   *relocateSerializedInstance(void *area);
 void            getSerializedInstance(const CMPIInstance *ci, void *area);
+void            getSerializedInstanceShared(const CMPIInstance *ci,
+                                            void *area);
 unsigned long   getInstanceSerializedSize(const CMPIInstance *ci);
+unsigned long   getInstanceSerializedSizeShared(const CMPIInstance *ci);
 void            getSerializedObjectPath(const CMPIObjectPath * op,
                                         void *area);
 unsigned long   getObjectPathSerializedSize(const CMPIObjectPath * op);
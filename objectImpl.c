@@ -23,7 +23,9 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
 #include <netinet/in.h>
+#include <sys/mman.h>
 
 #include "objectImpl.h"
 #include "array.h"
@@ -134,6 +136,102 @@ clearClSection(ClSection * s)
   memset(s, 0, sizeof(*s));
 }
 
+/*
+ * Broker wide table of interned instance property names. It is mapped
+ * shared by sfcbd before any other process is forked, so every sfcb
+ * process resolves an interned id the same way and instances exchanged
+ * between them need not carry their property names. Interned ids are
+ * negative ClString ids: -(offset of the name in the pool + 1). Entries
+ * are never removed; once the table is full names go to the object's own
+ * string buffer again. 
+ */
+typedef struct clInternTable {
+  unsigned int    slots;
+  unsigned int    size;
+  volatile unsigned int used;
+  volatile unsigned int entries;
+  volatile unsigned int slot[1];
+} ClInternTable;
+
+static ClInternTable *internTable = NULL;
+static char    *internPool = NULL;
+
+int
+ClInternInit(unsigned long size)
+{
+  ClInternTable  *t;
+  unsigned int    slots = 1024;
+
+  if (size < 65536)
+    return 0;
+  while (slots * 64 < size)
+    slots *= 2;
+  t = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+           -1, 0);
+  if (t == MAP_FAILED)
+    return -1;
+  t->slots = slots;
+  t->size = size - (sizeof(*t) + slots * sizeof(t->slot[0]));
+  t->used = t->entries = 0;
+  internPool = (char *) (t->slot + slots);
+  internTable = t;
+  return 0;
+}
+
+int
+ClInternEnabled()
+{
+  return internTable != NULL;
+}
+
+static unsigned int
+internHash(const char *s)
+{
+  unsigned int    h = 2166136261u;
+  while (*s)
+    h = (h ^ (unsigned char) *s++) * 16777619u;
+  return h;
+}
+
+/*
+ * returns the interned id of str, 0 if it cannot be interned; lock free,
+ * the slot is only published after the name was copied to the pool 
+ */
+static long
+internClString(const char *str)
+{
+  ClInternTable  *t = internTable;
+  unsigned int    h,
+                  v,
+                  n,
+                  off = 0,
+      l = strlen(str) + 1;
+
+  if (t == NULL)
+    return 0;
+  for (n = 0, h = internHash(str) & (t->slots - 1); n < t->slots;
+       n++, h = (h + 1) & (t->slots - 1)) {
+    if ((v = t->slot[h]) == 0) {
+      if (off == 0) {
+        if (t->entries >= t->slots / 4 * 3)
+          return 0;
+        off = __sync_fetch_and_add(&t->used, l) + 1;
+        if (off - 1 + l > t->size)
+          return 0;
+        memcpy(internPool + off - 1, str, l);
+        __sync_synchronize();
+      }
+      if ((v = __sync_val_compare_and_swap(&t->slot[h], 0, off)) == 0) {
+        __sync_fetch_and_add(&t->entries, 1);
+        return -(long) off;
+      }
+    }
+    if (strcmp(internPool + v - 1, str) == 0)
+      return -(long) v;
+  }
+  return 0;
+}
+
 const char     *
 ClObjectGetClString(ClObjectHdr * hdr, ClString * id)
 {
@@ -141,8 +239,10 @@ ClObjectGetClString(ClObjectHdr * hdr, ClString * id)
 
   if (id->id == 0)
     return NULL;
+  if (id->id < 0)
+    return internPool + (-id->id - 1);
   buf = getStrBufPtr(hdr);
-  return &(buf->buf[buf->indexPtr[id->id - 1]]);
+  return &(buf->buf[getStrIndexPtr(hdr, buf)[id->id - 1]]);
 }
 
 const char     *
@@ -159,7 +259,7 @@ ClObjectGetClArray(ClObjectHdr * hdr, ClArray * id)
   if (id->id == 0)
     return NULL;
   buf = getArrayBufPtr(hdr);
-  return &(buf->buf[buf->indexPtr[id->id - 1]]);
+  return &(buf->buf[getArrayIndexPtr(hdr, buf)[id->id - 1]]);
 }
 
 void           *
@@ -704,7 +804,7 @@ copyStringBuf(int ofs, ClObjectHdr * th, ClObjectHdr * fh)
   l = ALIGN(l, 4);
   ofs += l;
 
-  memcpy(((char *) th) + ofs, fb->indexPtr, il);
+  memcpy(((char *) th) + ofs, getStrIndexPtr(fh, fb), il);
   tb->iMax = tb->iUsed;
   setStrIndexOffset(th, tb, ofs);
 
@@ -735,7 +835,7 @@ copyArrayBuf(int ofs, ClObjectHdr * th, ClObjectHdr * fh)
   setArrayBufOffset(th, ofs);
   ofs += l;
 
-  memcpy(((char *) th) + ofs, fb->indexPtr, il);
+  memcpy(((char *) th) + ofs, getArrayIndexPtr(fh, fb), il);
   tb->iMax = tb->iUsed;
   setArrayIndexOffset(th, tb, ofs);
 
@@ -1441,13 +1541,67 @@ ClClassGetMethParamQualifierAt(ClClass * cls, ClParameter * parm, int id,
 // -----
 // -------------------------------------------------------
 
+/*
+ * Rebuilt property sections with at least PROPERTY_INDEX_MIN entries are
+ * followed by an open addressing table of property numbers (1 based),
+ * keyed by the case folded property name; HDR_PropertyIndex says it is
+ * there. Sections that were modified since (malloced) are searched
+ * linearly again. 
+ */
+#define PROPERTY_INDEX_MIN 8
+
+static int
+propertyIndexSlots(int used)
+{
+  int             n = 16;
+
+  if (used < PROPERTY_INDEX_MIN)
+    return 0;
+  while (n < used * 2)
+    n <<= 1;
+  return n;
+}
+
+static unsigned int
+propertyNameHash(const char *id)
+{
+  unsigned int    h = 2166136261u;
+
+  while (*id)
+    h = (h ^ (unsigned char) tolower((unsigned char) *id++)) * 16777619u;
+  return h;
+}
+
+static unsigned short *
+getPropertyIndex(ClObjectHdr * hdr, ClSection * prps, ClProperty * p,
+                 int *slots)
+{
+  if ((hdr->flags & HDR_PropertyIndex) == 0 || isMallocedSection(prps)
+      || prps->used != GetMax(prps->max))
+    return NULL;
+  if ((*slots = propertyIndexSlots(prps->used)) == 0)
+    return NULL;
+  return (unsigned short *) (p + prps->used);
+}
+
 int
 ClObjectLocateProperty(ClObjectHdr * hdr, ClSection * prps, const char *id)
 {
-  int             i;
+  int             i,
+                  n;
+  unsigned int    h;
   ClProperty     *p;
+  unsigned short *idx;
 
   p = (ClProperty *) getSectionPtr(hdr, prps);
+  if ((idx = getPropertyIndex(hdr, prps, p, &n))) {
+    for (h = propertyNameHash(id) & (n - 1); (i = idx[h]);
+         h = (h + 1) & (n - 1)) {
+      if (strcasecmp(id, ClObjectGetClString(hdr, &(p + i - 1)->id)) == 0)
+        return i;
+    }
+    return 0;
+  }
   for (i = 0; i < prps->used; i++) {
     if (strcasecmp(id, ClObjectGetClString(hdr, &(p + i)->id)) == 0)
       return i + 1;
@@ -1521,7 +1675,8 @@ static long
 sizeProperties(ClObjectHdr * hdr, ClSection * s)
 {
   int             l;
-  long            sz = s->used * sizeof(ClProperty);
+  long            sz = s->used * sizeof(ClProperty) +
+      ALIGN(propertyIndexSlots(s->used) * sizeof(unsigned short), CLALIGN);
   ClProperty     *p = (ClProperty *) ClObjectGetClSection(hdr, s);
 
   for (l = s->used; l > 0; l--, p++) {
@@ -1539,6 +1694,11 @@ copyProperties(int ofs, char *to, ClSection * ts,
   ClProperty     *tp = (ClProperty *) (to + ofs);
   int             i;
   int             l = ts->used * sizeof(ClProperty);
+  int             n = propertyIndexSlots(ts->used);
+  unsigned short *idx;
+  unsigned int    h;
+
+  ((ClObjectHdr *) to)->flags &= ~HDR_PropertyIndex;
   if (l == 0)
     return 0;
   ts->max = ts->used;
@@ -1546,6 +1706,20 @@ copyProperties(int ofs, char *to, ClSection * ts,
   memcpy(tp, fp, l);
   setSectionOffset(ts, ofs);
 
+  if (n) {
+    idx = (unsigned short *) (tp + ts->used);
+    memset(idx, 0, n * sizeof(*idx));
+    for (i = 0; i < ts->used; i++) {
+      if (fp[i].id.id == 0)
+        continue;
+      for (h = propertyNameHash(ClObjectGetClString(from, &fp[i].id))
+           & (n - 1); idx[h]; h = (h + 1) & (n - 1));
+      idx[h] = i + 1;
+    }
+    l += ALIGN(n * sizeof(*idx), CLALIGN);
+    ((ClObjectHdr *) to)->flags |= HDR_PropertyIndex;
+  }
+
   for (i = ts->used; i > 0; i--, fp++, tp++)
     if (tp->qualifiers.used)
       l += copyQualifiers(ofs + l, to, &tp->qualifiers, from,
@@ -1589,7 +1763,10 @@ addObjectPropertyH(ClObjectHdr * hdr, ClSection * prps,
     p = (ClProperty *) ensureClSpace(hdr, prps, sizeof(*p), 8);
     p = p + (prps->used++);
     clearClSection(&p->qualifiers);
-    p->id.id = addClString(hdr, id);
+    if (hdr->type == HDR_Instance && (p->id.id = internClString(id)))
+      hdr->flags |= HDR_InternedNames;
+    else
+      p->id.id = addClString(hdr, id);
     p->quals = p->flags = 0;
     p->originId = 0;
     if (refName) {
@@ -2252,14 +2429,118 @@ ClInstanceNewFromMof(const char *ns, const char *cn)
   return inst;
 }
 
+/*
+ * length and number of the interned property names of an instance
+ */
 static long
-sizeInstanceH(ClObjectHdr * hdr, ClInstance * inst)
+internedNamesLength(ClObjectHdr * hdr, ClSection * prps, int *count)
+{
+  ClProperty     *p = (ClProperty *) getSectionPtr(hdr, prps);
+  long            l = 0;
+  int             i;
+
+  *count = 0;
+  for (i = 0; i < prps->used; i++) {
+    if (p[i].id.id < 0) {
+      l += strlen(ClObjectGetClString(hdr, &p[i].id)) + 1;
+      (*count)++;
+    }
+  }
+  return l;
+}
+
+/*
+ * size of the string buffer once the interned names are copied into it
+ */
+static long
+sizeStringBufExternal(ClObjectHdr * hdr, ClSection * prps)
+{
+  ClStrBuf       *buf;
+  long            bUsed,
+                  sz;
+  int             iUsed;
+
+  if ((hdr->flags & HDR_InternedNames) == 0)
+    return sizeStringBuf(hdr);
+
+  bUsed = internedNamesLength(hdr, prps, &iUsed);
+  if (hdr->strBufOffset) {
+    buf = getStrBufPtr(hdr);
+    bUsed += buf->bUsed;
+    iUsed += buf->iUsed;
+  }
+  sz = sizeof(*buf) + ALIGN(bUsed, 4) + (iUsed * sizeof(*buf->indexPtr));
+  return ALIGN(sz, CLALIGN);
+}
+
+/*
+ * copyStringBuf() for an object leaving the processes that share the
+ * intern table: the interned names of the properties already copied to
+ * th are appended to its string buffer and their ids replaced, fh is
+ * left as it is
+ */
+static int
+copyStringBufExternal(int ofs, ClObjectHdr * th, ClObjectHdr * fh,
+                      ClSection * prps)
+{
+  ClStrBuf       *fb = NULL,
+      *tb;
+  ClProperty     *p;
+  const char     *name;
+  int            *idx;
+  long            l,
+                  il,
+                  nl;
+  int             i,
+                  n;
+
+  if ((fh->flags & HDR_InternedNames) == 0)
+    return copyStringBuf(ofs, th, fh);
+
+  tb = (ClStrBuf *) (((char *) th) + ofs);
+  nl = internedNamesLength(th, prps, &n);
+  if (fh->strBufOffset) {
+    fb = getStrBufPtr(fh);
+    memcpy(tb, fb, sizeof(*fb) + fb->bUsed);
+  } else
+    memset(tb, 0, sizeof(*tb));
+
+  l = ALIGN(sizeof(*tb) + tb->bUsed + nl, 4);
+  idx = (int *) (((char *) th) + ofs + l);
+  if (fb)
+    memcpy(idx, getStrIndexPtr(fh, fb), fb->iUsed * sizeof(*fb->indexPtr));
+
+  p = (ClProperty *) getSectionPtr(th, prps);
+  for (i = 0; i < prps->used; i++) {
+    if (p[i].id.id < 0) {
+      name = ClObjectGetClString(th, &p[i].id);
+      idx[tb->iUsed] = tb->bUsed;
+      strcpy(tb->buf + tb->bUsed, name);
+      tb->bUsed += strlen(name) + 1;
+      p[i].id.id = ++tb->iUsed;
+    }
+  }
+  tb->bMax = tb->bUsed;
+  tb->iMax = tb->iUsed;
+  setStrBufOffset(th, ofs);
+  setStrIndexOffset(th, tb, ofs + l);
+  th->flags &= ~HDR_InternedNames;
+
+  il = tb->iUsed * sizeof(*tb->indexPtr);
+  return ALIGN(l + il, CLALIGN);
+}
+
+static long
+sizeInstanceH(ClObjectHdr * hdr, ClInstance * inst, int external)
 {
   long            sz = sizeof(*inst);
 
   sz += sizeQualifiers(&inst->qualifiers);
   sz += sizeProperties(hdr, &inst->properties);
-  sz += sizeStringBuf(hdr);
+  if (external)
+    sz += sizeStringBufExternal(hdr, &inst->properties);
+  else
+    sz += sizeStringBuf(hdr);
   sz += sizeArrayBuf(hdr);
 
   return ALIGN(sz, CLALIGN);
@@ -2268,14 +2549,25 @@ sizeInstanceH(ClObjectHdr * hdr, ClInstance * inst)
 unsigned long
 ClSizeInstance(ClInstance * inst)
 {
-  return sizeInstanceH(&inst->hdr, inst);
+  return sizeInstanceH(&inst->hdr, inst, 0);
+}
+
+/*
+ * size of the instance with its interned property names copied into it,
+ * for instances leaving the processes that share the intern table 
+ */
+unsigned long
+ClSizeInstanceExternal(ClInstance * inst)
+{
+  return sizeInstanceH(&inst->hdr, inst, 1);
 }
 
 static ClInstance *
-rebuildInstanceH(ClObjectHdr * hdr, ClInstance * inst, void *area)
+rebuildInstanceH(ClObjectHdr * hdr, ClInstance * inst, void *area,
+                 int external)
 {
   int             ofs = sizeof(ClInstance);
-  int             sz = ClSizeInstance(inst);
+  int             sz = sizeInstanceH(hdr, inst, external);
   ClInstance     *ni = area ? (ClInstance *) area : malloc(sz);
 
   *ni = *inst;
@@ -2284,7 +2576,10 @@ rebuildInstanceH(ClObjectHdr * hdr, ClInstance * inst, void *area)
                         &inst->qualifiers);
   ofs += copyProperties(ofs, (char *) ni, &ni->properties, hdr,
                         &inst->properties);
-  ofs += copyStringBuf(ofs, &ni->hdr, hdr);
+  if (external)
+    ofs += copyStringBufExternal(ofs, &ni->hdr, hdr, &ni->properties);
+  else
+    ofs += copyStringBuf(ofs, &ni->hdr, hdr);
   ofs += copyArrayBuf(ofs, &ni->hdr, hdr);
 
   ni->hdr.size = ALIGN(sz, CLALIGN);
@@ -2295,7 +2590,17 @@ rebuildInstanceH(ClObjectHdr * hdr, ClInstance * inst, void *area)
 ClInstance     *
 ClInstanceRebuild(ClInstance * inst, void *area)
 {
-  return rebuildInstanceH(&inst->hdr, inst, area);
+  return rebuildInstanceH(&inst->hdr, inst, area, 0);
+}
+
+/*
+ * ClInstanceRebuild() with the interned property names copied into the
+ * new instance; inst itself keeps referring to the intern table 
+ */
+ClInstance     *
+ClInstanceRebuildExternal(ClInstance * inst, void *area)
+{
+  return rebuildInstanceH(&inst->hdr, inst, area, 1);
 }
 
 void
@@ -158,6 +158,8 @@ typedef struct {
 #define HDR_ArrayBufferMalloced 32
 #define HDR_FromMof 64
 #define HDR_HasFilteredProps 128
+#define HDR_PropertyIndex 256
+#define HDR_InternedNames 512
 #endif
   unsigned short  type;
 #ifndef SETCLPFX
@@ -383,6 +385,18 @@ setStrIndexOffset(ClObjectHdr * hdr, ClStrBuf * buf, long offs)
   buf->indexOffset = offs;
 }
 
+/*
+ * An index inside the object is found through its offset, so a serialized
+ * object can be read in place without being relocated first. 
+ */
+inline static int *
+getStrIndexPtr(ClObjectHdr * hdr, ClStrBuf * buf)
+{
+  if (IsMallocedMax(buf->iMax))
+    return buf->indexPtr;
+  return (int *) (((char *) hdr) + buf->indexOffset);
+}
+
 inline static ClArrayBuf *
 getArrayBufPtr(ClObjectHdr * hdr)
 {
@@ -421,6 +435,14 @@ setArrayIndexOffset(ClObjectHdr * hdr, ClArrayBuf * buf, long offs)
   buf->indexOffset = offs;
 }
 
+inline static int *
+getArrayIndexPtr(ClObjectHdr * hdr, ClArrayBuf * buf)
+{
+  if (IsMallocedMax(buf->iMax))
+    return buf->indexPtr;
+  return (int *) (((char *) hdr) + buf->indexOffset);
+}
+
 inline static int
 isMallocedStrBuf(ClObjectHdr * hdr)
 {
@@ -488,6 +510,8 @@ extern int      ClClassGetMethParmQualifierCount(ClClass * cls,
                                                  ClMethod * m, int id);
 extern int      ClObjectLocateProperty(ClObjectHdr * hdr, ClSection * prps,
                                        const char *id);
+extern int      ClInternInit(unsigned long size);
+extern int      ClInternEnabled();
 extern void     showClHdr(void *ihdr);
 extern unsigned char ClClassAddGrandParent(ClClass * cls, char *gp);
 extern ClClass *ClClassNew(const char *cn, const char *pa);
@@ -528,6 +552,9 @@ extern ClInstance *ClInstanceNew(const char *ns, const char *cn);
 extern ClInstance *ClInstanceNewFromMof(const char *ns, const char *cn);
 extern unsigned long ClSizeInstance(ClInstance * inst);
 extern ClInstance *ClInstanceRebuild(ClInstance * inst, void *area);
+extern unsigned long ClSizeInstanceExternal(ClInstance * inst);
+extern ClInstance *ClInstanceRebuildExternal(ClInstance * inst,
+                                             void *area);
 extern void     ClInstanceRelocateInstance(ClInstance * inst);
 extern void     ClInstanceFree(ClInstance * inst);
 extern char    *ClInstanceToString(ClInstance * inst);
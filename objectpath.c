@@ -46,10 +46,20 @@ struct native_cop {
   CMPIObjectPath  cop;
   int             refCount;
   int             mem_state;
+  char           *key;          /* canonical key, see objectpathKey() */
+  CMPIUint64      hash;         /* hash of key */
 };
 
 static struct native_cop *__new_empty_cop(int, CMPIStatus *);
 
+static void
+dropKey(CMPIObjectPath * cop)
+{
+  struct native_cop *o = (struct native_cop *) cop;
+  free(o->key);
+  o->key = NULL;
+}
+
 void
 memLinkObjectPath(CMPIObjectPath * cop)
 {
@@ -66,10 +76,9 @@ __oft_release(CMPIObjectPath * cop)
 
   // printf("__oft_release %d %d %p\n",getpid(),o->mem_state,cop);
   if (o->mem_state && o->mem_state != MEM_RELEASED) {
+    dropKey(cop);
     ClObjectPathFree((ClObjectPath *) cop->hdl);
-    memUnlinkEncObj(o->mem_state);
-    o->mem_state = MEM_RELEASED;
-    free(cop);
+    memReleaseEncObj(cop, &o->mem_state);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -90,6 +99,7 @@ static CMPIStatus
 __oft_setNameSpace(CMPIObjectPath * op, const char *nameSpace)
 {
   ClObjectPath   *cop = (ClObjectPath *) op->hdl;
+  dropKey(op);
   ClObjectPathSetNameSpace(cop, nameSpace);
   CMReturn(CMPI_RC_OK);
 }
@@ -243,6 +253,7 @@ __oft_addKey(CMPIObjectPath * op,
     data.state = CMPI_nullValue;
   }
 
+  dropKey(op);
   ClObjectPathAddKey(cop, name, data);
 
   CMReturn(CMPI_RC_OK);
@@ -395,6 +406,7 @@ void
 getSerializedObjectPath(const CMPIObjectPath * op, void *area)
 {
   memcpy(area, op, sizeof(struct native_cop));
+  ((struct native_cop *) area)->key = NULL;
   ClObjectPathRebuild((ClObjectPath *) op->hdl,
                       (void *) ((char *) area +
                                 sizeof(struct native_cop)));
@@ -406,6 +418,7 @@ relocateSerializedObjectPath(void *area)
   struct native_cop *cop = (struct native_cop *) area;
   cop->cop.hdl = cop + 1;
   cop->mem_state = MEM_RELEASED;
+  cop->key = NULL;
   cop->cop.ft = &oft;
   ClObjectPathRelocateObjectPath((ClObjectPath *) cop->cop.hdl);
   return (CMPIObjectPath *) cop;
@@ -433,7 +446,8 @@ __new_empty_cop(int mm_add, CMPIStatus *rc)
   int             state;
 
   cop.cop = o;
-  tCop = memAddEncObj(mm_add, &cop, sizeof(cop), &state);
+  cop.key = NULL;
+  tCop = memAddArenaEncObj(mm_add, &cop, sizeof(cop), &state);
   tCop->mem_state = state;
   tCop->refCount = 0;
   if (rc)
@@ -691,10 +705,8 @@ qCompare(const void *arg1, const void *arg2)
                     (char *) ((KeyIds *) arg2)->key->hdl);
 }
 
-static char     copKey[8192];
-
-UtilStringBuffer *
-normalizeObjectPathStrBuf(const CMPIObjectPath * cop)
+static UtilStringBuffer *
+buildKey(const CMPIObjectPath * cop)
 {
   int             c = CMGetKeyCount(cop, NULL);
   int             i;
@@ -723,8 +735,7 @@ normalizeObjectPathStrBuf(const CMPIObjectPath * cop)
     if (ids[i].data.type == CMPI_ref) {
       CMPIString     *cn = CMGetClassName(ids[i].data.value.ref, NULL);
       CMPIString     *ns = CMGetNameSpace(ids[i].data.value.ref, NULL);
-      UtilStringBuffer *sbt =
-          normalizeObjectPathStrBuf(ids[i].data.value.ref);
+      UtilStringBuffer *sbt = buildKey(ids[i].data.value.ref);
       char           *nss;
       cp = (char *) cn->hdl;
       while (*cp) {
@@ -757,40 +768,133 @@ normalizeObjectPathStrBuf(const CMPIObjectPath * cop)
   return (sb);
 }
 
+static          CMPIUint64
+keyHash(const char *k)
+{
+  CMPIUint64      h = 14695981039346656037ULL;
+  while (*k)
+    h = (h ^ (unsigned char) *k++) * 1099511628211ULL;
+  return h;
+}
+
+/*
+ * The canonical key is kept in the native_cop until a key or the name
+ * space is set. Paths relocated from a message or repository area are
+ * never released, their key is built on every call and returned in *tmp
+ * for the caller to free.
+ */
+static const char *
+getKey(const CMPIObjectPath * cop, char **tmp, CMPIUint64 *hash)
+{
+  struct native_cop *o = (struct native_cop *) cop;
+  UtilStringBuffer *sb;
+  char           *k;
+
+  *tmp = NULL;
+  if ((k = o->key) == NULL) {
+    sb = buildKey(cop);
+    k = strdup(sb->ft->getCharPtr(sb));
+    sb->ft->release(sb);
+    if (o->mem_state == 0 || o->mem_state == MEM_RELEASED) {
+      if (hash)
+        *hash = keyHash(k);
+      return *tmp = k;
+    }
+    o->hash = keyHash(k);
+    /* const paths may be shared by threads */
+    if (!__sync_bool_compare_and_swap(&o->key, NULL, k)) {
+      free(k);
+      k = o->key;
+    }
+  }
+  if (hash)
+    *hash = o->hash;
+  return k;
+}
+
+UtilStringBuffer *
+normalizeObjectPathStrBuf(const CMPIObjectPath * cop)
+{
+  UtilStringBuffer *sb = UtilFactory->newStrinBuffer(512);
+  char           *tmp;
+
+  sb->ft->appendChars(sb, getKey(cop, &tmp, NULL));
+  free(tmp);
+  return sb;
+}
+
+/*
+ * the canonical key, valid until cop is changed or released; for a
+ * relocated path a copy in the thread's tracked memory 
+ */
+const char     *
+objectpathKey(const CMPIObjectPath * cop)
+{
+  char           *tmp,
+                 *k;
+  int             id;
+
+  getKey(cop, &tmp, NULL);
+  if (tmp == NULL)
+    return ((struct native_cop *) cop)->key;
+  k = memAlloc(MEM_TRACKED, strlen(tmp) + 1, &id);
+  strcpy(k, tmp);
+  free(tmp);
+  return k;
+}
+
+CMPIUint64
+objectpathHash(const CMPIObjectPath * cop)
+{
+  CMPIUint64      h;
+  char           *tmp;
+
+  getKey(cop, &tmp, &h);
+  free(tmp);
+  return h;
+}
+
 char           *
 normalizeObjectPathChars(const CMPIObjectPath * cop)
 {
-  UtilStringBuffer *sb = normalizeObjectPathStrBuf(cop);
-  strcpy(copKey, sb->ft->getCharPtr(sb));
-  sb->ft->release(sb);
-  return copKey;
+  return (char *) objectpathKey(cop);
 }
 
 char           *
 normalizeObjectPathCharsDup(const CMPIObjectPath * cop)
 {
-  char           *n;
-  UtilStringBuffer *sb = normalizeObjectPathStrBuf(cop);
-  n = strdup(sb->ft->getCharPtr(sb));
-  sb->ft->release(sb);
-  return n;
+  char           *tmp;
+  const char     *k = getKey(cop, &tmp, NULL);
+
+  return tmp ? tmp : strdup(k);
 }
 
 int
 objectpathCompare(const CMPIObjectPath * cop1, const CMPIObjectPath * cop2)
 {
-  UtilStringBuffer *sb1,
-                 *sb2;
+  char           *tmp1,
+                 *tmp2;
   int             result;
 
-  sb1 = normalizeObjectPathStrBuf(cop1);
-  sb2 = normalizeObjectPathStrBuf(cop2);
-
-  result = strcmp(sb1->ft->getCharPtr(sb1), sb2->ft->getCharPtr(sb2));
-
-  sb1->ft->release(sb1);
-  sb2->ft->release(sb2);
+  result = strcmp(getKey(cop1, &tmp1, NULL), getKey(cop2, &tmp2, NULL));
+  free(tmp1);
+  free(tmp2);
+  return result;
+}
 
+int
+objectpathEquals(const CMPIObjectPath * cop1, const CMPIObjectPath * cop2)
+{
+  CMPIUint64      h1,
+                  h2;
+  char           *tmp1,
+                 *tmp2;
+  const char     *k1 = getKey(cop1, &tmp1, &h1),
+      *k2 = getKey(cop2, &tmp2, &h2);
+  int             result = h1 == h2 && strcmp(k1, k2) == 0;
+
+  free(tmp1);
+  free(tmp2);
   return result;
 }
 /* MODELINES */
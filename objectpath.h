@@ -29,6 +29,16 @@ char           *normalizeObjectPathCharsDup(const CMPIObjectPath * cop);
 int             objectpathCompare(const CMPIObjectPath * cop1,
                                   const CMPIObjectPath * cop2);
 
+/*
+ * Canonical key of an object path: key names lowercased and sorted, as
+ * "name=value,...", references rendered recursively. It is computed once
+ * per path and kept until a key or the name space is set.
+ */
+const char     *objectpathKey(const CMPIObjectPath * cop);
+CMPIUint64      objectpathHash(const CMPIObjectPath * cop);
+int             objectpathEquals(const CMPIObjectPath * cop1,
+                                 const CMPIObjectPath * cop2);
+
 #endif
 /* MODELINES */
 /* DO NOT EDIT BELOW THIS COMMENT */
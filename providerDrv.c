@@ -37,6 +37,7 @@
 #include "msgqueue.h"
 #include "constClass.h"
 #include "native.h"
+#include "latencyStats.h"
 #include "queryOperation.h"
 #include "selectexp.h"
 #include "control.h"
@@ -139,6 +140,8 @@ extern void     showClHdr(void *ihdr);
 extern ProvIds  getProvIds(ProviderInfo * info);
 extern int      xferLastResultBuffer(CMPIResult *result, int to, int rc);
 extern void     setResultQueryFilter(CMPIResult *result, QLStatement * qs);
+extern void     setResultSharedNames(CMPIResult *result);
+extern int      ClInternEnabled();
 extern CMPIArray *getKeyListAndVerifyPropertyList(CMPIObjectPath *,
                                                   char **props, int *ok,
                                                   CMPIStatus *rc);
@@ -1365,6 +1368,7 @@ deleteClass(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((unused
       _SFCB_TRACE(1, ("--- Back from provider rc: %d", rci.rc));
 
   if (rci.rc == CMPI_RC_OK) {
+    bumpClassGeneration();
     resp = calloc(1, sizeof(*resp));
     resp->count = 0;
     resp->moreChunks = 0;
@@ -1474,6 +1478,7 @@ createClass(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((unused
       _SFCB_TRACE(1, ("--- Back from provider rc: %d", rci.rc));
 
   if (rci.rc == CMPI_RC_OK) {
+    bumpClassGeneration();
     resp = calloc(1, sizeof(*resp));
     resp->count = 0;
     resp->moreChunks = 0;
@@ -1542,6 +1547,21 @@ enumClassNames(BinRequestHdr * hdr, ProviderInfo * info, int __attribute__ ((unu
   _SFCB_RETURN(resp);
 }
 
+/*
+ * result for an enumeration; requests that do not come from a local
+ * client were sent by a process sharing the intern table 
+ */
+static CMPIResult *
+newProviderResult(BinRequestHdr * hdr, int requestor)
+{
+  CMPIResult     *result =
+      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+
+  if ((hdr->options & BRH_Internal) == 0 && ClInternEnabled())
+    setResultSharedNames(result);
+  return result;
+}
+
 static BinResponseHdr *
 enumClasses(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
 {
@@ -1553,7 +1573,7 @@ enumClasses(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   //  CMPIArray      *r;
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = req->hdr.flags;
@@ -1600,7 +1620,7 @@ enumQualifiers(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
   CMPIArray      *r;
   CMPICount       count;
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = req->hdr.flags;
@@ -2188,7 +2208,7 @@ enumInstances(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2248,7 +2268,7 @@ enumInstanceNames(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2363,7 +2383,7 @@ execQuery(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2467,7 +2487,7 @@ associators(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2524,7 +2544,7 @@ references(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2578,7 +2598,7 @@ associatorNames(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -2626,7 +2646,7 @@ referenceNames(BinRequestHdr * hdr, ProviderInfo * info, int requestor)
       relocateSerializedObjectPath(req->objectPath.data);
   CMPIStatus      rci = { CMPI_RC_OK, NULL };
   CMPIResult     *result =
-      native_new_CMPIResult(requestor < 0 ? 0 : requestor, 0, NULL);
+      newProviderResult(hdr, requestor);
   CMPIContext    *ctx = native_new_CMPIContext(MEM_TRACKED, info);
   BinResponseHdr *resp;
   CMPIFlags       flgs = 0;
@@ -3411,6 +3431,7 @@ processProviderInvocationRequestsThread(void *prms)
   unsigned long   i;
   char           *errstr = NULL;
   char msg[1024];
+  struct timeval  start;
 
   _SFCB_ENTER(TRACE_PROVIDERDRV,
               "processProviderInvocationRequestsThread");
@@ -3507,7 +3528,10 @@ processProviderInvocationRequestsThread(void *prms)
     ENQ_BOT_LIST(parms, activeThreadsFirst, activeThreadsLast, next, prev);
     pthread_mutex_unlock(&activeMtx);
 
+    gettimeofday(&start, NULL);
     resp = hdlr.handler(req, pInfo, requestor);
+    if (pInfo)
+      recordProviderLatency(pInfo->providerName, &start);
 
     pthread_mutex_lock(&activeMtx);
     DEQ_FROM_LIST(parms, activeThreadsFirst, activeThreadsLast, next,
@@ -3566,7 +3590,8 @@ processProviderInvocationRequestsThread(void *prms)
     curProvProc->lastActivity = pInfo->lastActivity;
   }
 
-  if ((req->options & BRH_Internal) == 0)
+  if ((req->options & BRH_Internal) == 0
+      || (req->options & BRH_ResultChannel))
     close(abs(parms->requestor));
   free(parms);
   free(req);
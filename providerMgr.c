@@ -21,6 +21,8 @@
  */
 
 #include <signal.h>
+#include <errno.h>
+#include <sys/select.h>
 #include <time.h>
 #include <pthread.h>
 #include <sys/resource.h>
@@ -38,6 +40,7 @@
 #include "queryOperation.h"
 #include "selectexp.h"
 #include "config.h"
+#include "control.h"
 
 #ifdef HAVE_QUALREP
 #include "qualifier.h"
@@ -53,7 +56,20 @@
 #define SFCB_ASM(x)
 #endif
 
-static pthread_mutex_t resultsocketMutex = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Every thread keeps its own result socket pair (result channel) and
+ * hands it to the receiver with each request, so threads of one process
+ * can have requests in flight at the same time. A channel that saw a
+ * failed receive may still hold a late answer and is not reused.
+ */
+typedef struct resultChannel {
+  ComSockets      sockets;
+  pid_t           pid;
+  int             broken;
+} ResultChannel;
+
+static pthread_key_t resultChannelKey;
+static pthread_once_t resultChannelOnce = PTHREAD_ONCE_INIT;
 
 extern CMPIBroker *Broker;
 
@@ -1098,7 +1114,7 @@ processProviderMgrRequests()
         free(req);
       } else {
       }
-      if ((options & OH_Internal) == 0)
+      if ((options & OH_Internal) == 0 || (options & OH_ResultChannel))
         close(requestor);
 
     } else {
@@ -1176,6 +1192,75 @@ setInuseSem(void *id)
   _SFCB_EXIT();
 }
 
+static void
+freeResultChannel(void *p)
+{
+  ResultChannel  *ch = (ResultChannel *) p;
+
+  /* a child closes just its copies of an inherited channel's sockets */
+  closeSocket(&ch->sockets, COM_ALL, "resultChannel");
+  free(ch);
+}
+
+static void
+initResultChannels()
+{
+  pthread_key_create(&resultChannelKey, freeResultChannel);
+}
+
+/*
+ * hand out the calling thread's result channel, creating it on first use;
+ * a channel inherited across fork belongs to the parent and is replaced,
+ * after closing the copies of its sockets
+ */
+static ComSockets
+getResultChannel()
+{
+  ResultChannel  *ch;
+
+  pthread_once(&resultChannelOnce, initResultChannels);
+  ch = (ResultChannel *) pthread_getspecific(resultChannelKey);
+
+  if (ch && ch->pid != getpid()) {
+    freeResultChannel(ch);
+    ch = NULL;
+  }
+  if (ch == NULL) {
+    ch = malloc(sizeof(*ch));
+    ch->sockets = getSocketPair("resultChannel");
+    ch->pid = getpid();
+    ch->broken = 0;
+    pthread_setspecific(resultChannelKey, ch);
+  }
+  return ch->sockets;
+}
+
+static void
+resultChannelBroken()
+{
+  ResultChannel  *ch;
+
+  pthread_once(&resultChannelOnce, initResultChannels);
+  if ((ch = (ResultChannel *) pthread_getspecific(resultChannelKey)))
+    ch->broken = 1;
+}
+
+/*
+ * called when the thread is done with its channel for this request
+ */
+static void
+releaseResultChannel()
+{
+  ResultChannel  *ch;
+
+  pthread_once(&resultChannelOnce, initResultChannels);
+  ch = (ResultChannel *) pthread_getspecific(resultChannelKey);
+  if (ch && ch->broken) {
+    pthread_setspecific(resultChannelKey, NULL);
+    freeResultChannel(ch);
+  }
+}
+
 /*
  ctx is passed in to receive response information (provider id, etc)
  ohdr is passed in to build the request to providerMgr proc
@@ -1199,7 +1284,7 @@ getProviderContext(BinRequestContext * ctx)
 
   memcpy(buf, ohdr, sizeof(*ohdr));
   if (localMode)
-    ((OperationHdr *) buf)->options = OH_Internal;
+    ((OperationHdr *) buf)->options = OH_Internal | OH_ResultChannel;
   else
     ((OperationHdr *) buf)->options = 0;
 
@@ -1211,16 +1296,12 @@ getProviderContext(BinRequestContext * ctx)
   ((OperationHdr *) buf)->className.data = (void *) l;
   l += ohdr->className.length;
 
-  if (localMode) {
-    pthread_mutex_lock(&resultsocketMutex);
-    sockets = resultSockets;
-  } else
-    sockets = getSocketPair("getProviderContext");
+  sockets = getResultChannel();
 
   _SFCB_TRACE(1,
               ("--- Sending mgr request - to %d from %d", sfcbSockets.send,
                sockets.send));
-  rc = spSendReq(&sfcbSockets.send, &sockets.send, buf, l, localMode);
+  rc = spSendReq(&sfcbSockets.send, &sockets.send, buf, l, 0);
   free(buf);
 
   if (rc < 0) {
@@ -1228,11 +1309,8 @@ getProviderContext(BinRequestContext * ctx)
           "--- spSendReq/spSendMsg failed to send on %d (%d)\n",
           sfcbSockets.send, rc);
     ctx->rc = rc;
-    if (!localMode) {
-      closeSocket(&sockets, COM_ALL, "getProviderContext");
-    } else {
-      pthread_mutex_unlock(&resultsocketMutex);
-    }
+    resultChannelBroken();
+    releaseResultChannel();
     _SFCB_RETURN(rc);
 
   }
@@ -1277,24 +1355,45 @@ getProviderContext(BinRequestContext * ctx)
   else if (ctx->rc == MSG_X_EXTENDED_CTL_MSG) {
     ctx->rc = ctx->ctlXdata->code;
   }
-  else if (ctx->rc == -2) {
+  else if (ctx->rc < 0) {
     extern int httpProcIdX;
-    if (httpProcIdX)
+    if (ctx->rc == -2 && httpProcIdX)
       exit(1);
+    resultChannelBroken();
   }
 
-  if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "getProviderContext");
-  } else {
-    pthread_mutex_unlock(&resultsocketMutex);
-  }
+  releaseResultChannel();
   _SFCB_RETURN(ctx->rc);
 }
 
+/*
+ * failure response for a provider that did not answer
+ */
 static BinResponseHdr *
-intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
+noProviderResponse(int timedOut)
 {
-  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "intInvokeProvider");
+  extern int      httpProcIdX;
+  BinResponseHdr *resp = calloc(sizeof(BinResponseHdr), 1);
+
+  resp->rc = CMPI_RC_ERR_FAILED + 1;
+  if (timedOut) {
+    mlogf(M_ERROR, M_SHOW,
+          "--- req hander %d timed out waiting for provider response\n",
+          httpProcIdX);
+    resp->object[0] = setCharsMsgSegment(
+        "Req handler timed out waiting for provider response");
+  }
+  return resp;
+}
+
+/*
+ * send the request of ctx to provider ctx->provA, the response comes back
+ * on sockets.receive
+ */
+static void
+sendProviderRequest(BinRequestContext * ctx, ComSockets sockets)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "sendProviderRequest");
   _SFCB_TRACE(1, ("--- localMode: %d", localMode));
   int             ol,
                   rc;
@@ -1303,21 +1402,7 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
                   i;
   char           *buf;
   BinRequestHdr  *hdr = ctx->bHdr;
-  BinResponseHdr *resp = NULL;
-  int             fromS;
   void           *heapCtl = markHeap();
-  extern int      httpProcIdX;
-#ifdef SFCB_DEBUG
-  struct rusage   us,
-                  ue;
-  struct timeval  sv,
-                  ev;
-
-  if (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING) {
-    gettimeofday(&sv, NULL);
-    getrusage(RUSAGE_SELF, &us);
-  }
-#endif
 
   /* If we can store the provId in the binRequestHdr,
      why don't we do that in the first place? */
@@ -1339,7 +1424,7 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
     _SFCB_TRACE(1, ("--- noResp set"));
   }
   if (localMode)
-    hdr->options |= BRH_Internal;
+    hdr->options |= BRH_Internal | BRH_ResultChannel;
 
   memcpy(buf, hdr, size);
   for (l = size, i = 0; i < hdr->count; i++) {
@@ -1391,10 +1476,10 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
   _SFCB_TRACE(1,
               ("--- Sending Provider invocation request (%d-%p) - to %d-%lu from %d-%lu",
                hdr->operation, hdr->provId, ctx->provA.socket,
-               getInode(ctx->provA.socket), resultSockets.send,
-               getInode(resultSockets.send)));
+               getInode(ctx->provA.socket), sockets.send,
+               getInode(sockets.send)));
 
-  rc = spSendReq(&ctx->provA.socket, &sockets.send, buf, l, localMode);
+  rc = spSendReq(&ctx->provA.socket, &sockets.send, buf, l, 0);
   if (rc == -2) {
     mlogf(M_ERROR, M_SHOW, "--- need to reload provider ??\n");
     SFCB_ASM("int $3");
@@ -1403,10 +1488,24 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
   }
 
   free(buf);
+  releaseHeap(heapCtl);
+  _SFCB_EXIT();
+}
+
+static BinResponseHdr *
+recvProviderResponse(BinRequestContext * ctx, ComSockets sockets)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "recvProviderResponse");
+  int             rc;
+  unsigned long   size,
+                  i;
+  BinResponseHdr *resp = NULL;
+  int             fromS;
+  void           *heapCtl = markHeap();
 
   _SFCB_TRACE(1,
               ("--- Waiting for Provider response - from %d",
-               resultSockets.receive));
+               sockets.receive));
 
   if (ctx->chunkedMode) {
     _SFCB_TRACE(1, ("--- chunked mode"));
@@ -1420,22 +1519,14 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
 
       if ((rc = spRecvResult(&sockets.receive, &fromS, (void**) &resp, &size)) < 0) {
         size = 0; /* force failure handling */
+        resultChannelBroken();
       }
 
       /*
        * nothing received -- construct a failure response 
        */
-      if (resp == NULL || size == 0) {
-        resp = calloc(sizeof(BinResponseHdr), 1);
-        resp->rc = CMPI_RC_ERR_FAILED + 1;
-        if (rc == -2) {
-          mlogf(M_ERROR, M_SHOW,
-              "--- req hander %d timed out waiting for provider response\n",
-              httpProcIdX);
-          resp->object[0] = setCharsMsgSegment(
-              "Req handler timed out waiting for provider response");
-        }
-      }
+      if (resp == NULL || size == 0)
+        resp = noProviderResponse(rc == -2);
       for (i = 0; i < resp->count; i++) {
         resp->object[i].data =
             (void *) ((long) resp->object[i].data + (char *) resp);
@@ -1459,22 +1550,14 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
 
     if ((rc = spRecvResult(&sockets.receive, &fromS, (void**) &resp, &size)) < 0) {
       size = 0; /* force failure case */
+      resultChannelBroken();
     }
 
     /*
      * nothing received -- construct a failure response 
      */
-    if (resp == NULL || size == 0) {
-      resp = calloc(sizeof(BinResponseHdr), 1);
-      resp->rc = CMPI_RC_ERR_FAILED + 1;
-      if (rc == -2) {
-        mlogf(M_ERROR, M_SHOW,
-            "--- req hander %d timed out waiting for provider response\n",
-            httpProcIdX);
-        resp->object[0] = setCharsMsgSegment(
-            "Req handler timed out waiting for provider response");
-      }
-    }
+    if (resp == NULL || size == 0)
+      resp = noProviderResponse(rc == -2);
 
     ctx->rCount = ctx->pCount;
 
@@ -1489,6 +1572,29 @@ intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
   }
 
   releaseHeap(heapCtl);
+  _SFCB_RETURN(resp);
+}
+
+static BinResponseHdr *
+intInvokeProvider(BinRequestContext * ctx, ComSockets sockets)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "intInvokeProvider");
+  BinResponseHdr *resp;
+#ifdef SFCB_DEBUG
+  BinRequestHdr  *hdr = ctx->bHdr;
+  struct rusage   us,
+                  ue;
+  struct timeval  sv,
+                  ev;
+
+  if (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING) {
+    gettimeofday(&sv, NULL);
+    getrusage(RUSAGE_SELF, &us);
+  }
+#endif
+
+  sendProviderRequest(ctx, sockets);
+  resp = recvProviderResponse(ctx, sockets);
 
 #ifdef SFCB_DEBUG
   if (*_ptr_sfcb_trace_mask & TRACE_RESPONSETIMING) {
@@ -1512,21 +1618,101 @@ invokeProvider(BinRequestContext * ctx)
   ComSockets      sockets;
   _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "invokeProvider");
 
-  if (localMode) {
-    pthread_mutex_lock(&resultsocketMutex);
-    sockets = resultSockets;
-  } else
-    sockets = getSocketPair("invokeProvider");
-
+  sockets = getResultChannel();
   BinResponseHdr *resp = intInvokeProvider(ctx, sockets);
+  releaseResultChannel();
 
-  if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "invokeProvider");
+  _SFCB_RETURN(resp);
+}
+
+static void
+traceProviderCall(BinRequestContext * binCtx)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "traceProviderCall");
+  if (pReg) {
+    _SFCB_TRACE_VAR_PTR(ProviderInfo *info, pReg->ft->getProviderById(pReg,
+        binCtx->provA.ids.provId));
+    _SFCB_TRACE(1, ("--- Calling provider id: %d type=%lu %s (%s)",
+        info->id, info->type, info->providerName, info->className));
   } else {
-    pthread_mutex_unlock(&resultsocketMutex);
+    _SFCB_TRACE(1, ("--- Calling provider id: %d", binCtx->provA.ids.provId));
   }
+  _SFCB_EXIT();
+}
 
-  _SFCB_RETURN(resp);
+/*
+ * Send the request to up to fanOut providers at once, each one answering
+ * on its own socket pair, and collect the responses as they come in.
+ * resp[] is filled in provider order, so callers see no difference to the
+ * sequential case.
+ */
+static void
+fanOutProviders(BinRequestContext * binCtx, BinResponseHdr ** resp,
+                long fanOut)
+{
+  _SFCB_ENTER(TRACE_PROVIDERMGR | TRACE_CIMXMLPROC, "fanOutProviders");
+  extern int      httpProcIdX;
+  extern long     httpReqHandlerTimeout;
+  unsigned long   i,
+                  next = 0,
+                  pending = 0;
+  ComSockets     *sockets;
+  struct timeval  tv;
+  fd_set          rdfds;
+  int             maxfd,
+                  rc;
+
+  sockets = malloc(sizeof(ComSockets) * binCtx->pCount);
+
+  while (next < binCtx->pCount || pending) {
+    for (; next < binCtx->pCount && pending < fanOut; next++, pending++) {
+      binCtx->provA = binCtx->pAs[next];
+      traceProviderCall(binCtx);
+      sockets[next] = getSocketPair("invokeProviders");
+      sendProviderRequest(binCtx, sockets[next]);
+      resp[next] = NULL;
+    }
+
+    FD_ZERO(&rdfds);
+    maxfd = 0;
+    for (i = 0; i < next; i++) {
+      if (resp[i] == NULL) {
+        FD_SET(sockets[i].receive, &rdfds);
+        if (sockets[i].receive > maxfd)
+          maxfd = sockets[i].receive;
+      }
+    }
+
+    tv.tv_sec = httpReqHandlerTimeout;
+    tv.tv_usec = 0;
+    rc = select(maxfd + 1, &rdfds, NULL, NULL, httpProcIdX ? &tv : NULL);
+    if (rc < 0 && errno == EINTR)
+      continue;
+
+    for (i = 0; i < next; i++) {
+      if (resp[i])
+        continue;
+      if (rc > 0 && !FD_ISSET(sockets[i].receive, &rdfds))
+        continue;
+      if (rc > 0) {
+        binCtx->provA = binCtx->pAs[i];
+        resp[i] = recvProviderResponse(binCtx, sockets[i]);
+        _SFCB_TRACE(1, ("--- back from calling provider id: %d",
+                        binCtx->provA.ids.provId));
+      } else {
+        /*
+         * timed out or select failed -- give up on whatever is still
+         * outstanding 
+         */
+        resp[i] = noProviderResponse(rc == 0);
+      }
+      closeSocket(&sockets[i], COM_ALL, "invokeProviders");
+      pending--;
+    }
+  }
+
+  free(sockets);
+  _SFCB_EXIT();
 }
 
 BinResponseHdr **
@@ -1536,43 +1722,49 @@ invokeProviders(BinRequestContext * binCtx, int *err, int *count)
   BinResponseHdr **resp;
   ComSockets      sockets;
   unsigned long   i;
-
-  if (localMode) {
-    pthread_mutex_lock(&resultsocketMutex);
-    sockets = resultSockets;
-  } else
-    sockets = getSocketPair("invokeProvider");
+  static long     fanOut = -1;
 
   resp = malloc(sizeof(BinResponseHdr *) * (binCtx->pCount));
   *err = 0;
   *count = 0;
-  binCtx->pDone = 1;
 
   _SFCB_TRACE(1, ("--- %d providers", binCtx->pCount));
-  for (i = 0; i < binCtx->pCount; i++, binCtx->pDone++) {
-    binCtx->provA = binCtx->pAs[i];
-    if (pReg) {
-      _SFCB_TRACE_VAR_PTR(ProviderInfo *info, pReg->ft->getProviderById(pReg,
-          binCtx->provA.ids.provId));
-      _SFCB_TRACE(1, ("--- Calling provider id: %d type=%lu %s (%s)",
-          info->id, info->type, info->providerName, info->className));
-    } else {
-      _SFCB_TRACE(1, ("--- Calling provider id: %d", binCtx->provA.ids.provId));
+
+  /*
+   * chunked responses are written out while they arrive, they have to
+   * talk to one provider at a time 
+   */
+  if (fanOut < 0 && getControlNum("providerFanOut", &fanOut))
+    fanOut = 1;
+
+  if (!binCtx->chunkedMode && (binCtx->noResp & 1) == 0
+      && binCtx->pCount > 1 && fanOut > 1) {
+    fanOutProviders(binCtx, resp, fanOut);
+    binCtx->pDone = binCtx->pCount;
+  }
+
+  else {
+    sockets = getResultChannel();
+
+    binCtx->pDone = 1;
+    for (i = 0; i < binCtx->pCount; i++, binCtx->pDone++) {
+      binCtx->provA = binCtx->pAs[i];
+      traceProviderCall(binCtx);
+      resp[i] = intInvokeProvider(binCtx, sockets);
+      _SFCB_TRACE(1, ("--- back from calling provider id: %d",
+                      binCtx->provA.ids.provId));
     }
-    resp[i] = intInvokeProvider(binCtx, sockets);
-    _SFCB_TRACE(1, ("--- back from calling provider id: %d", binCtx->provA.ids.provId));
+
+    releaseResultChannel();
+  }
+
+  for (i = 0; i < binCtx->pCount; i++) {
     *count += resp[i]->count;
     resp[i]->rc--;
     if (*err == 0 && resp[i]->rc != 0)
       *err = i + 1;
   }
 
-  if (!localMode) {
-    closeSocket(&sockets, COM_ALL, "invokeProvider");
-  } else {
-    pthread_mutex_unlock(&resultsocketMutex);
-  }
-
   _SFCB_RETURN(resp);
 }
 
@@ -1594,8 +1786,186 @@ extern void     lockUpCall(CMPIBroker * mb);
 extern void     unlockUpCall(CMPIBroker * mb);
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
+/*
+ * Per process cache of classes fetched by getConstClass(). The class
+ * generation lives in a shared page set up by sfcbd before anything is
+ * forked; the class provider driver bumps it on every successful
+ * CreateClass/DeleteClass, and a process seeing a new generation drops
+ * its whole cache. Processes not forked by sfcbd (local clients, tools)
+ * have no shared generation and bypass the cache.
+ */
+static volatile unsigned long *classGeneration = NULL;
+static long     classCacheLimit = 0;
+static UtilHashTable *classCache = NULL;
+static unsigned long classCacheGeneration = 0;
+static pthread_mutex_t classCacheMtx = PTHREAD_MUTEX_INITIALIZER;
+
+void
+initClassCache()
+{
+  void           *page;
+
+  if (getControlNum("classCacheLimit", &classCacheLimit))
+    classCacheLimit = 0;
+  if (classCacheLimit <= 0)
+    return;
+
+  page = mmap(NULL, sizeof(unsigned long), PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    mlogf(M_ERROR, M_SHOW, "--- class cache disabled, mmap failed: %s\n",
+          strerror(errno));
+    return;
+  }
+  classGeneration = page;
+}
+
+void
+bumpClassGeneration()
+{
+  if (classGeneration)
+    __sync_fetch_and_add(classGeneration, 1);
+}
+
+/*
+ * called with classCacheMtx held
+ */
+static void
+flushClassCache()
+{
+  HashTableIterator *i;
+  char           *key;
+  CMPIConstClass *cc;
+
+  for (i = classCache->ft->getFirst(classCache, (void **) &key,
+                                    (void **) &cc);
+       i; i = classCache->ft->getNext(classCache, i, (void **) &key,
+                                      (void **) &cc))
+    cc->ft->release(cc);
+  classCache->ft->clear(classCache);
+}
+
+static char    *
+classCacheKey(const char *ns, const char *cn)
+{
+  char           *key = malloc(strlen(ns) + strlen(cn) + 2);
+
+  strcpy(key, ns);
+  strcat(key, ":");
+  strcat(key, cn);
+  return key;
+}
+
+/*
+ * returns an untracked clone of a cached class, and the generation the
+ * cache was at, to be handed back to addCachedClass()
+ */
+static CMPIConstClass *
+getCachedClass(const char *ns, const char *cn, unsigned long *gen)
+{
+  CMPIConstClass *cc = NULL;
+  char           *key;
+
+  pthread_mutex_lock(&classCacheMtx);
+  *gen = *classGeneration;
+  if (classCache == NULL)
+    classCache = UtilFactory->newHashTable(61,
+                                           UtilHashTable_charKey |
+                                           UtilHashTable_ignoreKeyCase |
+                                           UtilHashTable_managedKey);
+  else if (classCacheGeneration != *gen)
+    flushClassCache();
+  classCacheGeneration = *gen;
+
+  key = classCacheKey(ns, cn);
+  if ((cc = classCache->ft->get(classCache, key)))
+    cc = cc->ft->clone(cc, NULL);
+  free(key);
+  pthread_mutex_unlock(&classCacheMtx);
+  return cc;
+}
+
+static void
+addCachedClass(const char *ns, const char *cn, CMPIConstClass * cc,
+               unsigned long gen)
+{
+  char           *key;
+
+  pthread_mutex_lock(&classCacheMtx);
+  /*
+   * the class may have changed while it was fetched 
+   */
+  if (gen == *classGeneration && classCacheGeneration == gen) {
+    if (classCache->ft->size(classCache) >= classCacheLimit)
+      flushClassCache();
+    key = classCacheKey(ns, cn);
+    if (classCache->ft->get(classCache, key) == NULL) {
+      classCache->ft->put(classCache, key, cc->ft->clone(cc, NULL));
+      key = NULL;
+    }
+    free(key);
+  }
+  pthread_mutex_unlock(&classCacheMtx);
+}
+
+/*
+ * Class images of the namespaces, see constClass.c. They are checked
+ * before the class cache and, like it, rely on the class generation to
+ * notice class changes, after which they are opened again. That only
+ * maps the files which really changed; the old images go away with the
+ * last class handed out from them.
+ */
+static UtilHashTable *classImages = NULL;
+static unsigned long classImagesGeneration = 0;
+
+static CMPIConstClass *
+getImageConstClass(const char *ns, const char *cn)
+{
+  HashTableIterator *it;
+  ClassImage     *img;
+  CMPIConstClass *cc = NULL;
+  void           *cls;
+  char           *dir,
+                 *dn,
+                 *key;
+
+  pthread_mutex_lock(&classCacheMtx);
+  if (classImages == NULL || classImagesGeneration != *classGeneration) {
+    if (classImages) {
+      for (it = classImages->ft->getFirst(classImages, (void **) &key,
+                                          (void **) &img); it;
+           it = classImages->ft->getNext(classImages, it, (void **) &key,
+                                         (void **) &img))
+        releaseClassImage(img);
+      classImages->ft->release(classImages);
+    }
+    classImages = UtilFactory->newHashTable(61,
+                                            UtilHashTable_charKey |
+                                            UtilHashTable_managedKey);
+    classImagesGeneration = *classGeneration;
+  }
+
+  if (classImages->ft->containsKey(classImages, ns))
+    img = classImages->ft->get(classImages, ns);
+  else {
+    if (getControlChars("registrationDir", &dir))
+      dir = "/var/lib/sfcb/registration";
+    dn = malloc(strlen(dir) + strlen(ns) + 16);
+    sprintf(dn, "%s/repository/%s", dir, ns);
+    img = openClassImage(dn, 1);
+    free(dn);
+    classImages->ft->put(classImages, strdup(ns), img);
+  }
+  if (img && (cls = getImageClass(img, cn)))
+    cc = newImageConstClass(img, cls);
+  pthread_mutex_unlock(&classCacheMtx);
+
+  return cc;
+}
+
 CMPIConstClass *
 getConstClass(const char *ns, const char *cn)
 {
@@ -1608,9 +1978,26 @@ getConstClass(const char *ns, const char *cn)
   OperationHdr    req = { OPS_GetClass, 2 };
   int             irc,
                   x;
+  unsigned long   gen = 0;
 
   _SFCB_ENTER(TRACE_PROVIDERMGR, "getConstClass");
 
+  if (classGeneration && ns && cn) {
+    if ((ccl = getImageConstClass(ns, cn))) {
+      _SFCB_TRACE(1, ("--- class image hit %s:%s", ns, cn));
+      /*
+       * released, not just freed, so it lets go of its image 
+       */
+      memLinkEncObj(ccl, &x);
+      _SFCB_RETURN(ccl);
+    }
+    if ((ccl = getCachedClass(ns, cn, &gen))) {
+      _SFCB_TRACE(1, ("--- class cache hit %s:%s", ns, cn));
+      memAdd(ccl, &x);
+      _SFCB_RETURN(ccl);
+    }
+  }
+
   path = TrackedCMPIObjectPath(ns, cn, &rc);
   sreq.principal = setCharsMsgSegment("$$");
   sreq.objectPath = setObjectPathMsgSegment(path);
@@ -1637,6 +2024,8 @@ getConstClass(const char *ns, const char *cn)
       ccl = relocateSerializedConstClass(resp->object[0].data);
       ccl = ccl->ft->clone(ccl, NULL);
       memAdd(ccl, &x);
+      if (classGeneration && ns && cn)
+        addCachedClass(ns, cn, ccl, gen);
     } else
       ccl = NULL;
   } else {
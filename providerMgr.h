@@ -81,6 +81,7 @@ typedef struct operationHdr {
   unsigned short  type;
   unsigned short  options;
 #define OH_Internal 2
+#define OH_ResultChannel 4     /* requestor passed its own socket */
   unsigned long   count;
   MsgSegment      nameSpace;
   MsgSegment      className;
@@ -102,6 +103,7 @@ typedef struct binRequestHdr {
   unsigned short  options;
 #define BRH_NoResp 1
 #define BRH_Internal 2
+#define BRH_ResultChannel 4    /* requestor passed its own socket */
   void           *provId;
   unsigned int    sessionId;
   unsigned int    flags;
@@ -167,6 +169,12 @@ typedef struct binRequestContext {
 
 typedef struct chunkFunctions {
   void            (*writeChunk) (BinRequestContext *, BinResponseHdr *);
+  /*
+   * send part of a response body generated on the fly, length 0 ends it.
+   * NULL if the connection can not take a chunked response 
+   */
+  void            (*writeStream) (BinRequestContext *, const char *,
+                                  unsigned int);
 } ChunkFunctions;
 
 typedef struct getClassReq {
@@ -398,6 +406,8 @@ BinResponseHdr **invokeProviders(BinRequestContext * binCtx, int *err,
 BinResponseHdr *invokeProvider(BinRequestContext * ctx);
 void            freeResponseHeaders(BinResponseHdr ** resp,
                                     BinRequestContext * ctx);
+void            initClassCache();
+void            bumpClassGeneration();
 sigset_t mask, old_mask;
 
 #endif
@@ -70,7 +70,12 @@ struct native_result {
                                  * be adjusted upward */
   unsigned long   dNext;        /* the next available pos in *data */
 
+  long            window;       /* number of chunks that may be sent
+                                 * before the requestor acked them */
+  long            unacked;      /* chunks sent and not acked yet */
+
   QLStatement    *qs;           /* used for execQuery */
+  int             sharedNames;  /* requestor shares the intern table */
 };
 typedef struct native_result NativeResult;
 
@@ -83,6 +88,9 @@ prepResultBuffer(NativeResult * nr, unsigned long length)
 
   if (getControlNum("chunkSize", (long *) &nr->dMax))
     nr->dMax = 50000;
+  if (getControlNum("chunkWindow", &nr->window) || nr->window < 1)
+    nr->window = 1;
+  nr->unacked = 0;
 
   /*
    * if what we're returning is > chunkSize, make chunkSize bigger 
@@ -124,8 +132,28 @@ xferResultBuffer(NativeResult * nr, int to, int more, int rc, unsigned long leng
   nr->resp->count = nr->sNext;
 
   rc = spSendResult2(&to, &dmy, nr->resp, s1, nr->data, nr->dNext);
-  if (more)
-    spRcvAck(to);
+
+  /*
+   * the requestor acks every chunk but the last one once it has written
+   * it out. Keep going until window chunks are outstanding, and collect
+   * the remaining acks after the last chunk so none are left behind on
+   * the socket. 
+   */
+  if (more) {
+    nr->unacked++;
+    while (nr->unacked >= nr->window) {
+      if (spRcvAck(to) <= 0) {
+        nr->unacked = 0;
+        break;
+      }
+      nr->unacked--;
+    }
+  } else {
+    for (; nr->unacked > 0; nr->unacked--)
+      if (spRcvAck(to) <= 0)
+        break;
+    nr->unacked = 0;
+  }
 
   _SFCB_RETURN(rc);
 }
@@ -341,10 +369,17 @@ __rft_returnInstance(const CMPIResult *result,
   }
 
   if (isInst) {
-    size = getInstanceSerializedSize(instance);
-    ptr = nextResultBufferPos(r, MSG_SEG_INSTANCE, size);
-    _SFCB_TRACE(1, ("--- Moving instance %d", size));
-    getSerializedInstance(instance, ptr);       /* memcpy inst to ptr */
+    if (r->sharedNames) {
+      size = getInstanceSerializedSizeShared(instance);
+      ptr = nextResultBufferPos(r, MSG_SEG_INSTANCE, size);
+      _SFCB_TRACE(1, ("--- Moving instance %d", size));
+      getSerializedInstanceShared(instance, ptr);
+    } else {
+      size = getInstanceSerializedSize(instance);
+      ptr = nextResultBufferPos(r, MSG_SEG_INSTANCE, size);
+      _SFCB_TRACE(1, ("--- Moving instance %d", size));
+      getSerializedInstance(instance, ptr);     /* memcpy inst to ptr */
+    }
   } else {
     size = getConstClassSerializedSize((CMPIConstClass *) instance);
     ptr = nextResultBufferPos(r, MSG_SEG_CONSTCLASS, size);
@@ -432,6 +467,16 @@ setResultQueryFilter(CMPIResult *result, QLStatement * qs)
   r->qs = qs;
 }
 
+/*
+ * the requestor was forked from sfcbd and resolves interned names itself
+ */
+void
+setResultSharedNames(CMPIResult *result)
+{
+  NativeResult   *r = (NativeResult *) result;
+  r->sharedNames = 1;
+}
+
 CMPIArray      *
 native_result2array(CMPIResult *result)
 {
@@ -61,6 +61,9 @@ extern char    *parseTarget(const char *target);
 extern int      init_sfcBroker();
 extern CMPIBroker *Broker;
 extern void     initProvProcCtl(int);
+extern void     initClassCache();
+extern void     initLatencyStats();
+extern int      ClInternInit(unsigned long size);
 extern void     processTerminated(int pid);
 extern int      httpDaemon(int argc, char *argv[], int sslMode, int adapterNum, char *ipAddr, sa_family_t ipAddrFam);
 extern void     processProviderMgrRequests();
@@ -654,7 +657,8 @@ main(int argc, char *argv[])
       httpLocalOnly = 0;
   int             syslogLevel   = LOG_NOTICE;
   long            dSockets,
-                  pSockets;
+                  pSockets,
+                  internSize;
   char           *pauseStr;
   int             daemonize=0;
 
@@ -1043,6 +1047,12 @@ main(int argc, char *argv[])
 
   initSem(pSockets);
   initProvProcCtl(pSockets);
+  initClassCache();
+  initLatencyStats();
+  if (getControlNum("internTableSize", &internSize) == 0 && internSize
+      && ClInternInit(internSize))
+    mlogf(M_ERROR, M_SHOW, "--- intern table disabled, mmap failed: %s\n",
+          strerror(errno));
   init_sfcBroker();
   initSocketPairs(pSockets, dSockets);
 
@@ -15,7 +15,8 @@
  *
  * Description:
  *
- * Sets the component trace mask for SFCB trace output
+ * Sets the component trace mask for SFCB trace output and dumps the
+ * binary trace ring
  *
 */
 
@@ -27,6 +28,7 @@
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "trace.h"
 
 int shmkey = 0xdeb001;
@@ -35,8 +37,14 @@ extern TraceId traceIds[];
 void print_help() {
   printf( "sfcbtrace - toggle the tracemask for SFCB trace output\n\n");
   printf( "Usage: sfcbtrace <trace_mask> <shm_key>\n");
+  printf( "       sfcbtrace -d <seconds> <shm_key>\n");
+  printf( "       sfcbtrace -s <file> <shm_key>\n");
+  printf( "       sfcbtrace -r <file> <seconds>\n");
   printf( "\ttrace_mask - an unsigned long or hex value for component(s) to trace (default=0) \n");
-  printf( "\tshm_key - the shared memory ID being used by SFCB (default=%x)\n\n", shmkey);
+  printf( "\tshm_key - the shared memory ID being used by SFCB (default=%x)\n", shmkey);
+  printf( "\t-d - print the trace ring, only the last <seconds> if not 0\n");
+  printf( "\t-s - save the trace ring to <file>\n");
+  printf( "\t-r - print a trace ring saved with -s\n\n");
 
   printf("Traceable Components:   Int     Hex\n");
   int i;
@@ -46,6 +54,135 @@ void print_help() {
   return;
 }
 
+static TraceShm *attachTrace()
+{
+  int shmid;
+  void *vpDP;
+
+  if ((shmid = shmget( shmkey, 0, 0 )) < 0) {
+    printf("No segment for key %x (sfcbd not running?)\n", shmkey);
+    exit(3);
+  }
+  vpDP = shmat( shmid, NULL, SHM_RDONLY );
+  if ( (vpDP == (void*)-1) || (vpDP == NULL) ) {
+    printf( "shmat(%x,) failed with errno = %s(%u)\n", shmid, strerror(errno), errno );
+    exit(4);
+  }
+  if (((TraceShm *)vpDP)->magic != TRACE_RING_MAGIC) {
+    printf("No trace ring for key %x (traceRingSize not set?)\n", shmkey);
+    exit(5);
+  }
+  return (TraceShm *)vpDP;
+}
+
+static int cmpRecords(const void *a, const void *b)
+{
+  unsigned long sa = ((TraceRecord *)a)->seq, sb = ((TraceRecord *)b)->seq;
+  return sa < sb ? -1 : sa > sb;
+}
+
+/* copy the records that are not being written right now, oldest first */
+static unsigned long copyRing(TraceShm *shm, TraceRecord *out)
+{
+  unsigned long i, n = 0, seq;
+
+  for (i = 0; i < shm->records; i++) {
+    TraceRecord *rec = shm->ring + i;
+    seq = rec->seq;
+    __sync_synchronize();
+    if (seq == 0)
+      continue;
+    out[n] = *rec;
+    __sync_synchronize();
+    if (rec->seq != seq)
+      continue;
+    out[n].file[TRACE_RING_FILE_LEN - 1] = 0;
+    out[n].msg[TRACE_RING_MSG_LEN - 1] = 0;
+    n++;
+  }
+  qsort(out, n, sizeof(*out), cmpRecords);
+  return n;
+}
+
+static void printRecords(TraceRecord *recs, unsigned long n, long secs)
+{
+  unsigned long i;
+  long from = 0;
+  struct tm cttm;
+  time_t sec;
+  char tm[20];
+
+  if (secs > 0 && n)
+    from = recs[n - 1].sec - secs;
+
+  for (i = 0; i < n; i++) {
+    if (recs[i].sec < from)
+      continue;
+    sec = recs[i].sec;
+    localtime_r(&sec, &cttm);
+    strftime(tm, sizeof(tm), "%m/%d/%Y %H:%M:%S", &cttm);
+    printf("[%i] [%s.%06ld] %d/%p %05lx --- %s(%i) : %s\n", recs[i].level, tm,
+           recs[i].usec, recs[i].pid, (void *)recs[i].tid, recs[i].mask,
+           recs[i].file, recs[i].line, recs[i].msg);
+  }
+}
+
+static int dumpRing(int argc, char **argv)
+{
+  TraceShm *shm, hdr;
+  TraceRecord *recs;
+  unsigned long n;
+  FILE *f;
+
+  if (argc < 3) {
+    print_help();
+    exit(1);
+  }
+
+  if (strcmp(argv[1], "-r") == 0) {
+    if ((f = fopen(argv[2], "r")) == NULL) {
+      printf("Can't open %s: %s\n", argv[2], strerror(errno));
+      exit(2);
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != TRACE_RING_MAGIC) {
+      printf("%s is not a saved trace ring\n", argv[2]);
+      exit(2);
+    }
+    recs = malloc(sizeof(*recs) * (hdr.records + 1));
+    n = fread(recs, sizeof(*recs), hdr.records, f);
+    fclose(f);
+    printRecords(recs, n, argc > 3 ? strtol(argv[3], NULL, 10) : 0);
+    return 0;
+  }
+
+  if (argc > 3)
+    shmkey = strtoul( argv[3], NULL, 16 );
+  shm = attachTrace();
+  recs = malloc(sizeof(*recs) * (shm->records + 1));
+  n = copyRing(shm, recs);
+  shmdt(shm);
+
+  if (strcmp(argv[1], "-d") == 0) {
+    printRecords(recs, n, strtol(argv[2], NULL, 10));
+    return 0;
+  }
+
+  if ((f = fopen(argv[2], "w")) == NULL) {
+    printf("Can't create %s: %s\n", argv[2], strerror(errno));
+    exit(2);
+  }
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = TRACE_RING_MAGIC;
+  hdr.records = n;
+  if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+      fwrite(recs, sizeof(*recs), n, f) != n || fclose(f)) {
+    printf("Can't write %s: %s\n", argv[2], strerror(errno));
+    exit(2);
+  }
+  printf("%lu trace records saved to %s\n", n, argv[2]);
+  return 0;
+}
+
 int main(int argc, char **argv) {
 
   int shmid;
@@ -53,6 +190,10 @@ int main(int argc, char **argv) {
   void *vpDP = NULL;
   unsigned long *pulDP = NULL;
 	
+  if (argc > 1 && (strcmp(argv[1], "-d") == 0 || strcmp(argv[1], "-s") == 0
+                   || strcmp(argv[1], "-r") == 0))
+    exit(dumpRing(argc, argv));
+
   if (argc > 3) {
     print_help();
     exit(1);
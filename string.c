@@ -43,9 +43,7 @@ __sft_release(CMPIString *string)
   if (s->mem_state && s->mem_state != MEM_RELEASED) {
     if (s->string.hdl && s->refCount == 0)
       free(s->string.hdl);
-    memUnlinkEncObj(s->mem_state);
-    s->mem_state = MEM_RELEASED;
-    free(string);
+    memReleaseEncObj(string, &s->mem_state);
     CMReturn(CMPI_RC_OK);
   }
 
@@ -86,7 +84,7 @@ __new_string(int mm_add, const char *ptr, CMPIStatus *rc, int reown)
   int             state;
 
   str.string = s;
-  tStr = memAddEncObj(mm_add, &str, sizeof(str), &state);
+  tStr = memAddArenaEncObj(mm_add, &str, sizeof(str), &state);
   tStr->mem_state = state;
   /*
    * reown > 1 disallows deallocation of original string 
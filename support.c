@@ -365,6 +365,77 @@ tool_mm_load_lib(const char *libname)
   return dlopen(filename, RTLD_LAZY);
 }
 
+/*
+ * Tracked objects that are only ever released through their own release
+ * function or a heap flush can be carved out of a per thread arena; see
+ * memAddArenaEncObj(). Each block is MEM_ARENA_BLOCK bytes unless an
+ * object does not fit.
+ */
+#define MEM_ARENA_BLOCK 65536
+#define MEM_ARENA_ALIGN 16
+#define MEM_ARENA_ROUND(n) \
+  (((n) + MEM_ARENA_ALIGN - 1) & ~((size_t) MEM_ARENA_ALIGN - 1))
+#define MEM_ARENA_HDR MEM_ARENA_ROUND(sizeof(MemArena))
+
+static int      useArena = -1;
+
+static void    *
+__arena_alloc(managed_thread * mt, size_t size)
+{
+  MemArena       *a = mt->arena;
+  size_t          bsize;
+  void           *p;
+
+  size = MEM_ARENA_ROUND(size);
+  if (a == NULL || (size_t) (a->end - a->cur) < size) {
+    bsize = MEM_ARENA_BLOCK;
+    if (bsize < size + MEM_ARENA_HDR)
+      bsize = size + MEM_ARENA_HDR;
+    if (mt->arenaSpare && bsize == MEM_ARENA_BLOCK) {
+      a = mt->arenaSpare;
+      mt->arenaSpare = NULL;
+    } else {
+      a = malloc(bsize);
+      __ALLOC_ERROR(!a);
+      a->end = (char *) a + bsize;
+    }
+    a->prev = mt->arena;
+    a->cur = (char *) a + MEM_ARENA_HDR;
+    mt->arena = a;
+  }
+  p = a->cur;
+  a->cur += size;
+  return p;
+}
+
+/*
+ * drop everything allocated from the arena since block/mark was current 
+ */
+static void
+__arena_rewind(managed_thread * mt, MemArena * block, char *mark)
+{
+  MemArena       *a;
+
+  while (mt->arena && mt->arena != block) {
+    a = mt->arena;
+    mt->arena = a->prev;
+    if (mt->arenaSpare == NULL
+        && (size_t) (a->end - (char *) a) == MEM_ARENA_BLOCK)
+      mt->arenaSpare = a;
+    else
+      free(a);
+  }
+  if (mt->arena)
+    mt->arena->cur = mark;
+}
+
+static void
+__arena_mark(managed_thread * mt, HeapControl * hc)
+{
+  hc->arenaBlock = mt->arena;
+  hc->arenaMark = mt->arena ? mt->arena->cur : NULL;
+}
+
 static void
 __flush_mt(managed_thread * mt)
 {
@@ -393,6 +464,8 @@ __flush_mt(managed_thread * mt)
     }
     mt->hc.memEncObjs[mt->hc.memEncUsed] = NULL;
   };
+
+  __arena_rewind(mt, mt->hc.arenaBlock, mt->hc.arenaMark);
   _SFCB_EXIT();
 }
 
@@ -417,6 +490,10 @@ __cleanup_mt(void *ptr)
     if (mt->hc.memEncObjs)
       { free(mt->hc.memEncObjs); mt->hc.memEncObjs = NULL; }
 
+    __arena_rewind(mt, NULL, NULL);
+    if (mt->arenaSpare)
+      free(mt->arenaSpare);
+
     if (mt) { free(mt); mt = NULL; }
   }
   return;
@@ -587,6 +664,63 @@ memAddEncObj(int mode, void *ptr, size_t size, int *memId)
   _SFCB_RETURN(object);
 }
 
+/**
+ * Like memAddEncObj(), but a tracked copy is carved out of the thread's
+ * arena when config property trackedMemoryArena is set.
+ *
+ * Description:
+ *
+ *   Arena objects are flagged with MEM_ARENA_ID in their memId; their
+ *   release function must hand them to memReleaseEncObj() instead of
+ *   unlinking and freeing them itself.
+ *   Their storage is reclaimed when the heap they were created in is
+ *   released or flushed, so only types that are never unlinked to outlive
+ *   that heap may use this.
+ */
+
+void           *
+memAddArenaEncObj(int mode, void *ptr, size_t size, int *memId)
+{
+  managed_thread *mt;
+  void           *object;
+
+  if (useArena < 0 && getControlBool("trackedMemoryArena", &useArena))
+    useArena = 0;
+  if (localClientMode || mode != MEM_TRACKED || useArena == 0)
+    return memAddEncObj(mode, ptr, size, memId);
+
+  _SFCB_ENTER(TRACE_MEMORYMGR, "memAddArenaEncObj");
+  mt = __memInit(0);
+
+  object = memcpy(__arena_alloc(mt, size), ptr, size);
+  mt->hc.memEncObjs[mt->hc.memEncUsed++] = (Object *) object;
+  *memId = mt->hc.memEncUsed | MEM_ARENA_ID;
+
+  if (mt->hc.memEncUsed == mt->hc.memEncSize) {
+    mt->hc.memEncSize += MT_SIZE_STEP;
+    mt->hc.memEncObjs = realloc(mt->hc.memEncObjs,mt->hc.memEncSize * sizeof(void *));
+    __ALLOC_ERROR(!mt->hc.memEncObjs);
+  }
+
+  _SFCB_RETURN(object);
+}
+
+/**
+ * Unlinks an encapsulated object, marks it released and frees it unless
+ * it lives in the arena.
+ */
+
+void
+memReleaseEncObj(void *object, int *memId)
+{
+  int             id = *memId;
+
+  memUnlinkEncObj(id);
+  *memId = MEM_RELEASED;
+  if (id == MEM_NOT_TRACKED || (id & MEM_ARENA_ID) == 0)
+    free(object);
+}
+
 UtilList *
 memAddUtilList(UtilList* ul)
 {
@@ -626,7 +760,7 @@ memUnlinkEncObj(int memId)
                                          * delete */
 
   if (mt && memId != MEM_RELEASED && memId != MEM_NOT_TRACKED)
-    mt->hc.memEncObjs[memId - 1] = NULL;
+    mt->hc.memEncObjs[(memId & ~MEM_ARENA_ID) - 1] = NULL;
 }
 
 void
@@ -693,6 +827,7 @@ markHeap()
   mt->hc.memEncSize = mt->hc.memSize = MT_SIZE_STEP;
   mt->hc.memObjs = malloc(MT_SIZE_STEP * sizeof(void *));
   mt->hc.memEncObjs = malloc(MT_SIZE_STEP * sizeof(void *));
+  __arena_mark(mt, &mt->hc);
 
   _SFCB_RETURN(hc);
 }
@@ -100,6 +100,13 @@ CMPIQualifierDeclMI *loadQualifierDeclMI(const char *provider,
  *  State in which previously tracked memory has been released.
  */
 
+/** @def MEM_ARENA_ID
+ *
+ *  Flag set in the memId of tracked objects that were allocated from the
+ *  thread's arena. Their storage is reclaimed when the heap is released
+ *  and must not be passed to free(), see memReleaseEncObj().
+ */
+
 /** @def MT_SIZE_STEP
  *
  *  The initial size of trackable memory pointers per thread. This size is
@@ -130,6 +137,12 @@ CMPIQualifierDeclMI *loadQualifierDeclMI(const char *provider,
  *  This struct is used for managing the heap bound to the current thread.
  */
 
+/** @struct memArena
+ *  @brief Block of the per-thread tracked object arena.
+ *
+ *  markHeap() records the arena position, releaseHeap() rewinds to it.
+ */
+
 /** @var typedef struct heapControl HeapControl
  *  @brief Heap management structure.
  *
@@ -147,6 +160,8 @@ CMPIQualifierDeclMI *loadQualifierDeclMI(const char *provider,
 #define MEM_TRACKED   1
 #define MEM_RELEASED -1
 
+#define MEM_ARENA_ID 0x40000000
+
 #define MT_SIZE_STEP 100
 
 typedef struct {
@@ -163,6 +178,12 @@ typedef struct {
 
 typedef struct _managed_thread managed_thread;
 
+typedef struct memArena {
+  struct memArena *prev;             /**< previous (older) block */
+  char           *cur;               /**< next free byte in this block */
+  char           *end;               /**< end of this block */
+} MemArena;
+
 typedef struct heapControl {
   unsigned        memSize;           /**< current maximum number of tracked object pointers */
   unsigned        memUsed;           /**< number of currently tracked object pointers */
@@ -170,6 +191,8 @@ typedef struct heapControl {
   unsigned        memEncUsed;        /**< current maximum number of tracked encapsulated object pointers */
   unsigned        memEncSize;        /**< number of currently tracked encapsulated object pointers */
   Object        **memEncObjs;        /**< pointers to encapsulated object allocations */
+  MemArena       *arenaBlock;        /**< arena block current when this heap was marked */
+  char           *arenaMark;         /**< arena position when this heap was marked */
 } HeapControl;
 
 struct _managed_thread {
@@ -178,6 +201,8 @@ struct _managed_thread {
   void           *data;
   HeapControl     hc;                /**< heap control structure for this thread */
   int             cleanupDone;       /**< cleanup state */
+  MemArena       *arena;             /**< newest arena block for tracked objects */
+  MemArena       *arenaSpare;        /**< one unused block kept for reuse */
 };
 
 void           *tool_mm_load_lib(const char *libname);
@@ -193,6 +218,9 @@ void           *tool_mm_get_broker(void **);
 int             memAdd(void *ptr, int *memId);
 void           *memAlloc(int add, size_t size, int *memId);
 void           *memAddEncObj(int mode, void *ptr, size_t size, int *memId);
+void           *memAddArenaEncObj(int mode, void *ptr, size_t size,
+                                  int *memId);
+void            memReleaseEncObj(void *object, int *memId);
 void            memUnlinkEncObj(int memId);
 void            memLinkEncObj(void *ptr, int *memId);
 void            memLinkInstance(CMPIInstance *ci);
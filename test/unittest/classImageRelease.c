@@ -0,0 +1,138 @@
+/*
+ * Fetch a class from a class image through getConstClass() over and over,
+ * across class generation changes, and check that the classes handed out
+ * let go of their image when the heap is released, so that an image
+ * replaced with a new generation gets unmapped.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CMPI_PLATFORM_LINUX_GENERIC_GNU
+
+#include "constClass.h"
+#include "objectImpl.h"
+#include "providerMgr.h"
+#include "native.h"
+#include "support.h"
+#include "control.h"
+
+#define GENERATIONS 5
+#define FETCHES 20
+
+static char     dir[64],
+                fn[128];
+
+/* replaces the image with a new file, the old one stays mapped as long
+ * as someone holds it */
+static int
+writeImage()
+{
+  char            tmp[160];
+  ClVersionRecord vr;
+  ClClass        *cls,
+                 *img;
+  FILE           *f;
+  long            size;
+
+  sprintf(tmp, "%s.new", fn);
+  if ((f = fopen(tmp, "wb")) == NULL)
+    return 1;
+  vr = ClBuildVersionRecord(0, SFCB_LOCAL_ENDIAN, &size);
+  fwrite(&vr, size, 1, f);
+  cls = ClClassNew("Test_Image", NULL);
+  img = ClClassRebuildClass(cls, NULL);
+  fwrite(img, img->hdr.size, 1, f);
+  free(img);
+  ClClassFreeClass(cls);
+  if (fclose(f))
+    return 1;
+  return rename(tmp, fn);
+}
+
+/* the number of mappings of the image file, replaced ones included */
+static int
+countMappings()
+{
+  char            line[512];
+  FILE           *f = fopen("/proc/self/maps", "r");
+  int             n = 0;
+
+  if (f == NULL)
+    return -1;
+  while (fgets(line, sizeof(line), f))
+    if (strstr(line, fn))
+      n++;
+  fclose(f);
+  return n;
+}
+
+int
+main(void)
+{
+  CMPIConstClass *cc;
+  char            cfg[128];
+  void           *heap;
+  FILE           *f;
+  int             g,
+                  i,
+                  n,
+                  rc = 0;
+
+  printf("Performing class image release tests.... \n");
+
+  strcpy(dir, "/tmp/sfcbrepoXXXXXX");
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  sprintf(cfg, "%s/sfcb.cfg", dir);
+  f = fopen(cfg, "w");
+  fprintf(f, "registrationDir: %s\nclassCacheLimit: 10\n", dir);
+  fclose(f);
+  setupControl(cfg);
+  initClassCache();
+
+  sprintf(fn, "%s/repository", dir);
+  mkdir(fn, 0700);
+  strcat(fn, "/root");
+  mkdir(fn, 0700);
+  strcat(fn, "/classSchemas");
+
+  printf("- Fetching classes across %d generations...\n", GENERATIONS);
+  for (g = 0; g < GENERATIONS; g++) {
+    if (writeImage()) {
+      printf("  cannot write %s\n", fn);
+      rc = 1;
+      break;
+    }
+    bumpClassGeneration();
+    for (i = 0; i < FETCHES; i++) {
+      heap = markHeap();
+      cc = getConstClass("root", "Test_Image");
+      if (cc == NULL || !isImageConstClass(cc)) {
+        printf("  generation %d: class not taken from the image\n", g);
+        rc = 1;
+      }
+      releaseHeap(heap);
+    }
+    if ((n = countMappings()) != 1) {
+      printf("  generation %d: %d images mapped\n", g, n);
+      rc = 1;
+    }
+  }
+
+  unlink(fn);
+  unlink(cfg);
+  sprintf(cfg, "%s/repository/root", dir);
+  rmdir(cfg);
+  sprintf(cfg, "%s/repository", dir);
+  rmdir(cfg);
+  rmdir(dir);
+
+  printf(rc ? "  Failed.\n" : "  Passed.\n");
+  return rc;
+}
@@ -0,0 +1,209 @@
+/*
+ * Modify and delete blobs of a class until its data file gets compacted,
+ * checking the live blobs after every step; then fake a compaction that
+ * died between replacing the data file and the index.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CMPI_PLATFORM_LINUX_GENERIC_GNU
+
+#include "fileRepository.h"
+#include "control.h"
+
+#define NBLOBS 8
+#define BLEN 64
+
+static char     dir[64],
+                fnd[128],
+                fnx[128];
+static int      version[NBLOBS];        /* -1 = deleted */
+
+static void
+makeBlob(char *b, int i, int v)
+{
+  memset(b, '.', BLEN);
+  snprintf(b, BLEN, "blob-%d-version-%d", i, v);
+}
+
+static int
+check(const char *step)
+{
+  char            id[16],
+                  b[BLEN];
+  char           *g;
+  int             i,
+                  len,
+                  rc = 0;
+
+  for (i = 0; i < NBLOBS; i++) {
+    sprintf(id, "id%d", i);
+    g = getBlob("root", "cls", id, &len);
+    if (version[i] < 0) {
+      if (g) {
+        printf("  %s: %s should be gone\n", step, id);
+        rc = 1;
+      }
+    } else {
+      makeBlob(b, i, version[i]);
+      if (g == NULL || len != BLEN || memcmp(g, b, BLEN)) {
+        printf("  %s: %s is wrong\n", step, id);
+        rc = 1;
+      }
+    }
+    free(g);
+  }
+  return rc;
+}
+
+static int
+modify(int i)
+{
+  char            id[16],
+                  b[BLEN];
+
+  sprintf(id, "id%d", i);
+  makeBlob(b, i, ++version[i]);
+  return addBlob("root", "cls", id, b, BLEN);
+}
+
+static int
+delete(int i)
+{
+  char            id[16];
+
+  sprintf(id, "id%d", i);
+  version[i] = -1;
+  return deleteBlob("root", "cls", id);
+}
+
+static off_t
+dataSize()
+{
+  struct stat     st;
+
+  return stat(fnd, &st) ? -1 : st.st_size;
+}
+
+static int
+copyFile(const char *from, const char *to)
+{
+  char            buf[4096];
+  FILE           *f = fopen(from, "rb"),
+      *t = fopen(to, "wb");
+  size_t          n;
+
+  if (f == NULL || t == NULL)
+    return 1;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    fwrite(buf, 1, n, t);
+  fclose(f);
+  return fclose(t);
+}
+
+int
+main(void)
+{
+  char            cfg[128],
+                  pending[128],
+                  saved[128];
+  FILE           *f;
+  off_t           size,
+                  max = 0;
+  int             i,
+                  compacted = 0,
+                  rc = 0;
+
+  printf("Performing repository compaction tests.... \n");
+
+  strcpy(dir, "/tmp/sfcbrepoXXXXXX");
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  strcat(dir, "/");
+  sprintf(cfg, "%ssfcb.cfg", dir);
+  f = fopen(cfg, "w");
+  fprintf(f, "repositoryCompactThreshold: 50\n");
+  fclose(f);
+  setupControl(cfg);
+
+  sprintf(fnd, "%sroot", dir);
+  mkdir(fnd, 0700);
+  strcat(fnd, "/cls");
+  sprintf(fnx, "%s.idx", fnd);
+  sprintf(pending, "%s.new.idx", fnd);
+  sprintf(saved, "%ssaved.idx", dir);
+  useAlternateRepository(dir);
+
+  printf("- Adding %d blobs...\n", NBLOBS);
+  for (i = 0; i < NBLOBS; i++) {
+    version[i] = -1;
+    rc |= modify(i);
+  }
+  rc |= check("add");
+
+  printf("- Modifying blobs until the data file is compacted...\n");
+  for (i = 0; i < 4 * NBLOBS; i++) {
+    rc |= modify(i % NBLOBS);
+    rc |= check("modify");
+    size = dataSize();
+    if (size < max)
+      compacted++;
+    if (size > max)
+      max = size;
+  }
+  if (compacted == 0 || max > 2 * NBLOBS * BLEN + 16) {
+    printf("  data file not compacted, it grew to %ld bytes\n", (long) max);
+    rc = 1;
+  }
+
+  printf("- Deleting blobs across the compaction threshold...\n");
+  size = dataSize();
+  for (i = 0; i < NBLOBS / 2; i++) {
+    rc |= delete(i);
+    rc |= check("delete");
+  }
+  if (dataSize() >= size) {
+    printf("  data file not compacted after deletes\n");
+    rc = 1;
+  }
+
+  printf("- Recovering from an interrupted compaction...\n");
+  copyFile(fnx, saved);
+  for (i = 0, size = dataSize(); i < 4 * NBLOBS; i++, size = dataSize()) {
+    rc |= modify(NBLOBS / 2 + i % (NBLOBS / 2));
+    if (dataSize() < size)
+      break;
+  }
+  /* data file of the new generation, index of the old one */
+  rename(fnx, pending);
+  rename(saved, fnx);
+  rc |= check("recover");
+  if (access(pending, F_OK) == 0) {
+    printf("  pending index was not used\n");
+    rc = 1;
+  }
+
+  printf("- Deleting the remaining blobs...\n");
+  for (i = NBLOBS / 2; i < NBLOBS; i++)
+    rc |= delete(i);
+  rc |= check("delete all");
+  if (access(fnd, F_OK) == 0 || access(fnx, F_OK) == 0) {
+    printf("  files of the class left behind\n");
+    rc = 1;
+  }
+
+  unlink(cfg);
+  sprintf(cfg, "%sroot", dir);
+  rmdir(cfg);
+  dir[strlen(dir) - 1] = 0;
+  rmdir(dir);
+
+  printf(rc ? "  Failed.\n" : "  Passed.\n");
+  return rc;
+}
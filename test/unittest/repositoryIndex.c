@@ -0,0 +1,218 @@
+/*
+ * Read a class whose index is still in the old ASCII layout, check that
+ * it gets converted to the hashed binary one, then look blobs up, list
+ * them and change them through the converted index.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CMPI_PLATFORM_LINUX_GENERIC_GNU
+
+#include "fileRepository.h"
+#include "control.h"
+
+#define NBLOBS 200
+
+static char     dir[64],
+                fnd[128],
+                fnx[128];
+static int      deleted[NBLOBS + 1];
+
+static void
+makeBlob(char *b, int i)
+{
+  sprintf(b, "blob number %d", i);
+}
+
+/* one line of the old index: "<len> <keyl> <key> <blen> <bofs>\r\n",
+ * the record length written over the leading blanks */
+static void
+writeAsciiRecord(FILE *f, const char *id, int blen, long bofs)
+{
+  char            line[256],
+                  len[16];
+  int             l;
+
+  l = sprintf(line, "    %zd %s %d %lu\r\n", strlen(id), id, blen, bofs);
+  memcpy(line, len, sprintf(len, "%d", l));
+  fwrite(line, l, 1, f);
+}
+
+static int
+writeLegacyClass()
+{
+  FILE           *d = fopen(fnd, "wb"),
+      *x = fopen(fnx, "wb");
+  char            id[16],
+                  b[64];
+  long            ofs = 0;
+  int             i;
+
+  if (d == NULL || x == NULL)
+    return 1;
+  for (i = 0; i < NBLOBS; i++) {
+    sprintf(id, "key%d", i);
+    makeBlob(b, i);
+    fwrite(b, strlen(b), 1, d);
+    writeAsciiRecord(x, id, strlen(b), ofs);
+    ofs += strlen(b);
+  }
+  fclose(d);
+  return fclose(x);
+}
+
+static int
+check(const char *step)
+{
+  char            id[16],
+                  b[64];
+  char           *g;
+  int             i,
+                  len,
+                  rc = 0;
+
+  for (i = 0; i <= NBLOBS; i++) {
+    sprintf(id, "key%d", i);
+    g = getBlob("root", "cls", id, &len);
+    if (deleted[i]) {
+      if (g) {
+        printf("  %s: %s should not be found\n", step, id);
+        rc = 1;
+      }
+    } else {
+      makeBlob(b, i);
+      if (g == NULL || len != (int) strlen(b) || memcmp(g, b, len)) {
+        printf("  %s: %s is wrong\n", step, id);
+        rc = 1;
+      }
+    }
+    free(g);
+  }
+  return rc;
+}
+
+/* blobs come back in the order they were added */
+static int
+checkList(const char *step)
+{
+  BlobIndex      *bi;
+  char           *g,
+                  key[16],
+                  b[64];
+  size_t          kl;
+  char           *kb;
+  int             i = 0,
+      len,
+      rc = 0;
+
+  if (getIndex("root", "cls", 0, 0, &bi) == 0) {
+    printf("  %s: no index\n", step);
+    return 1;
+  }
+  for (g = getFirst(bi, &len, &kb, &kl); g;
+       g = getNext(bi, &len, &kb, &kl)) {
+    while (i <= NBLOBS && deleted[i])
+      i++;
+    sprintf(key, "key%d", i);
+    makeBlob(b, i);
+    if (kl != strlen(key) || memcmp(kb, key, kl) || len != (int) strlen(b)
+        || memcmp(g, b, len)) {
+      printf("  %s: record %d is %.*s\n", step, i, (int) kl, kb);
+      rc = 1;
+    }
+    free(g);
+    i++;
+  }
+  while (i <= NBLOBS && deleted[i])
+    i++;
+  if (i != NBLOBS + 1) {
+    printf("  %s: listed up to %d\n", step, i);
+    rc = 1;
+  }
+  freeBlobIndex(&bi, 1);
+  return rc;
+}
+
+int
+main(void)
+{
+  char            cfg[128],
+                  magic[8],
+                  b[64];
+  FILE           *f;
+  int             i,
+                  rc = 0;
+
+  printf("Performing repository index tests.... \n");
+
+  strcpy(dir, "/tmp/sfcbrepoXXXXXX");
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  strcat(dir, "/");
+  sprintf(cfg, "%ssfcb.cfg", dir);
+  f = fopen(cfg, "w");
+  fclose(f);
+  setupControl(cfg);
+
+  sprintf(fnd, "%sroot", dir);
+  mkdir(fnd, 0700);
+  strcat(fnd, "/cls");
+  sprintf(fnx, "%s.idx", fnd);
+  useAlternateRepository(dir);
+
+  printf("- Reading an index in the old layout...\n");
+  deleted[NBLOBS] = 1;
+  if (writeLegacyClass()) {
+    printf("  cannot write %s\n", fnx);
+    rc = 1;
+  }
+  rc |= check("legacy");
+  memset(magic, 0, sizeof(magic));
+  f = fopen(fnx, "rb");
+  if (f) {
+    fread(magic, sizeof(magic), 1, f);
+    fclose(f);
+  }
+  if (memcmp(magic, "SFCBIX", 6)) {
+    printf("  index not converted\n");
+    rc = 1;
+  }
+
+  printf("- Looking up and listing blobs through the converted index...\n");
+  rc |= check("converted");
+  rc |= checkList("converted");
+  if (existingBlob("root", "cls", "key1") == 0
+      || existingBlob("root", "cls", "nokey")) {
+    printf("  existingBlob is wrong\n");
+    rc = 1;
+  }
+
+  printf("- Adding and deleting blobs...\n");
+  makeBlob(b, NBLOBS);
+  rc |= addBlob("root", "cls", "key200", b, strlen(b));
+  deleted[NBLOBS] = 0;
+  for (i = 0; i < NBLOBS; i += 3) {
+    rc |= deleteBlob("root", "cls", (sprintf(b, "key%d", i), b));
+    deleted[i] = 1;
+  }
+  rc |= check("changed");
+  rc |= checkList("changed");
+
+  for (i = 0; i <= NBLOBS; i++)
+    if (!deleted[i])
+      deleteBlob("root", "cls", (sprintf(b, "key%d", i), b));
+  unlink(cfg);
+  sprintf(cfg, "%sroot", dir);
+  rmdir(cfg);
+  dir[strlen(dir) - 1] = 0;
+  rmdir(dir);
+
+  printf(rc ? "  Failed.\n" : "  Passed.\n");
+  return rc;
+}
@@ -0,0 +1,139 @@
+/*
+ * Add blobs of odd lengths to a class and check that its data file can
+ * still be mapped and the blobs are served in place, aligned, before and
+ * after the data file got compacted.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define CMPI_PLATFORM_LINUX_GENERIC_GNU
+
+#include "fileRepository.h"
+#include "control.h"
+
+#define NBLOBS 16
+
+static char     dir[64];
+static int      deleted[NBLOBS];
+
+/* blob i is 2 * i + 1 bytes long */
+static int
+makeBlob(char *b, int i)
+{
+  int             l = 2 * i + 1;
+
+  memset(b, 'a' + i, l);
+  return l;
+}
+
+static int
+checkMapped(const char *step)
+{
+  BlobIndex      *bi;
+  char           *g,
+                  b[2 * NBLOBS];
+  char           *kb;
+  size_t          kl;
+  int             i = 0,
+      len,
+      rc = 0;
+
+  if (getIndex("root", "cls", 0, 0, &bi) == 0) {
+    printf("  %s: no index\n", step);
+    return 1;
+  }
+  if (mapBlobIndex(bi)) {
+    printf("  %s: data file not mapped\n", step);
+    freeBlobIndex(&bi, 1);
+    return 1;
+  }
+  for (g = getFirst(bi, &len, &kb, &kl); g;
+       g = getNext(bi, &len, &kb, &kl)) {
+    while (i < NBLOBS && deleted[i])
+      i++;
+    if (i == NBLOBS || len != makeBlob(b, i) || memcmp(g, b, len)) {
+      printf("  %s: blob %d is wrong\n", step, i);
+      rc = 1;
+    }
+    if ((uintptr_t) g % sizeof(void *)) {
+      printf("  %s: blob %d is not aligned\n", step, i);
+      rc = 1;
+    }
+    i++;
+  }
+  freeBlobIndex(&bi, 1);
+  return rc;
+}
+
+int
+main(void)
+{
+  char            cfg[128],
+                  id[16],
+                  b[2 * NBLOBS];
+  struct stat     st;
+  FILE           *f;
+  off_t           size;
+  int             i,
+                  rc = 0;
+
+  printf("Performing repository mapping tests.... \n");
+
+  strcpy(dir, "/tmp/sfcbrepoXXXXXX");
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  strcat(dir, "/");
+  sprintf(cfg, "%ssfcb.cfg", dir);
+  f = fopen(cfg, "w");
+  fprintf(f, "repositoryCompactThreshold: 50\n");
+  fclose(f);
+  setupControl(cfg);
+
+  sprintf(b, "%sroot", dir);
+  mkdir(b, 0700);
+  useAlternateRepository(dir);
+
+  printf("- Adding %d blobs of odd lengths...\n", NBLOBS);
+  for (i = 0; i < NBLOBS; i++) {
+    sprintf(id, "id%d", i);
+    rc |= addBlob("root", "cls", id, b, makeBlob(b, i));
+  }
+  rc |= checkMapped("add");
+
+  printf("- Deleting blobs until the data file is compacted...\n");
+  sprintf(cfg, "%sroot/cls", dir);
+  stat(cfg, &st);
+  size = st.st_size;
+  for (i = 0; i < NBLOBS; i++) {
+    if (i % 4 == 3)
+      continue;
+    sprintf(id, "id%d", i);
+    rc |= deleteBlob("root", "cls", id);
+    deleted[i] = 1;
+  }
+  stat(cfg, &st);
+  if (st.st_size >= size) {
+    printf("  data file not compacted\n");
+    rc = 1;
+  }
+  rc |= checkMapped("compacted");
+
+  for (i = 3; i < NBLOBS; i += 4)
+    deleteBlob("root", "cls", (sprintf(id, "id%d", i), id));
+  sprintf(cfg, "%ssfcb.cfg", dir);
+  unlink(cfg);
+  sprintf(cfg, "%sroot", dir);
+  rmdir(cfg);
+  dir[strlen(dir) - 1] = 0;
+  rmdir(dir);
+
+  printf(rc ? "  Failed.\n" : "  Passed.\n");
+  return rc;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Opens an enumeration of SFCB_RegisteredProfile without returning any
+# objects and prints its enumeration context, for the pull and close tests.
+cat > PE_enumerationContext.tmp << EOF
+<?xml version="1.0" encoding="utf-8" ?>
+<CIM CIMVERSION="2.0" DTDVERSION="2.0">
+<MESSAGE ID="4711" PROTOCOLVERSION="1.0">
+<SIMPLEREQ>
+<IMETHODCALL NAME="OpenEnumerateInstances">
+<LOCALNAMESPACEPATH>
+  <NAMESPACE NAME="root"></NAMESPACE>
+  <NAMESPACE NAME="interop"></NAMESPACE>
+</LOCALNAMESPACEPATH>
+<IPARAMVALUE NAME="ClassName">
+  <CLASSNAME NAME="SFCB_RegisteredProfile"/>
+</IPARAMVALUE>
+<IPARAMVALUE NAME="OperationTimeout">
+  <VALUE>60</VALUE>
+</IPARAMVALUE>
+<IPARAMVALUE NAME="MaxObjectCount">
+  <VALUE>0</VALUE>
+</IPARAMVALUE>
+</IMETHODCALL>
+</SIMPLEREQ>
+</MESSAGE>
+</CIM>
+EOF
+
+if [ "$SFCB_TEST_USER" != "" ] && [ "$SFCB_TEST_PASSWORD" != "" ]; then
+    auth="-u $SFCB_TEST_USER -pwd $SFCB_TEST_PASSWORD"
+fi
+wbemcat $auth -p $SFCB_TEST_PORT -t $SFCB_TEST_PROTOCOL \
+    PE_enumerationContext.tmp 2>/dev/null | \
+    sed -n '/NAME="EnumerationContext"/{n;s/.*<VALUE>\(.*\)<\/VALUE>.*/\1/p;}'
+rm -f PE_enumerationContext.tmp
@@ -45,17 +45,24 @@ do
    _TESTRESULT=$_TEST.result
    _TESTPREREQ=$_TEST.prereq
    _TESTNAME=$_TEST
+   # A prereq may leave a request to send instead, made from the test
+   # file, in the current directory
+   _TESTREQUEST=./`basename $_TEST`.request
 
    echo -n "  Testing $_TESTNAME..."
    # Check if there's a .prereq file and if so, run it. Skip this
    # test if it returns "1"
    preRC=0
+   rm -f $_TESTREQUEST
    if [ -f $_TESTPREREQ ] ; then
         ./$_TESTPREREQ
         preRC=$?
    fi
    if [ $preRC -eq 0 ] || [ $preRC -eq 2 ] ; then
        trc=0
+       if [ -f $_TESTREQUEST ] ; then
+           xmlfile=$_TESTREQUEST
+       fi
        # Remove any old test result file
        rm -f $_TESTRESULT
 
@@ -73,8 +80,10 @@ do
           echo "FAILED to send CIM-XML request"
           printf $unred
           trc=1
+          rm -f $_TESTREQUEST
           continue
        fi
+       rm -f $_TESTREQUEST
     
        # Compare the response XML against the expected XML for differences
        # Either using a full copy of the expected output (testname.OK)
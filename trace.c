@@ -36,7 +36,9 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include "config.h"
+#include "control.h"
 
 /*
  * ---------------------------------------------------------------------------
@@ -59,6 +61,7 @@ unsigned long   _sfcb_trace_mask = 0;
 unsigned long *_ptr_sfcb_trace_mask = &_sfcb_trace_mask;
 void *vpDP = NULL;
 int shmid=0;
+TraceShm       *_sfcb_trace_ring = NULL;
 char           *_SFCB_TRACE_FILE = NULL;
 int _SFCB_TRACE_TO_SYSLOG = 0;
 
@@ -117,6 +120,7 @@ _sfcb_trace_start(int n)
 void
 _sfcb_trace_stop()
 {
+  _sfcb_trace_ring = NULL;
   shmctl(shmid, IPC_RMID, 0);
   shmdt(vpDP);
   _sfcb_debug = 0;
@@ -130,8 +134,24 @@ _sfcb_trace_init()
   char           *err = NULL;
   FILE           *ferr = NULL;
   int tryid = 0xDEB001;
+  long records = 0;
+  size_t size;
+
+  if (getControlNum("traceRingSize", &records) || records < 0)
+    records = 0;
+  size = sizeof(TraceShm) + records * sizeof(TraceRecord);
+
   if (shmid == 0) {
-    while ((shmid = shmget(tryid, sizeof(unsigned long), (IPC_EXCL | IPC_CREAT | 0660))) < 0 && (errno == EEXIST)) tryid++;
+    while ((shmid = shmget(tryid, size, (IPC_EXCL | IPC_CREAT | 0660))) < 0 && (errno == EEXIST)) tryid++;
+    if (shmid < 0 && records) {
+      /* ring larger than the system allows (SHMMAX), trace without it */
+      mlogf(M_ERROR, M_SHOW,
+            "--- Warning: trace ring of %ld records disabled, shmget(%x) failed: %s\n",
+            records, tryid, strerror(errno));
+      records = 0;
+      size = sizeof(TraceShm);
+      while ((shmid = shmget(tryid, size, (IPC_EXCL | IPC_CREAT | 0660))) < 0 && (errno == EEXIST)) tryid++;
+    }
   }
   mlogf(M_INFO,M_SHOW,"--- Shared memory ID for tracing: %x\n", tryid);
   if (shmid < 0) {
@@ -146,7 +166,15 @@ _sfcb_trace_init()
       abort();
     }
     else {
-      _ptr_sfcb_trace_mask = (unsigned long *)vpDP;
+      TraceShm *shm = (TraceShm *)vpDP;
+      _ptr_sfcb_trace_mask = &shm->mask;
+      if (records && shm->magic != TRACE_RING_MAGIC) {
+        shm->records = records;
+        shm->next = 0;
+        shm->magic = TRACE_RING_MAGIC;
+        _sfcb_trace_ring = shm;
+        mlogf(M_INFO,M_SHOW,"--- Tracing into ring of %ld records\n", records);
+      }
     }
   }
 
@@ -182,11 +210,60 @@ _sfcb_format_trace(char *fmt, ...)
   return msg;
 }
 
+/*
+ * write one record into the trace ring; a slot is claimed by bumping
+ * next and published by setting its seq last, so writers in all
+ * processes go without a lock and readers can spot records in flux
+ */
+void
+_sfcb_ring_trace(int level, unsigned long mask, char *file, int line,
+                 char *fmt, ...)
+{
+  TraceShm       *shm = _sfcb_trace_ring;
+  TraceRecord    *rec;
+  unsigned long   seq;
+  struct timeval  tv;
+  char           *base;
+  va_list         ap;
+
+  if (shm == NULL)
+    return;
+
+  seq = __sync_fetch_and_add(&shm->next, 1);
+  rec = shm->ring + seq % shm->records;
+  rec->seq = 0;
+  __sync_synchronize();
+
+  gettimeofday(&tv, NULL);
+  rec->sec = tv.tv_sec;
+  rec->usec = tv.tv_usec;
+  rec->tid = (unsigned long) pthread_self();
+  rec->mask = mask;
+  rec->pid = currentProc;
+  rec->level = level;
+  rec->line = line;
+  base = strrchr(file, '/');
+  strncpy(rec->file, base ? base + 1 : file, TRACE_RING_FILE_LEN - 1);
+  rec->file[TRACE_RING_FILE_LEN - 1] = 0;
+  va_start(ap, fmt);
+  vsnprintf(rec->msg, TRACE_RING_MSG_LEN, fmt, ap);
+  va_end(ap);
+
+  __sync_synchronize();
+  rec->seq = seq + 1;
+}
+
 void
 _sfcb_trace(int level, char *file, int line, char *msg)
 {
   if (msg == NULL) return;
 
+  if (_sfcb_trace_ring) {
+    _sfcb_ring_trace(level, 0, file, line, "%s", msg);
+    free(msg);
+    return;
+  }
+
   struct tm       cttm;
   struct timeval  tv;
   struct timezone tz;
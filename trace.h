@@ -29,6 +29,38 @@ extern unsigned long _sfcb_trace_mask;
 /* use pointer indirect _sfcb_trace_mask to allow shared memory flag */
 extern unsigned long *_ptr_sfcb_trace_mask;
 
+/*
+ * With traceRingSize set, trace lines are written as fixed size records
+ * into a ring behind the trace mask in the shared memory segment instead
+ * of the trace file. sfcbtrace -d and -s dump the ring.
+ */
+#define TRACE_RING_MAGIC     0x53464352UL
+#define TRACE_RING_FILE_LEN  32
+#define TRACE_RING_MSG_LEN   192
+
+typedef struct traceRecord {
+  unsigned long   seq;          /* 0 while the record is being written */
+  long            sec;
+  long            usec;
+  unsigned long   tid;
+  unsigned long   mask;         /* component, 0 if not known */
+  int             pid;
+  int             level;
+  int             line;
+  char            file[TRACE_RING_FILE_LEN];
+  char            msg[TRACE_RING_MSG_LEN];
+} TraceRecord;
+
+typedef struct traceShm {
+  unsigned long   mask;         /* must stay first, sfcbtrace sets it */
+  unsigned long   magic;
+  unsigned long   records;      /* ring size, 0 without ring */
+  unsigned long   next;         /* next sequence number to hand out */
+  TraceRecord     ring[0];
+} TraceShm;
+
+extern TraceShm *_sfcb_trace_ring;
+
 #ifdef SFCB_DEBUG
 
 /* to wrap variables used only in trace statements */
@@ -38,9 +70,14 @@ extern unsigned long *_ptr_sfcb_trace_mask;
 #define _SFCB_TRACE_VAR_PTR(v,f) \
   v = ((*_ptr_sfcb_trace_mask & __traceMask)) ? f : NULL;
 
+/* strips the parentheses from STR for _sfcb_ring_trace */
+#define _SFCB_RING_ARGS(...) __VA_ARGS__
+
 #define _SFCB_TRACE(LEVEL,STR) \
   if ((*_ptr_sfcb_trace_mask & __traceMask) && (LEVEL<=_sfcb_debug) && (LEVEL>0) ) \
-  _sfcb_trace(LEVEL,__FILE__,__LINE__,_sfcb_format_trace STR);
+  (_sfcb_trace_ring ? \
+   _sfcb_ring_trace(LEVEL,__traceMask,__FILE__,__LINE__,_SFCB_RING_ARGS STR) : \
+   _sfcb_trace(LEVEL,__FILE__,__LINE__,_sfcb_format_trace STR));
 
 #define _SFCB_ENTER(n,f) \
    char *__func_=f; \
@@ -84,6 +121,8 @@ extern int      _sfcb_debug;
 
 extern char    *_sfcb_format_trace(char *fmt, ...);
 extern void     _sfcb_trace(int, char *, int, char *);
+extern void     _sfcb_ring_trace(int, unsigned long, char *, int, char *,
+                                 ...);
 extern void     _sfcb_trace_start(int l);
 extern void     _sfcb_trace_init();
 extern void     _sfcb_trace_stop();